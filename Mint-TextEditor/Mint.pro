@@ -0,0 +1,29 @@
+# Executable
+TARGET = Mint
+
+# Application Type
+TEMPLATE = app
+
+# Editor sources, headers and forms
+include(src/src.pri)
+
+SOURCES += \
+    main.cpp
+
+# Output (exit folder)
+DESTDIR = build
+
+# debug/release config
+CONFIG(debug, debug|release) {
+    OBJECTS_DIR = build/debug
+    MOC_DIR = build/debug
+    RCC_DIR = build/debug
+    UI_DIR = build/debug
+}
+
+CONFIG(release, debug|release) {
+    OBJECTS_DIR = build/release
+    MOC_DIR = build/release
+    RCC_DIR = build/release
+    UI_DIR = build/release
+}
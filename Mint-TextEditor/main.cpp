@@ -1,11 +1,98 @@
 #include "mainwindow.h"
+#include "Benchmark.h"
+#include "DocumentLoader.h"
+#include "FileLocation.h"
+#include "SingleInstance.h"
+#include "StartupBenchmark.h"
+#include "Trace.h"
 
 #include <QApplication>
+#include <QCommandLineParser>
+#include <QJsonDocument>
+#include <cstdio>
 
 int main(int argc, char *argv[])
 {
+    StartupBenchmark benchmark;
+
     QApplication a(argc, argv);
-    MainWindow w;
+    a.setOrganizationName("Mint");
+    a.setApplicationName("Mint"); // settings location
+    benchmark.mark("application");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mint text editor");
+    parser.addHelpOption();
+    const QCommandLineOption newInstance("new-instance", "Don't hand the files to a running Mint.");
+    parser.addOption(newInstance);
+    const QCommandLineOption trace("trace", "Record operation timings from startup, see View > Performance stats.");
+    parser.addOption(trace);
+    const QCommandLineOption benchmarkOption("benchmark", "Measure the editor core on generated files, print JSON, then quit.");
+    parser.addOption(benchmarkOption);
+    const QCommandLineOption benchmarkSizes("benchmark-sizes", "File sizes for --benchmark, in MB.", "sizes", "1,16,64");
+    parser.addOption(benchmarkSizes);
+    const QCommandLineOption benchmarkLarge("benchmark-large", "Also measure 100 MB and 1 GB files in --benchmark (slow, needs several GB of memory).");
+    parser.addOption(benchmarkLarge);
+    const QCommandLineOption startupBenchmark("startup-benchmark", "Print the startup timings as JSON, then quit.");
+    parser.addOption(startupBenchmark);
+    parser.addPositionalArgument("files", "Files to open, as file, file:line or file:line:column.", "[files...]");
+    parser.process(a);
+    if (parser.isSet(trace))
+        Trace::setEnabled(true);
+
+    if (parser.isSet(benchmarkOption))
+    {
+        // Its own settings, the user's recovery list isn't touched
+        a.setApplicationName("Mint Benchmark");
+        QList<qint64> sizes;
+        for (const QString &size : parser.value(benchmarkSizes).split(',', Qt::SkipEmptyParts))
+            sizes.append(qint64(size.trimmed().toDouble() * 1024 * 1024));
+        if (parser.isSet(benchmarkLarge))
+            sizes.append(Benchmark::largeSizes());
+
+        const QByteArray json = QJsonDocument(Benchmark::run(sizes)).toJson();
+        std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        return 0;
+    }
+
+    QList<FileLocation> files;
+    QStringList arguments;
+    for (const QString &argument : parser.positionalArguments())
+    {
+        files.append(FileLocation::parse(argument));
+        arguments.append(files.last().toString());
+    }
+
+    // A running Mint opens them instead, this one is done before building
+    // any window
+    const bool single = !parser.isSet(newInstance) && !parser.isSet(startupBenchmark);
+    if (single && SingleInstance::forward(arguments))
+        return 0;
+
+    // Read from the disk while the window is being built
+    for (const FileLocation &file : files)
+        DocumentLoader::prefetch(file.path);
+
+    MainWindow w(files);
+    benchmark.mark("window");
+    benchmark.watch(&w, parser.isSet(startupBenchmark));
+
+    SingleInstance instance;
+    if (single && instance.listen())
+    {
+        QObject::connect(&instance, &SingleInstance::argumentsReceived, &w, [&w](const QStringList &arguments) {
+            QList<FileLocation> locations;
+            for (const QString &argument : arguments)
+                locations.append(FileLocation::parse(argument));
+            w.openLocations(locations);
+
+            w.setWindowState(w.windowState() & ~Qt::WindowMinimized);
+            w.raise();
+            w.activateWindow();
+        });
+    }
+
     w.show();
+    benchmark.mark("shown");
     return a.exec();
 }
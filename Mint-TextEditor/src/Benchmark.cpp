@@ -0,0 +1,394 @@
+#include "Benchmark.h"
+#include "DocumentTab.h"
+#include "FindDialog.h"
+#include "ProcessMemory.h"
+#include "TextEditor.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonArray>
+#include <QKeyEvent>
+#include <QScrollBar>
+#include <QSettings>
+#include <QTemporaryDir>
+#include <QTimer>
+#include <algorithm>
+
+// Samples per measurement
+static const int CursorMoves = 10000;
+static const int Keystrokes = 200;
+static const int RepeatBursts = 20;
+static const int RepeatsPerBurst = 30;
+static const int MultiCarets = 10000;
+static const int MultiCaretKeystrokes = 20;
+static const int FindNexts = 1000;
+static const int ScrollStretches = 10;
+static const int PagesPerStretch = 100;
+// A search that doesn't end is a failure, not a result
+static const qint64 WaitLimitMs = 120000;
+static const char *const ThresholdKey = "editor/largeFileThresholdMB";
+
+namespace
+{
+// Lines of words with a "needle" about once in a thousand, the same every run
+QByteArray corpus(qint64 size)
+{
+    static const char *const words[] = { "the", "quick", "brown", "fox", "jumps", "over", "lazy", "dog",
+                                         "lorem", "ipsum", "dolor", "sit", "amet", "editor", "mint", "text" };
+    QByteArray data;
+    data.reserve(size + 128);
+    quint32 seed = 12345;
+    qsizetype lineLength = 0;
+
+    while (data.size() < size)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const char *word = (seed >> 8) % 997 == 0 ? "needle" : words[(seed >> 16) % 16];
+        data += word;
+        lineLength += qsizetype(qstrlen(word)) + 1;
+        if (lineLength > 70)
+        {
+            data += '\n';
+            lineLength = 0;
+        }
+        else
+            data += ' ';
+    }
+    return data;
+}
+
+double milliseconds(qint64 ns)
+{
+    return ns / 1e6;
+}
+
+double megabytesPerSecond(qint64 bytes, qint64 ns)
+{
+    return ns > 0 ? bytes / 1048576.0 / (ns / 1e9) : 0.0;
+}
+
+// Median, 95th percentile and worst of a set of samples, in microseconds
+QJsonObject distribution(QList<qint64> samples)
+{
+    if (samples.isEmpty())
+        return QJsonObject();
+    std::sort(samples.begin(), samples.end());
+    const auto at = [&](double percentile) { return samples.at(qsizetype(percentile * (samples.size() - 1))) / 1e3; };
+    return QJsonObject{ { "medianUs", at(0.5) }, { "p95Us", at(0.95) }, { "maxUs", samples.last() / 1e3 } };
+}
+
+// Short numbered lines, for documents of very many lines
+bool writeLines(const QString &filePath, qint64 lines)
+{
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray block;
+    for (qint64 line = 0; line < lines; ++line)
+    {
+        block += "line ";
+        block += QByteArray::number(line);
+        block += '\n';
+        if (block.size() >= 1024 * 1024 || line + 1 == lines)
+        {
+            if (file.write(block) != block.size())
+                return false;
+            block.clear();
+        }
+    }
+    return true;
+}
+
+// Frames of paging down, in stretches spread over the whole text: the
+// scroll and the repaint of what comes on screen, per frame
+QJsonObject pageThrough(QPlainTextEdit *editor)
+{
+    QScrollBar *scrollBar = editor->verticalScrollBar();
+    QElapsedTimer timer;
+    QList<qint64> samples;
+    for (int stretch = 0; stretch < ScrollStretches; ++stretch)
+    {
+        scrollBar->setValue(int(qint64(scrollBar->maximum()) * stretch / ScrollStretches));
+        editor->viewport()->repaint();
+        for (int i = 0; i < PagesPerStretch; ++i)
+        {
+            timer.start();
+            scrollBar->triggerAction(QAbstractSlider::SliderPageStepAdd);
+            editor->viewport()->repaint();
+            samples.append(timer.nsecsElapsed());
+        }
+    }
+    scrollBar->setValue(0);
+    return distribution(samples);
+}
+
+// Files of any size load into the editor, not the read-only paged view,
+// while one is alive; the setting is the benchmark's own
+class LargeFilesInEditor
+{
+public:
+    explicit LargeFilesInEditor(qint64 size) : previous(QSettings().value(ThresholdKey))
+    {
+        QSettings().setValue(ThresholdKey, qMax(DocumentTab::largeFileThreshold(), size + 1) / 1048576 + 1);
+    }
+    ~LargeFilesInEditor()
+    {
+        if (previous.isValid())
+            QSettings().setValue(ThresholdKey, previous);
+        else
+            QSettings().remove(ThresholdKey);
+    }
+
+private:
+    const QVariant previous;
+};
+
+// Runs the event loop until done() holds
+template <typename Condition>
+bool waitUntil(Condition done)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!done())
+    {
+        if (timer.elapsed() > WaitLimitMs)
+            return false;
+        // Sleeps until events come, checking again at least every millisecond
+        QEventLoop loop;
+        QTimer::singleShot(1, &loop, &QEventLoop::quit);
+        loop.exec();
+    }
+    return true;
+}
+}
+
+QJsonObject Benchmark::run(const QList<qint64> &sizes)
+{
+    QJsonObject result{
+        { "qt", QString(qVersion()) },
+        { "platform", QGuiApplication::platformName() },
+    };
+
+    QTemporaryDir folder;
+    if (!folder.isValid())
+    {
+        result["error"] = "No temporary folder: " + folder.errorString();
+        return result;
+    }
+
+    QJsonArray runs;
+    for (qint64 size : sizes)
+        runs.append(measure(folder.path(), size));
+    result["runs"] = runs;
+    result["peakResidentBytes"] = ProcessMemory::peakResident();
+    return result;
+}
+
+QList<qint64> Benchmark::largeSizes()
+{
+    return { qint64(100) * 1024 * 1024, qint64(1024) * 1024 * 1024 };
+}
+
+QJsonObject Benchmark::measure(const QString &folder, qint64 size)
+{
+    QJsonObject result{ { "bytes", size } };
+    const QString filePath = folder + QString("/corpus-%1.txt").arg(size);
+    {
+        QFile file(filePath);
+        if (!file.open(QIODevice::WriteOnly) || file.write(corpus(size)) < size)
+        {
+            result["error"] = "Couldn't write the corpus: " + file.errorString();
+            return result;
+        }
+    }
+
+    // Laid out and painted as in a window
+    const LargeFilesInEditor largeFiles(size);
+    DocumentTab tab(filePath);
+    tab.resize(1000, 700);
+    tab.show();
+    QPlainTextEdit *editor = tab.editor();
+    QElapsedTimer timer;
+
+    // Load
+    bool loaded = false;
+    QObject::connect(tab.loader(), &DocumentLoader::finished, [&loaded](bool success) { loaded = success; });
+    timer.start();
+    if (!tab.load() || !waitUntil([&]() { return !tab.loader()->isRunning(); }) || !loaded)
+    {
+        result["error"] = "Couldn't load: " + tab.loader()->errorString();
+        return result;
+    }
+    const qint64 loadNs = timer.nsecsElapsed();
+    result["load"] = QJsonObject{ { "ms", milliseconds(loadNs) }, { "mbPerSecond", megabytesPerSecond(size, loadNs) } };
+    result["lines"] = tab.buffer()->table().lineCount();
+
+    // Save
+    timer.restart();
+    if (tab.save(filePath + ".saved") && waitUntil([&]() { return !tab.saver()->isRunning(); }))
+    {
+        const qint64 saveNs = timer.nsecsElapsed();
+        result["save"] = QJsonObject{ { "ms", milliseconds(saveNs) }, { "mbPerSecond", megabytesPerSecond(size, saveNs) } };
+    }
+
+    // Cursor moves all over the text, with the status bar's line and column
+    const TextSnapshot text = tab.buffer()->snapshot();
+    QTextCursor cursor = editor->textCursor();
+    qsizetype checksum = 0;
+    timer.restart();
+    for (int i = 0; i < CursorMoves; ++i)
+    {
+        const qsizetype position = qsizetype((quint64(i) * 2654435761u) % quint64(text.length() + 1));
+        cursor.setPosition(int(position));
+        editor->setTextCursor(cursor);
+        checksum += text.lineAt(position) + text.columnAt(position);
+    }
+    result["cursorMove"] = QJsonObject{ { "us", timer.nsecsElapsed() / 1e3 / CursorMoves }, { "checksum", double(checksum) } };
+
+    // Typing at the start, middle and end: the key press, its edit and the repaint
+    QJsonObject keystrokes;
+    const QList<QPair<QString, double>> places = { { "start", 0.0 }, { "middle", 0.5 }, { "end", 1.0 } };
+    for (const auto &place : places)
+    {
+        cursor.setPosition(int(tab.buffer()->length() * place.second));
+        editor->setTextCursor(cursor);
+        editor->viewport()->repaint();
+
+        QList<qint64> samples;
+        for (int i = 0; i < Keystrokes; ++i)
+        {
+            QKeyEvent press(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a");
+            QKeyEvent release(QEvent::KeyRelease, Qt::Key_A, Qt::NoModifier, "a");
+            timer.restart();
+            QCoreApplication::sendEvent(editor, &press);
+            QCoreApplication::sendEvent(editor, &release);
+            editor->viewport()->repaint();
+            samples.append(timer.nsecsElapsed());
+        }
+        keystrokes[place.first] = distribution(samples);
+    }
+    result["keystroke"] = keystrokes;
+
+    // Key repeat: presses come in faster than frames, then the queued updates and a repaint
+    QList<qint64> repeats;
+    for (int burst = 0; burst < RepeatBursts; ++burst)
+    {
+        timer.restart();
+        for (int i = 0; i < RepeatsPerBurst; ++i)
+        {
+            QKeyEvent press(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a", true);
+            QCoreApplication::sendEvent(editor, &press);
+        }
+        QCoreApplication::processEvents();
+        editor->viewport()->repaint();
+        repeats.append(timer.nsecsElapsed() / RepeatsPerBurst);
+    }
+    result["autoRepeat"] = distribution(repeats); // per key
+
+    result["scroll"] = pageThrough(editor); // per frame
+
+    // Typing at the end of the first lines at once, a caret on each (Shift+Alt+I)
+    const TextSnapshot &lines = tab.buffer()->table();
+    const qsizetype caretLines = qMin(qsizetype(MultiCarets), lines.lineCount());
+    cursor.setPosition(0);
+    cursor.setPosition(int(caretLines < lines.lineCount() ? lines.lineStart(caretLines) : lines.length()), QTextCursor::KeepAnchor);
+    editor->setTextCursor(cursor);
+    QKeyEvent addCarets(QEvent::KeyPress, Qt::Key_I, Qt::ShiftModifier | Qt::AltModifier);
+    QCoreApplication::sendEvent(editor, &addCarets);
+    editor->viewport()->repaint();
+    if (TextEditor *textEditor = qobject_cast<TextEditor *>(editor))
+    {
+        QList<qint64> samples;
+        for (int i = 0; i < MultiCaretKeystrokes; ++i)
+        {
+            QKeyEvent press(QEvent::KeyPress, Qt::Key_A, Qt::NoModifier, "a");
+            timer.restart();
+            QCoreApplication::sendEvent(editor, &press);
+            editor->viewport()->repaint();
+            samples.append(timer.nsecsElapsed());
+        }
+        QJsonObject multiCaret = distribution(samples); // per key, for all the carets
+        multiCaret["carets"] = textEditor->caretCount();
+        result["multiCaretTyping"] = multiCaret;
+        textEditor->clearCarets();
+    }
+
+    // Find next: the first one waits for the search, the others use its results
+    FindDialog dialog(editor, tab.buffer());
+    dialog.setPattern("needle", "pin");
+    cursor.setPosition(0);
+    editor->setTextCursor(cursor);
+
+    bool selected = false;
+    const QMetaObject::Connection selection = QObject::connect(editor, &QPlainTextEdit::selectionChanged, [&selected]() { selected = true; });
+    timer.restart();
+    dialog.findNext();
+    if (waitUntil([&]() { return selected; }))
+    {
+        const qint64 firstNs = timer.nsecsElapsed();
+        QList<qint64> samples;
+        for (int i = 0; i < FindNexts; ++i)
+        {
+            selected = false;
+            timer.restart();
+            dialog.findNext();
+            if (!waitUntil([&]() { return selected; }))
+                break;
+            samples.append(timer.nsecsElapsed());
+        }
+        QJsonObject findNext = distribution(samples);
+        findNext["firstMs"] = milliseconds(firstNs);
+        result["findNext"] = findNext;
+    }
+    QObject::disconnect(selection);
+
+    // Replace all, as one edit
+    timer.restart();
+    const int replacements = dialog.replaceAllMatches();
+    result["replaceAll"] = QJsonObject{ { "ms", milliseconds(timer.nsecsElapsed()) }, { "replacements", replacements } };
+
+    // Taking it back and doing it again
+    timer.restart();
+    tab.history()->undo();
+    const qint64 undoNs = timer.nsecsElapsed();
+    timer.restart();
+    tab.history()->redo();
+    result["undoReplaceAll"] = QJsonObject{ { "undoMs", milliseconds(undoNs) }, { "redoMs", milliseconds(timer.nsecsElapsed()) },
+                                            { "historyBytes", tab.history()->memoryUsed() } };
+
+    result["peakResidentBytes"] = ProcessMemory::peakResident();
+    return result;
+}
+
+QJsonObject Benchmark::scroll(const QString &folder, qint64 lines)
+{
+    QJsonObject result{ { "lines", lines } };
+    const QString filePath = folder + QString("/lines-%1.txt").arg(lines);
+    if (!writeLines(filePath, lines))
+    {
+        result["error"] = "Couldn't write the lines";
+        return result;
+    }
+
+    DocumentTab tab(filePath);
+    tab.resize(1000, 700);
+    tab.show();
+    QElapsedTimer timer;
+
+    bool loaded = false;
+    QObject::connect(tab.loader(), &DocumentLoader::finished, [&loaded](bool success) { loaded = success; });
+    timer.start();
+    if (!tab.load() || !waitUntil([&]() { return !tab.loader()->isRunning(); }) || !loaded)
+    {
+        result["error"] = "Couldn't load: " + tab.loader()->errorString();
+        return result;
+    }
+    result["load"] = QJsonObject{ { "ms", milliseconds(timer.nsecsElapsed()) } };
+
+    result["scroll"] = pageThrough(tab.editor()); // per frame
+    result["peakResidentBytes"] = ProcessMemory::peakResident();
+    return result;
+}
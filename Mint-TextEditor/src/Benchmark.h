@@ -0,0 +1,25 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QJsonObject>
+#include <QList>
+
+// Headless measurements of the editor core, for tracking regressions
+// between releases:
+//   Mint --benchmark -platform offscreen > results.json
+// Generated files of each size are loaded, saved, searched and typed into
+// through the same classes the window uses, and the results come out as
+// JSON. The files are freshly written, so loads read from a warm cache.
+// tests/benchmark reports the same measurements as QTest results.
+class Benchmark
+{
+public:
+    static QJsonObject run(const QList<qint64> &sizes);
+    static QList<qint64> largeSizes(); // 100 MB and 1 GB, only on request
+    // One file of 'size' bytes written into 'folder', as in a run
+    static QJsonObject measure(const QString &folder, qint64 size);
+    // Load time and paging frame times of a document of 'lines' short lines
+    static QJsonObject scroll(const QString &folder, qint64 lines);
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,341 @@
+#include "DocumentJournal.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDataStream>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QUuid>
+#include <QTextCursor>
+#include <cstring>
+
+static const char Magic[] = "MINTJRNL";
+static const quint32 Version = 1;
+static const QDataStream::Version StreamVersion = QDataStream::Qt_6_0;
+// Pending edits are written this often, or as soon as they insert this much
+static const int FlushIntervalMs = 1000;
+static const qsizetype FlushChars = 64 * 1024;
+// The log is compacted once it is larger than this and than twice the text
+static const qint64 CompactMinimum = 1024 * 1024;
+static const char RegistryKey[] = "recovery/journals";
+
+static bool readHeader(QDataStream &in, DocumentJournal::Header *header)
+{
+    char magic[sizeof(Magic) - 1];
+    quint32 version = 0;
+    if (in.readRawData(magic, sizeof(magic)) != int(sizeof(magic)) || memcmp(magic, Magic, sizeof(magic)) != 0)
+        return false;
+
+    in >> version >> header->filePath >> header->fileSize >> header->fileModified;
+    return in.status() == QDataStream::Ok && version == Version;
+}
+
+DocumentJournal::DocumentJournal(TextBuffer *buffer, QObject *parent)
+    : QObject(parent), textBuffer(buffer), header{ QString(), 0, 0 }, baseLength(0), savedLength(0), active(false),
+      created(false), written(0), pendingChars(0), saving(false)
+{
+    // Writes happen in order
+    pool.setMaxThreadCount(1);
+
+    flushTimer = new QTimer(this);
+    flushTimer->setSingleShot(true);
+    flushTimer->setInterval(FlushIntervalMs);
+    connect(flushTimer, &QTimer::timeout, this, &DocumentJournal::flush);
+}
+
+DocumentJournal::~DocumentJournal()
+{
+    flush();
+    pool.waitForDone();
+}
+
+void DocumentJournal::start(const QString &filePath)
+{
+    discard();
+
+    const QFileInfo info(filePath);
+    header = Header{ filePath, filePath.isEmpty() ? 0 : info.size(),
+                     filePath.isEmpty() ? 0 : info.lastModified().toMSecsSinceEpoch() };
+    path.clear(); // chosen by the first flush, most documents are never edited
+    baseLength = textBuffer->length();
+    active = true;
+}
+
+void DocumentJournal::record(qsizetype position, qsizetype removed, qsizetype added)
+{
+    if (!active)
+        return;
+
+    const QString text = textBuffer->table().text(position, added);
+
+    // Keystrokes extend the last operation instead of adding one each
+    const auto append = [&](QList<Operation> &operations) {
+        if (!operations.isEmpty())
+        {
+            Operation &last = operations.last();
+            const qsizetype lastEnd = last.position + last.text.size();
+
+            if (removed == 0 && position == lastEnd)
+            {
+                last.text += text; // typing
+                return;
+            }
+            if (added == 0 && position + removed == lastEnd && removed <= last.text.size())
+            {
+                last.text.chop(removed); // backspace over what was typed
+                return;
+            }
+            if (added == 0 && last.text.isEmpty() && (position + removed == last.position || position == last.position))
+            {
+                last.position = position; // more backspaces or deletes
+                last.removed += removed;
+                return;
+            }
+        }
+        operations.append(Operation{ position, removed, text });
+    };
+
+    append(pending);
+    if (saving)
+        append(sinceSave);
+    pendingChars += added;
+
+    if (pendingChars >= FlushChars)
+        flush();
+    else if (!flushTimer->isActive())
+        flushTimer->start();
+}
+
+void DocumentJournal::flush()
+{
+    flushTimer->stop();
+    if (!active || pending.isEmpty())
+        return;
+
+    QByteArray data = encode(pending);
+    const bool truncate = !created;
+    if (!created)
+    {
+        path = journalPathFor(header.filePath);
+        data.prepend(encodeHeader(header));
+        created = true;
+        registerJournal(path, true);
+    }
+
+    pending.clear();
+    pendingChars = 0;
+    written += data.size();
+    write(data, truncate);
+
+    if (written > qMax(CompactMinimum, 2 * qint64(textBuffer->length())))
+        compact();
+}
+
+void DocumentJournal::write(const QByteArray &data, bool truncate)
+{
+    const QString journal = path;
+    pool.start([journal, data, truncate]() {
+        QFile file(journal);
+        if (file.open(truncate ? QIODevice::WriteOnly | QIODevice::Truncate : QIODevice::WriteOnly | QIODevice::Append))
+        {
+            file.write(data);
+            file.flush();
+        }
+    });
+}
+
+void DocumentJournal::compact()
+{
+    // The whole base replaced by the current text, as one operation. The
+    // log had to grow larger than the text first, so over time this costs
+    // no more than the edits did.
+    const TextSnapshot text = textBuffer->snapshot();
+    const QString journal = path;
+    const QByteArray head = encodeHeader(header);
+    const qsizetype replaced = baseLength;
+
+    pool.start([journal, head, text, replaced]() {
+        QSaveFile file(journal);
+        if (!file.open(QIODevice::WriteOnly))
+            return;
+        file.write(head);
+        file.write(encode({ Operation{ 0, replaced, text.toString() } }));
+        file.commit();
+    });
+    written = head.size() + text.length();
+}
+
+void DocumentJournal::discard()
+{
+    flushTimer->stop();
+    pending.clear();
+    pendingChars = 0;
+
+    if (created)
+    {
+        const QString journal = path;
+        pool.start([journal]() { QFile::remove(journal); });
+        registerJournal(path, false);
+    }
+
+    created = false;
+    written = 0;
+    active = false;
+}
+
+void DocumentJournal::saveStarted()
+{
+    saving = true;
+    sinceSave.clear();
+    savedLength = textBuffer->length();
+}
+
+void DocumentJournal::saveFinished(bool success, const QString &filePath)
+{
+    if (!saving)
+        return;
+
+    saving = false;
+    const QList<Operation> edits = std::move(sinceSave);
+    sinceSave.clear();
+    if (!success)
+        return;
+
+    // The saved file is the new base, only the edits made since it was
+    // taken are left to journal
+    start(filePath);
+    baseLength = savedLength;
+    pending = edits;
+    for (const Operation &operation : edits)
+        pendingChars += operation.text.size();
+    if (!pending.isEmpty())
+        flushTimer->start();
+}
+
+QString DocumentJournal::journalPathFor(const QString &filePath)
+{
+    const QFileInfo info(filePath);
+    if (!filePath.isEmpty() && QFileInfo(info.absolutePath()).isWritable())
+        return info.absoluteDir().filePath("." + info.fileName() + ".mint-journal");
+
+    // New documents, and files in read-only folders
+    QDir folder(QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation));
+    folder.mkpath("journals");
+    const QString name = filePath.isEmpty() ? QUuid::createUuid().toString(QUuid::WithoutBraces)
+                                            : QString::number(qHash(info.absoluteFilePath()), 16);
+    return folder.filePath("journals/" + name + ".mint-journal");
+}
+
+QByteArray DocumentJournal::encodeHeader(const Header &header)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+    out.writeRawData(Magic, sizeof(Magic) - 1);
+    out << Version << header.filePath << header.fileSize << header.fileModified;
+    return data;
+}
+
+QByteArray DocumentJournal::encode(const QList<Operation> &operations)
+{
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(StreamVersion);
+
+    for (const Operation &operation : operations)
+    {
+        QByteArray record;
+        QDataStream fields(&record, QIODevice::WriteOnly);
+        fields.setVersion(StreamVersion);
+        fields << qint64(operation.position) << qint64(operation.removed) << operation.text.toUtf8();
+
+        // A write cut short by a crash fails its checksum
+        out << record << qChecksum(record);
+    }
+    return data;
+}
+
+void DocumentJournal::registerJournal(const QString &journalPath, bool pending)
+{
+    QSettings settings;
+    QStringList journals = settings.value(RegistryKey).toStringList();
+    journals.removeAll(journalPath);
+    if (pending)
+        journals.append(journalPath);
+    settings.setValue(RegistryKey, journals);
+}
+
+QStringList DocumentJournal::pendingJournals()
+{
+    QStringList journals;
+    for (const QString &journal : QSettings().value(RegistryKey).toStringList())
+    {
+        if (QFile::exists(journal))
+            journals.append(journal);
+        else
+            registerJournal(journal, false);
+    }
+    return journals;
+}
+
+bool DocumentJournal::readHeader(const QString &journalPath, Header *header)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+    return ::readHeader(in, header);
+}
+
+bool DocumentJournal::replay(const QString &journalPath, QTextDocument *document)
+{
+    QFile file(journalPath);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream in(&file);
+    in.setVersion(StreamVersion);
+    Header header;
+    if (!::readHeader(in, &header))
+        return false;
+
+    QTextCursor cursor(document);
+    cursor.beginEditBlock();
+
+    // Up to the first damaged record, the last write may have been cut short
+    while (!in.atEnd())
+    {
+        QByteArray record;
+        quint16 checksum = 0;
+        in >> record >> checksum;
+        if (in.status() != QDataStream::Ok || qChecksum(record) != checksum)
+            break;
+
+        QDataStream fields(record);
+        fields.setVersion(StreamVersion);
+        qint64 position = 0, removed = 0;
+        QByteArray text;
+        fields >> position >> removed >> text;
+
+        const qint64 length = document->characterCount() - 1;
+        if (fields.status() != QDataStream::Ok || position < 0 || removed < 0 || position + removed > length)
+            break;
+
+        cursor.setPosition(int(position));
+        cursor.setPosition(int(position + removed), QTextCursor::KeepAnchor);
+        cursor.insertText(QString::fromUtf8(text));
+    }
+
+    cursor.endEditBlock();
+    return true;
+}
+
+void DocumentJournal::remove(const QString &journalPath)
+{
+    QFile::remove(journalPath);
+    registerJournal(journalPath, false);
+}
@@ -0,0 +1,88 @@
+#ifndef DOCUMENTJOURNAL_H
+#define DOCUMENTJOURNAL_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QTimer>
+#include <QTextDocument>
+
+#include "TextBuffer.h"
+
+// Crash-recovery journal of a document: an append-only log of its edits
+// since it was last loaded or saved. Each edit is stored as an operation
+// (offset, removed length, inserted UTF-8 text), so recording costs what the
+// edit inserted, whatever the size of the document. Operations are merged
+// while typing, then written by batches from a worker thread. When the log
+// outgrows the document it is compacted into a single operation.
+//
+// The journal of a file lives next to it, the one of a new document in the
+// application data folder. A journal still there at startup means the
+// session didn't end normally: the file plus the journal give the document.
+class DocumentJournal : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Header
+    {
+        QString filePath; // empty for a new document
+        qint64 fileSize;
+        qint64 fileModified; // ms since the epoch, UTC
+    };
+
+    DocumentJournal(TextBuffer *buffer, QObject *parent = nullptr);
+    ~DocumentJournal(); // writes what is pending
+
+    // Starts an empty journal over 'filePath' as it is on disk now
+    void start(const QString &filePath);
+    void record(qsizetype position, qsizetype removed, qsizetype added);
+    void flush();
+    void discard(); // removes the journal, the document is safe
+
+    // A save of the current text is starting; once it has succeeded the
+    // journal restarts over the saved file with the edits made meanwhile
+    void saveStarted();
+    void saveFinished(bool success, const QString &filePath);
+
+    QString journalPath() const { return path; } // empty until the first edit is written
+
+    // Journals left by sessions that didn't end normally
+    static QStringList pendingJournals();
+    static bool readHeader(const QString &journalPath, Header *header);
+    // Applies the journal's edits to 'document', which holds the base text
+    static bool replay(const QString &journalPath, QTextDocument *document);
+    static void remove(const QString &journalPath);
+
+private:
+    struct Operation
+    {
+        qsizetype position;
+        qsizetype removed;
+        QString text;
+    };
+
+    static QString journalPathFor(const QString &filePath);
+    static QByteArray encodeHeader(const Header &header);
+    static QByteArray encode(const QList<Operation> &operations);
+    static void registerJournal(const QString &journalPath, bool pending);
+    void write(const QByteArray &data, bool truncate);
+    void compact();
+
+    TextBuffer *textBuffer;
+    QThreadPool pool;
+    QTimer *flushTimer;
+    QString path;
+    Header header;
+    qsizetype baseLength; // of the text the journal starts from
+    qsizetype savedLength;
+    bool active;
+    bool created;    // the journal file exists
+    qint64 written;  // bytes written to it, roughly
+    QList<Operation> pending;
+    qsizetype pendingChars;
+    // Edits since a save started, they become the new journal once it succeeds
+    bool saving;
+    QList<Operation> sinceSave;
+};
+
+#endif // DOCUMENTJOURNAL_H
@@ -0,0 +1,306 @@
+#include "DocumentLoader.h"
+#include "LineIndex.h"
+#include "Trace.h"
+#include <QStringConverter>
+#include <QTextCursor>
+#include <QTextDocument>
+#include <QTimer>
+#include <QThreadPool>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+// Bytes decoded per step, and how long a single event-loop slice may run
+static const qint64 ChunkSize = 1024 * 1024;
+static const qint64 TimeSliceMs = 15;
+// Read ahead of a load, enough for the first screens and more
+static const qint64 PrefetchSize = 64 * 1024 * 1024;
+
+DocumentLoader::DocumentLoader(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent)
+    : QObject(parent), textEditor(textEdit), textBuffer(buffer), file(nullptr),
+      guessingEncoding(false), lineEndingFound(false), previousCarriageReturn(false), direct(true), traceStart(-1), fileSize(0), offset(0), pendingCarriageReturn(false), running(false)
+{
+}
+
+DocumentLoader::~DocumentLoader()
+{
+    // The editor may already be gone here
+    delete file;
+}
+
+void DocumentLoader::prefetch(const QString &filePath)
+{
+    QThreadPool::globalInstance()->start([filePath]() {
+        QFile file(filePath);
+        if (!file.open(QIODevice::ReadOnly))
+            return;
+
+#ifdef Q_OS_UNIX
+        // The kernel reads the pages in, nothing is copied here
+        const qint64 size = qMin(file.size(), PrefetchSize);
+        if (size > 0)
+        {
+            if (uchar *data = file.map(0, size))
+            {
+                madvise(data, size_t(size), MADV_WILLNEED);
+                file.unmap(data);
+                return;
+            }
+        }
+#endif
+        QByteArray block(ChunkSize, Qt::Uninitialized);
+        for (qint64 read = 0; read < PrefetchSize; read += block.size())
+        {
+            if (file.read(block.data(), block.size()) <= 0)
+                break;
+        }
+    });
+}
+
+bool DocumentLoader::start(const QString &filePath)
+{
+    cancel();
+
+    file = new QFile(filePath);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        error = file->errorString();
+        delete file;
+        file = nullptr;
+        return false;
+    }
+
+    path = filePath;
+    error.clear();
+    fileSize = file->size();
+    offset = 0;
+    pendingCarriageReturn = false;
+    decodedText.clear();
+    directText.clear();
+    newlines.clear();
+    hashes = TextHash::Sampler();
+
+    // A byte order mark settles the encoding, otherwise UTF-8 is validated
+    // on the way and the load starts over as Latin-1 if it turns out wrong
+    textFormat = TextFormat();
+    const QByteArray head = file->peek(4);
+    const std::optional<QStringConverter::Encoding> marked = QStringConverter::encodingForData(head);
+    if (marked)
+    {
+        textFormat.encoding = *marked;
+        textFormat.bom = true;
+    }
+    guessingEncoding = !marked;
+    validator = Utf8Validator();
+    decoder = QStringDecoder(textFormat.encoding);
+    direct = !textFormat.bom;
+    lineEndingFound = false;
+    previousCarriageReturn = false;
+
+    running = true;
+    timer.start();
+    traceStart = Trace::begin();
+
+    // The document is rebuilt from scratch, the buffer takes it once loaded
+    textBuffer->setTracking(false);
+    textEditor->clear();
+    textEditor->setReadOnly(true);
+
+    QTimer::singleShot(0, this, &DocumentLoader::loadNextChunk);
+
+    return true;
+}
+
+void DocumentLoader::cancel()
+{
+    if (running)
+        stop();
+}
+
+void DocumentLoader::loadNextChunk()
+{
+    if (!running)
+        return;
+
+    QElapsedTimer slice;
+    slice.start();
+
+    QTextCursor cursor(textEditor->document());
+    cursor.movePosition(QTextCursor::End);
+
+    // Feed chunks until the slice is used up, then give the event loop a turn
+    while (offset < fileSize && slice.elapsed() < TimeSliceMs)
+    {
+        QByteArrayView chunk = nextChunk();
+        if (chunk.isEmpty())
+        {
+            error = file->errorString();
+            stop();
+            Trace::end(Trace::Load, traceStart);
+            emit finished(false, timer.elapsed());
+            return;
+        }
+
+        if (guessingEncoding && !validator.append(chunk))
+        {
+            restartAsLatin1();
+            continue;
+        }
+
+        // The bytes can only be kept while they are the characters
+        if (direct && !TextFormat::isDirectText(chunk, textFormat.encoding == QStringConverter::Latin1))
+        {
+            direct = false;
+            decodedText = QString::fromLatin1(directText);
+            directText = QByteArray();
+        }
+
+        const QString decoded = decoder.decode(chunk);
+        if (!lineEndingFound)
+            detectLineEnding(decoded);
+        const QString text = normalizeLineEndings(decoded, pendingCarriageReturn);
+        cursor.insertText(text);
+
+        // Offsets of direct bytes are also character offsets
+        if (direct)
+        {
+            LineIndex::findNewlines(chunk.data(), chunk.size(), offset, newlines);
+            hashes.append(chunk.data(), chunk.size());
+            if (directText.isEmpty())
+                directText.reserve(fileSize);
+            directText.append(chunk);
+        }
+        else
+        {
+            LineIndex::findNewlines(text.constData(), text.size(), decodedText.size(), newlines);
+            hashes.append(text.constData(), text.size());
+            decodedText.append(text);
+        }
+        offset += chunk.size();
+    }
+
+    // A sequence cut by the end of the file
+    if (offset >= fileSize && guessingEncoding && !validator.isComplete())
+        restartAsLatin1();
+
+    emit progress(offset, fileSize);
+
+    if (offset < fileSize)
+        QTimer::singleShot(0, this, &DocumentLoader::loadNextChunk);
+    else
+        finish();
+}
+
+QByteArrayView DocumentLoader::nextChunk()
+{
+    // Read, not mapped: a file cut short by another program would make
+    // reading a mapping past its new end crash the process
+    readBuffer = file->read(qMin(ChunkSize, fileSize - offset));
+    return QByteArrayView(readBuffer);
+}
+
+void DocumentLoader::restartAsLatin1()
+{
+    // Not UTF-8 after all. In Latin-1 any byte is a character.
+    guessingEncoding = false;
+    textFormat.encoding = QStringConverter::Latin1;
+    decoder = QStringDecoder(textFormat.encoding);
+    direct = true;
+    lineEndingFound = false;
+    previousCarriageReturn = false;
+    pendingCarriageReturn = false;
+
+    offset = 0;
+    file->seek(0);
+    decodedText.clear();
+    directText.clear();
+    newlines.clear();
+    hashes = TextHash::Sampler();
+    textEditor->clear();
+}
+
+void DocumentLoader::detectLineEnding(QStringView text)
+{
+    // The first line ending gives the style of the file
+    for (QChar c : text)
+    {
+        if (previousCarriageReturn || c == u'\n')
+        {
+            textFormat.lineEnding = !previousCarriageReturn ? TextFormat::LF : c == u'\n' ? TextFormat::CRLF : TextFormat::CR;
+            lineEndingFound = true;
+            return;
+        }
+        previousCarriageReturn = c == u'\r';
+    }
+}
+
+QString DocumentLoader::normalizeLineEndings(QString text, bool &pendingCarriageReturn)
+{
+    // CRLF and lone CR both become LF
+    if (!pendingCarriageReturn && !text.contains(u'\r'))
+        return text;
+
+    QChar *data = text.data();
+    qsizetype written = 0;
+
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        const QChar c = data[i];
+        if (c == u'\n' && pendingCarriageReturn)
+        {
+            pendingCarriageReturn = false;
+            continue;
+        }
+
+        pendingCarriageReturn = (c == u'\r');
+        data[written++] = pendingCarriageReturn ? QChar(u'\n') : c;
+    }
+
+    text.truncate(written);
+    return text;
+}
+
+void DocumentLoader::finish()
+{
+    if (!lineEndingFound && previousCarriageReturn)
+        textFormat.lineEnding = TextFormat::CR;
+
+    // Hand the text over to the piece table, moved rather than shared so the
+    // loader holds nothing once done: the bytes themselves when possible,
+    // else the decoded text without the slack it grew with
+    readBuffer = QByteArray();
+    newlines.squeeze();
+    if (direct)
+    {
+        textBuffer->reset(QSharedPointer<TextChunk>::create(std::move(directText), std::move(newlines), hashes));
+    }
+    else
+    {
+        decodedText.squeeze();
+        textBuffer->reset(QSharedPointer<TextChunk>::create(std::move(decodedText), std::move(newlines), hashes));
+    }
+
+    stop();
+    Trace::end(Trace::Load, traceStart);
+    emit finished(true, timer.elapsed());
+}
+
+void DocumentLoader::stop()
+{
+    delete file;
+    file = nullptr;
+    readBuffer = QByteArray();
+    decodedText = QString();
+    directText = QByteArray();
+    newlines = QList<qsizetype>();
+    hashes = TextHash::Sampler();
+
+    // Interrupted load: the buffer follows whatever made it into the document
+    if (!textBuffer->isTracking())
+        textBuffer->resetFromDocument();
+    running = false; // not before, the reset is still the load
+
+    textEditor->setReadOnly(false);
+    textEditor->moveCursor(QTextCursor::Start);
+}
@@ -0,0 +1,89 @@
+#ifndef DOCUMENTLOADER_H
+#define DOCUMENTLOADER_H
+
+#include <QObject>
+#include <QFile>
+#include <QElapsedTimer>
+#include <QStringDecoder>
+#include <QPlainTextEdit>
+
+#include "TextBuffer.h"
+#include "TextFormat.h"
+
+// Loads a file into an editor without blocking the GUI thread: the file is
+// read and decoded chunk by chunk and appended to the document from short
+// event-loop slices, so the window stays responsive while it grows.
+// The encoding comes from the byte order mark, else the file is UTF-8 if it
+// validates as such and Latin-1 otherwise; the first line ending gives the
+// style to save with. ASCII files, and Latin-1 ones, without CR are kept as
+// bytes for the original buffer of the TextBuffer's piece table, half the
+// size of the decoded text. The file itself is never kept mapped: another
+// program truncating it would crash every later read. The text is hashed and
+// its newlines indexed on the way, so neither the document hash nor line
+// lookups ever need another pass over the file.
+class DocumentLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    DocumentLoader(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent = nullptr);
+    ~DocumentLoader();
+
+    bool start(const QString &filePath); // false if the file can't be opened
+    void cancel(); // stops silently, finished() isn't emitted
+
+    bool isRunning() const { return running; }
+    qint64 loadedSize() const { return fileSize; } // bytes of the file in the document
+    TextFormat format() const { return textFormat; }
+    QString filePath() const { return path; }
+    QString errorString() const { return error; }
+
+    // Same result as QIODevice::Text, chunk by chunk: a CR at the end of a
+    // chunk may be followed by the LF of the next one
+    static QString normalizeLineEndings(QString text, bool &pendingCarriageReturn);
+
+    // Starts reading the file into the system cache from a pool thread, so
+    // a load that follows soon (a file given at startup) finds it in memory
+    static void prefetch(const QString &filePath);
+
+signals:
+    void progress(qint64 bytesRead, qint64 bytesTotal);
+    void finished(bool success, qint64 elapsedMs);
+
+private slots:
+    void loadNextChunk();
+
+private:
+    QByteArrayView nextChunk();
+    void restartAsLatin1();
+    void detectLineEnding(QStringView text);
+    void finish();
+    void stop();
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    QFile *file;
+    QString path;
+    QString error;
+    QStringDecoder decoder;
+    TextFormat textFormat;
+    Utf8Validator validator;
+    bool guessingEncoding; // no byte order mark, UTF-8 until proven otherwise
+    bool lineEndingFound;
+    bool previousCarriageReturn;
+    QElapsedTimer timer;
+    qint64 traceStart;
+
+    QByteArray readBuffer;
+    QByteArray directText; // original text while it is direct
+    QString decodedText;   // original text otherwise
+    QList<qsizetype> newlines; // line index of the original text
+    TextHash::Sampler hashes;  // and its prefix hashes
+    bool direct; // the bytes so far are the characters, see TextFormat::isDirectText
+    qint64 fileSize;
+    qint64 offset;
+    bool pendingCarriageReturn;
+    bool running;
+};
+
+#endif // DOCUMENTLOADER_H
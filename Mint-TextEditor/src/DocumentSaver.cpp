@@ -0,0 +1,139 @@
+#include "DocumentSaver.h"
+#include "ProcessMemory.h"
+#include "Trace.h"
+#include <QSaveFile>
+#include <QStringEncoder>
+
+// Characters encoded and written per step
+static const qsizetype SliceSize = 1024 * 1024;
+
+DocumentSaver::DocumentSaver(QObject *parent)
+    : QObject(parent), traceStart(-1), succeeded(false), running(false)
+{
+    pool.setMaxThreadCount(1);
+}
+
+DocumentSaver::~DocumentSaver()
+{
+    pool.waitForDone();
+}
+
+bool DocumentSaver::start(const TextSnapshot &text, const QString &filePath, const TextFormat &format)
+{
+    if (running)
+        return false;
+
+    path = filePath;
+    textFormat = format;
+    error.clear();
+    succeeded = false;
+    running = true;
+    timer.start();
+    traceStart = Trace::begin();
+
+    // The snapshot is immutable, editing can go on while it is written
+    pool.start([this, text]() {
+        succeeded = write(text);
+        QMetaObject::invokeMethod(this, &DocumentSaver::complete, Qt::QueuedConnection);
+    });
+
+    return true;
+}
+
+bool DocumentSaver::waitForFinished()
+{
+    pool.waitForDone();
+    complete();
+    return succeeded;
+}
+
+bool DocumentSaver::write(const TextSnapshot &text)
+{
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    QStringEncoder encoder(textFormat.encoding);
+    const bool utf8 = textFormat.encoding == QStringConverter::Utf8;
+    const bool latin1 = textFormat.encoding == QStringConverter::Latin1;
+    const bool lf = textFormat.lineEnding == TextFormat::LF;
+    const QLatin1String newline(textFormat.lineEndingBytes());
+    const qsizetype total = text.length();
+    qsizetype written = 0;
+
+    const QByteArray bom = textFormat.bomBytes();
+    bool ok = file.write(bom) == bom.size();
+
+    text.forEachSpan(0, total, [&](const TextSpan &span) {
+        for (qsizetype start = 0; start < span.length && ok; start += SliceSize)
+        {
+            const TextSpan slice = span.mid(start, qMin(SliceSize, span.length - start));
+
+            if (slice.latin1 && (latin1 || (utf8 && TextFormat::isAscii(QByteArrayView(slice.latin1, slice.length)))))
+            {
+                // Already the file's bytes, only line endings may change
+                if (lf)
+                    ok = file.write(slice.latin1, slice.length) == slice.length;
+                else
+                    ok = file.write(QByteArray(slice.latin1, slice.length).replace("\n", newline.data())) >= 0;
+            }
+            else if (lf && slice.utf16)
+            {
+                ok = file.write(encoder(QStringView(slice.utf16, slice.length))) >= 0;
+            }
+            else
+            {
+                QString characters;
+                slice.appendTo(characters);
+                if (!lf)
+                    characters.replace(u'\n', newline);
+                ok = file.write(encoder(characters)) >= 0;
+            }
+
+            written += slice.length;
+            QMetaObject::invokeMethod(this, [this, written, total]() {
+                if (running)
+                    emit progress(written, total);
+            }, Qt::QueuedConnection);
+        }
+        return ok;
+    });
+
+    // Characters Latin-1 doesn't have
+    if (ok && encoder.hasError() && textFormat.encoding != QStringConverter::Utf8)
+    {
+        file.cancelWriting();
+        textFormat.encoding = QStringConverter::Utf8;
+        textFormat.bom = false;
+        return write(text);
+    }
+
+    if (!ok)
+    {
+        error = file.errorString();
+        file.cancelWriting();
+        return false;
+    }
+
+    // Flushes and syncs the temporary file, then renames it over the target
+    if (!file.commit())
+    {
+        error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+void DocumentSaver::complete()
+{
+    if (!running)
+        return;
+
+    running = false;
+    Trace::end(Trace::Save, traceStart);
+    emit finished(succeeded, timer.elapsed(), ProcessMemory::peakResident());
+}
@@ -0,0 +1,53 @@
+#ifndef DOCUMENTSAVER_H
+#define DOCUMENTSAVER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QElapsedTimer>
+
+#include "PieceTable.h"
+#include "TextFormat.h"
+
+// Writes a text snapshot to disk on a worker thread. The text is encoded and
+// written by fixed-size slices straight from the piece table, never as one
+// big string, into a QSaveFile: the target is only replaced, atomically and
+// once synced, when everything has been written. A failed save leaves the
+// previous file untouched.
+// The document's encoding, byte order mark and line endings are kept; text
+// that Latin-1 can't encode is saved as UTF-8 instead.
+class DocumentSaver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit DocumentSaver(QObject *parent = nullptr);
+    ~DocumentSaver();
+
+    bool start(const TextSnapshot &text, const QString &filePath, const TextFormat &format); // false if a save is running
+    bool waitForFinished(); // blocks until done, returns whether it succeeded
+
+    bool isRunning() const { return running; }
+    QString filePath() const { return path; }
+    TextFormat format() const { return textFormat; } // the file's, once saved
+    QString errorString() const { return error; }
+
+signals:
+    void progress(qint64 charsWritten, qint64 charsTotal);
+    void finished(bool success, qint64 elapsedMs, qint64 peakMemory);
+
+private:
+    bool write(const TextSnapshot &text);
+    void complete();
+
+    QThreadPool pool;
+    QElapsedTimer timer;
+    qint64 traceStart;
+    QString path;
+    TextFormat textFormat;
+    // Written by the worker, read once it is done
+    QString error;
+    bool succeeded;
+    bool running;
+};
+
+#endif // DOCUMENTSAVER_H
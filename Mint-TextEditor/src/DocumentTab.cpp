@@ -0,0 +1,368 @@
+#include "DocumentTab.h"
+#include <QVBoxLayout>
+#include <QScrollBar>
+#include <QFileInfo>
+#include <QSettings>
+
+DocumentTab::DocumentTab(const QString &filePath, QWidget *parent)
+    : QWidget(parent), documentMinimap(nullptr), markdownPreview(nullptr), largeView(nullptr), path(filePath), modified(false), loaded(filePath.isEmpty()), unloading(false),
+      savedHash(0), savedLength(0), previousHash(0), previousLength(0), activation(0), restorePending(false), restorePosition(0), restoreScroll(0),
+      locationLine(0), locationColumn(0)
+{
+    TextEditor *editor = new TextEditor(this);
+    textEditor = editor;
+    textEditor->setFont(QFont("Consolas",11));
+    textEditor->setTabStopDistance(40);
+
+    // The editor and its minimap share one side of the splitter
+    QWidget *editorArea = new QWidget;
+    editorLayout = new QHBoxLayout(editorArea);
+    editorLayout->setContentsMargins(0, 0, 0, 0);
+    editorLayout->setSpacing(0);
+    editorLayout->addWidget(textEditor);
+
+    splitter = new QSplitter(Qt::Horizontal, this);
+    splitter->addWidget(editorArea);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addWidget(splitter);
+
+    // Plain-text model, chunked file loading and saving
+    textBuffer = new TextBuffer(textEditor->document(), this);
+    documentLoader = new DocumentLoader(textEditor, textBuffer, this);
+    documentSaver = new DocumentSaver(this);
+    documentWatcher = new DocumentWatcher(textEditor, textBuffer, this);
+    undoHistory = new UndoHistory(textEditor, textBuffer, this);
+    editor->setUndoHistory(undoHistory);
+    editor->setTextBuffer(textBuffer);
+    documentWatcher->setUndoHistory(undoHistory);
+
+    // Unsaved edits survive a crash; a file's journal starts once it is loaded
+    journal = new DocumentJournal(textBuffer, this);
+    if (path.isEmpty())
+        journal->start(QString());
+
+    // Highlighting follows the file extension
+    syntaxHighlighter = new SyntaxHighlighter(textEditor, this);
+    syntaxHighlighter->setLanguage(SyntaxLanguage::forFileName(path));
+
+    connect(textBuffer, &TextBuffer::edited, this, [this](qsizetype position, qsizetype removed, qsizetype added) {
+        // A load starts the history over, a reload from disk can be undone;
+        // lines a followed file grew by are the file's, not edits
+        if (documentLoader->isRunning() || unloading)
+            undoHistory->clear();
+        else if (documentWatcher->isAppending())
+            undoHistory->skip();
+        else
+            undoHistory->record(position, removed, added);
+
+        if (isReadingFile())
+            return;
+        journal->record(position, removed, added);
+        updateModified();
+    });
+    connect(textEditor->document(), &QTextDocument::modificationChanged, this, &DocumentTab::updateModified);
+    connect(documentLoader, &DocumentLoader::finished, this, &DocumentTab::loadFinished);
+    connect(documentSaver, &DocumentSaver::finished, this, &DocumentTab::saveFinished);
+    connect(documentWatcher, &DocumentWatcher::finished, this, &DocumentTab::watchFinished);
+}
+
+DocumentTab::~DocumentTab()
+{
+    journal->discard();
+}
+
+void DocumentTab::setFilePath(const QString &filePath)
+{
+    path = filePath;
+    syntaxHighlighter->setLanguage(SyntaxLanguage::forFileName(filePath));
+    emit stateChanged();
+}
+
+QString DocumentTab::displayName() const
+{
+    return path.isEmpty() ? QString("Untitled") : QFileInfo(path).fileName();
+}
+
+void DocumentTab::setPreviewVisible(bool visible)
+{
+    if (visible == isPreviewVisible() || largeView)
+        return;
+
+    if (visible)
+    {
+        markdownPreview = new MarkdownPreview(textEditor, textBuffer, splitter);
+        splitter->addWidget(markdownPreview);
+    }
+    else
+    {
+        delete markdownPreview;
+        markdownPreview = nullptr;
+    }
+}
+
+void DocumentTab::setMinimapVisible(bool visible)
+{
+    if (largeView || visible == (documentMinimap && !documentMinimap->isHidden()))
+        return;
+
+    if (visible && !documentMinimap)
+    {
+        documentMinimap = new Minimap(textEditor, textBuffer);
+        editorLayout->addWidget(documentMinimap);
+    }
+    documentMinimap->setVisible(visible);
+}
+
+bool DocumentTab::load()
+{
+    documentSaver->waitForFinished(); // may be writing the file being opened
+
+    // Too large to load, paged in instead; the usual loader if it can't be opened
+    if (!largeView && QFileInfo(path).size() >= largeFileThreshold())
+    {
+        LargeFileView *view = new LargeFileView(splitter);
+        if (view->open(path))
+        {
+            largeView = view;
+            textEditor->parentWidget()->hide(); // with the minimap
+            splitter->addWidget(largeView);
+            textFormat = largeView->format();
+            loaded = true;
+            if (locationLine > 0)
+                goToLocation(locationLine, locationColumn);
+            emit stateChanged();
+            return true;
+        }
+        delete view;
+    }
+
+    if (!documentLoader->start(path))
+        return false;
+
+    syntaxHighlighter->setLanguage(SyntaxLanguage::forFileName(path));
+    loaded = true;
+    return true;
+}
+
+qint64 DocumentTab::largeFileThreshold()
+{
+    return QSettings().value("editor/largeFileThresholdMB", 256).toLongLong() * 1024 * 1024;
+}
+
+void DocumentTab::loadFinished(bool success)
+{
+    if (!success)
+    {
+        // Back to a new document
+        textEditor->clear();
+        undoHistory->clear();
+        setSavedText(textBuffer->hash(), textBuffer->length());
+        textFormat = TextFormat();
+        locationLine = 0;
+        setFilePath("");
+        documentWatcher->setFile(QString());
+        journal->start(QString());
+        replayRecovery();
+        return;
+    }
+
+    setSavedText(textBuffer->hash(), textBuffer->length());
+
+    if (restorePending)
+    {
+        QTextCursor cursor = textEditor->textCursor();
+        cursor.setPosition(qMin(restorePosition, textEditor->document()->characterCount() - 1));
+        textEditor->setTextCursor(cursor);
+        textEditor->verticalScrollBar()->setValue(restoreScroll);
+        restorePending = false;
+    }
+    if (locationLine > 0)
+        showLocation();
+
+    // Bytes written to the file while it was loading are new ones
+    textFormat = documentLoader->format();
+    documentWatcher->setFile(path, textFormat, documentLoader->loadedSize());
+    journal->start(path);
+    replayRecovery();
+    emit stateChanged();
+}
+
+void DocumentTab::recover(const QString &journalPath)
+{
+    recoveryPath = journalPath;
+    if (loaded && !documentLoader->isRunning())
+        replayRecovery();
+}
+
+void DocumentTab::goToLocation(int line, int column)
+{
+    if (largeView)
+    {
+        largeView->goToLine(line, column);
+        locationLine = 0;
+        return;
+    }
+
+    locationLine = line;
+    locationColumn = column;
+    if (loaded && !documentLoader->isRunning())
+        showLocation();
+}
+
+void DocumentTab::showLocation()
+{
+    // Out of range places stop at the last line, or at the end of the line
+    const TextSnapshot &text = textBuffer->table();
+    const qsizetype line = qBound(qsizetype(0), qsizetype(locationLine) - 1, text.lineCount() - 1);
+    const qsizetype start = text.lineStart(line);
+    const qsizetype end = line + 1 < text.lineCount() ? text.lineStart(line + 1) - 1 : text.length();
+
+    QTextCursor cursor = textEditor->textCursor();
+    cursor.setPosition(int(qMin(start + qMax(locationColumn - 1, 0), end)));
+    textEditor->setTextCursor(cursor);
+    textEditor->centerCursor();
+    locationLine = 0;
+}
+
+void DocumentTab::replayRecovery()
+{
+    if (recoveryPath.isEmpty())
+        return;
+
+    // The replayed edits go to this tab's own journal, which replaces the old one
+    DocumentJournal::replay(recoveryPath, textEditor->document());
+    DocumentJournal::remove(recoveryPath);
+    journal->flush();
+    recoveryPath.clear();
+}
+
+qint64 DocumentTab::memoryCost() const
+{
+    if (!loaded)
+        return 0;
+    if (largeView)
+        return largeView->memoryCost();
+
+    // UTF-16 text of the document plus a rough per-block overhead, the
+    // piece table's copy of the text and the history
+    const QTextDocument *document = textEditor->document();
+    return qint64(document->characterCount()) * 2 + qint64(document->blockCount()) * 128 + textBuffer->memoryUsed()
+           + undoHistory->memoryUsed();
+}
+
+bool DocumentTab::canUnload() const
+{
+    return loaded && !largeView && !modified && !path.isEmpty() && !documentLoader->isRunning() && !documentSaver->isRunning()
+           && !documentWatcher->isRunning();
+}
+
+void DocumentTab::unload()
+{
+    restorePosition = textEditor->textCursor().position();
+    restoreScroll = textEditor->verticalScrollBar()->value();
+    restorePending = true;
+
+    // Clearing also drops the undo history, the text is reloaded from the file
+    unloading = true;
+    documentWatcher->cancel();
+    textEditor->clear();
+    textBuffer->resetFromDocument();
+    unloading = false;
+    journal->discard();
+
+    loaded = false;
+}
+
+bool DocumentTab::save(const QString &filePath)
+{
+    // Not while the text is still coming from the file
+    if (largeView)
+        refusal = "Large files are read-only";
+    else if (documentLoader->isRunning())
+        refusal = "Wait for the document to be loaded before saving";
+    else if (documentWatcher->isAppending())
+        refusal = "Wait for the lines added to the file to be read before saving";
+    else if (documentWatcher->isRunning())
+        refusal = "Wait for the document to be reloaded from disk before saving";
+    else
+        refusal.clear();
+    if (!refusal.isEmpty())
+        return false;
+
+    // One save at a time, the latest text wins
+    documentSaver->waitForFinished();
+
+    const TextSnapshot text = textBuffer->snapshot();
+    if (!documentSaver->start(text, filePath, textFormat))
+    {
+        refusal = "The previous save is still running";
+        return false;
+    }
+
+    // The file will hold this text
+    previousHash = savedHash;
+    previousLength = savedLength;
+    setSavedText(text.hash(), text.length());
+    journal->saveStarted();
+    return true;
+}
+
+void DocumentTab::saveFinished(bool success)
+{
+    journal->saveFinished(success, documentSaver->filePath());
+    if (!success)
+    {
+        // The file still holds the text before the save
+        savedHash = previousHash;
+        savedLength = previousLength;
+        textEditor->document()->setModified(true);
+        undoHistory->setClean(false);
+        updateModified();
+        return;
+    }
+
+    textFormat = documentSaver->format();
+    setFilePath(documentSaver->filePath());
+    documentWatcher->setFile(path, textFormat);
+}
+
+void DocumentTab::watchFinished(bool success)
+{
+    if (!success)
+    {
+        updateModified(); // part of the new text may be in
+        return;
+    }
+
+    // The document holds the file again
+    setSavedText(textBuffer->hash(), textBuffer->length());
+    journal->start(path);
+}
+
+void DocumentTab::setSavedText(quint64 hash, qsizetype length)
+{
+    savedHash = hash;
+    savedLength = length;
+    textEditor->document()->setModified(false);
+    undoHistory->setClean();
+    if (documentMinimap)
+        documentMinimap->clearModified();
+    updateModified();
+}
+
+void DocumentTab::updateModified()
+{
+    if (isReadingFile())
+        return;
+
+    // Undone or redone back to the save, else the text's hash, kept up to
+    // date by the buffer, against the file's (retyping what was deleted)
+    const bool changed = !undoHistory->isClean() && (textBuffer->hash() != savedHash || textBuffer->length() != savedLength);
+    if (changed == modified)
+        return;
+
+    modified = changed;
+    emit stateChanged();
+}
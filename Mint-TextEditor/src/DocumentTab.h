@@ -0,0 +1,138 @@
+#ifndef DOCUMENTTAB_H
+#define DOCUMENTTAB_H
+
+#include <QWidget>
+#include <QPlainTextEdit>
+#include <QSplitter>
+#include <QHBoxLayout>
+
+#include "TextBuffer.h"
+#include "DocumentLoader.h"
+#include "DocumentSaver.h"
+#include "SyntaxHighlighter.h"
+#include "MarkdownPreview.h"
+#include "DocumentJournal.h"
+#include "DocumentWatcher.h"
+#include "TextEditor.h"
+#include "UndoHistory.h"
+#include "Minimap.h"
+#include "LargeFileView.h"
+
+// One open document: its editor (with its own undo history and cursor),
+// text model, loader, saver, watcher and highlighter. A tab opened on a file only reads it
+// when first shown, and an unmodified one can give its text back to be
+// loaded again later, keeping the cursor and scroll position. Unsaved edits
+// are journaled so that a crash doesn't lose them. Files past the large
+// file threshold are paged through read-only by a LargeFileView instead.
+class DocumentTab : public QWidget
+{
+    Q_OBJECT
+
+public:
+    // A tab on a file stays empty until load() is called
+    explicit DocumentTab(const QString &filePath = QString(), QWidget *parent = nullptr);
+    ~DocumentTab(); // a clean close, the journal goes away
+
+    QPlainTextEdit *editor() const { return textEditor; }
+    TextBuffer *buffer() const { return textBuffer; }
+    DocumentLoader *loader() const { return documentLoader; }
+    DocumentSaver *saver() const { return documentSaver; }
+    DocumentWatcher *watcher() const { return documentWatcher; }
+    UndoHistory *history() const { return undoHistory; }
+
+    QString filePath() const { return path; }
+    void setFilePath(const QString &filePath); // also picks the highlighting
+    QString displayName() const;
+
+    // Differs from the file: edits that undo, or otherwise restore, the
+    // saved text leave the document unmodified
+    bool isModified() const { return modified; }
+    TextFormat format() const { return textFormat; } // encoding and line endings of the file
+
+    // Markdown preview next to the editor, only converting while shown
+    bool isPreviewVisible() const { return markdownPreview != nullptr; }
+    void setPreviewVisible(bool visible);
+
+    // Overview of the document beside the editor, created when first shown
+    Minimap *minimap() const { return documentMinimap; }
+    void setMinimapVisible(bool visible);
+
+    // Lazy loading
+    bool isLoaded() const { return loaded; }
+    bool load(); // false if the file can't be opened, see loader()->errorString()
+
+    // Read-only paging for files of at least the threshold's size
+    bool isLargeFile() const { return largeView != nullptr; }
+    LargeFileView *largeFileView() const { return largeView; }
+    static qint64 largeFileThreshold(); // bytes, from the settings
+
+    // Memory budget: text held, and giving it back
+    qint64 memoryCost() const;
+    bool canUnload() const;
+    void unload();
+
+    // Least recently used tabs are unloaded first
+    quint64 lastActivation() const { return activation; }
+    void setLastActivation(quint64 value) { activation = value; }
+
+    bool save(const QString &filePath); // false when it can't start now, see saveRefusal()
+    QString saveRefusal() const { return refusal; }
+
+    // Replays a journal left by a crash, once the file is loaded
+    void recover(const QString &journalPath);
+
+    // Puts the cursor on a line and column (1-based), once the file is loaded
+    void goToLocation(int line, int column);
+
+signals:
+    void stateChanged(); // file path or modified flag
+
+private slots:
+    void loadFinished(bool success);
+    void saveFinished(bool success);
+    void watchFinished(bool success);
+
+private:
+    // Text coming from the file isn't an edit
+    bool isReadingFile() const { return documentLoader->isRunning() || documentWatcher->isRunning() || unloading; }
+    void replayRecovery();
+    void showLocation();
+    void setSavedText(quint64 hash, qsizetype length);
+    void updateModified();
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    DocumentLoader *documentLoader;
+    DocumentSaver *documentSaver;
+    DocumentWatcher *documentWatcher;
+    UndoHistory *undoHistory;
+    SyntaxHighlighter *syntaxHighlighter;
+    QSplitter *splitter;
+    QHBoxLayout *editorLayout;
+    Minimap *documentMinimap;
+    MarkdownPreview *markdownPreview;
+    LargeFileView *largeView;
+    DocumentJournal *journal;
+
+    QString path;
+    TextFormat textFormat;
+    bool modified;
+    bool loaded;
+    bool unloading;
+    // Text of the file, to compare with once the undo stack leaves the clean state
+    quint64 savedHash;
+    qsizetype savedLength;
+    quint64 previousHash; // restored if a save fails
+    qsizetype previousLength;
+    QString refusal; // why the last save() didn't start
+    quint64 activation;
+    // View to restore once an unloaded tab is loaded again
+    bool restorePending;
+    int restorePosition;
+    int restoreScroll;
+    int locationLine; // 0 when there is no place to go to
+    int locationColumn;
+    QString recoveryPath;
+};
+
+#endif // DOCUMENTTAB_H
@@ -0,0 +1,264 @@
+#include "DocumentWatcher.h"
+#include "DocumentLoader.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QScrollBar>
+#include <QTextCursor>
+#include <QElapsedTimer>
+#include <QTimer>
+
+// Bytes appended per step, how long a single event-loop slice may run, and
+// how many of the last bytes must still be there for the file to have grown
+static const qint64 ChunkSize = 1024 * 1024;
+static const qint64 TimeSliceMs = 15;
+static const qint64 TailSize = 4096;
+
+static qint64 lastModified(const QString &filePath)
+{
+    return QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+}
+
+DocumentWatcher::DocumentWatcher(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent)
+    : QObject(parent), textEditor(textEdit), textBuffer(buffer), history(nullptr), following(false), running(false), inStep(false),
+      knownSize(0), knownModified(0), file(nullptr), pendingCarriageReturn(false), targetSize(0), targetModified(0),
+      keepAtEnd(false), generation(0)
+{
+    pool.setMaxThreadCount(1);
+}
+
+DocumentWatcher::~DocumentWatcher()
+{
+    generation++;
+    pool.waitForDone();
+    delete file;
+}
+
+void DocumentWatcher::setFile(const QString &filePath, const TextFormat &format, qint64 size)
+{
+    cancel();
+
+    path = filePath;
+    textFormat = format;
+    inStep = false;
+    knownTail.clear();
+    if (path.isEmpty())
+        return;
+
+    QFile current(path);
+    if (!current.open(QIODevice::ReadOnly))
+        return;
+
+    knownSize = size < 0 ? current.size() : qMin(size, current.size());
+    knownModified = lastModified(path);
+    if (current.seek(qMax(knownSize - TailSize, qint64(0))))
+        knownTail = current.read(knownSize - current.pos());
+
+    decoder = QStringDecoder(textFormat.encoding);
+    pendingCarriageReturn = knownTail.endsWith('\r');
+    inStep = knownTail.size() == qMin(knownSize, TailSize);
+}
+
+DocumentWatcher::Change DocumentWatcher::check(bool documentModified)
+{
+    if (path.isEmpty() || running)
+        return Unchanged;
+
+    const QFileInfo info(path);
+    if (!info.exists())
+        return Removed;
+
+    const qint64 size = info.size();
+    const qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    if (size == knownSize && modified == knownModified)
+        return Unchanged;
+
+    // Grown with the known bytes still in place: only read what was added
+    if (following && inStep && !documentModified && size > knownSize)
+    {
+        file = new QFile(path);
+        if (file->open(QIODevice::ReadOnly) && tailMatches(*file) && file->seek(knownSize))
+        {
+            running = true;
+            error.clear();
+            targetSize = size;
+            targetModified = modified;
+            // Stay at the end while following, like tail -f
+            const QScrollBar *scrollBar = textEditor->verticalScrollBar();
+            keepAtEnd = scrollBar->value() == scrollBar->maximum();
+            textEditor->setReadOnly(true);
+
+            QTimer::singleShot(0, this, &DocumentWatcher::appendNextChunk);
+            return Following;
+        }
+
+        delete file;
+        file = nullptr;
+    }
+
+    return Changed;
+}
+
+void DocumentWatcher::ignoreChange()
+{
+    // Appending would now mix the file and the document
+    knownSize = QFileInfo(path).size();
+    knownModified = lastModified(path);
+    inStep = false;
+}
+
+void DocumentWatcher::appendNextChunk()
+{
+    if (!running)
+        return;
+
+    QElapsedTimer slice;
+    slice.start();
+
+    QTextCursor cursor(textEditor->document());
+    cursor.movePosition(QTextCursor::End);
+
+    while (knownSize < targetSize && slice.elapsed() < TimeSliceMs)
+    {
+        const QByteArray bytes = file->read(qMin(ChunkSize, targetSize - knownSize));
+        if (bytes.isEmpty())
+        {
+            error = file->errorString();
+            inStep = false; // part of the new bytes may be in
+            finish(false);
+            return;
+        }
+
+        cursor.insertText(DocumentLoader::normalizeLineEndings(decoder.decode(bytes), pendingCarriageReturn));
+        knownSize += bytes.size();
+        rememberTail(bytes);
+    }
+
+    if (keepAtEnd)
+        textEditor->verticalScrollBar()->setValue(textEditor->verticalScrollBar()->maximum());
+
+    if (knownSize < targetSize)
+    {
+        QTimer::singleShot(0, this, &DocumentWatcher::appendNextChunk);
+        return;
+    }
+
+    knownModified = targetModified;
+    finish(true);
+}
+
+void DocumentWatcher::reload()
+{
+    cancel();
+
+    running = true;
+    error.clear();
+    // The diff is made against this text, it mustn't change meanwhile
+    textEditor->setReadOnly(true);
+
+    // The old side of the diff. Its chunks own their text, none of it is
+    // read from the file that is being replaced (see DocumentLoader)
+    const quint64 current = ++generation;
+    const TextSnapshot text = textBuffer->snapshot();
+    const QString filePath = path;
+    const QStringConverter::Encoding encoding = textFormat.encoding;
+
+    pool.start([this, current, text, filePath, encoding]() {
+        Reload result;
+        result.modified = lastModified(filePath);
+
+        // Read, not mapped, so a file still being rewritten can't fault
+        QFile source(filePath);
+        if (source.open(QIODevice::ReadOnly))
+        {
+            const QByteArray bytes = source.readAll();
+            result.size = bytes.size();
+            result.tail = bytes.right(TailSize);
+
+            bool pendingCarriageReturn = false;
+            QStringDecoder toText(encoding);
+            result.text = DocumentLoader::normalizeLineEndings(toText.decode(bytes), pendingCarriageReturn);
+            result.hunks = LineDiff::compute(text.toString(), result.text);
+        }
+        else
+            result.error = source.errorString();
+
+        QMetaObject::invokeMethod(this, [this, current, result]() {
+            if (current == generation)
+                applyReload(result);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void DocumentWatcher::applyReload(const Reload &result)
+{
+    if (!result.error.isEmpty())
+    {
+        error = result.error;
+        finish(false);
+        return;
+    }
+
+    // Only the changed lines are replaced, cursors move along with the text.
+    // Hunk by hunk from the last one, so each is reported on its own and the
+    // positions of the others stay valid; one step of the history undoes them.
+    QScrollBar *scrollBar = textEditor->verticalScrollBar();
+    const int scroll = scrollBar->value();
+
+    QTextCursor cursor(textEditor->document());
+    if (history)
+        history->beginGroup();
+    for (qsizetype i = result.hunks.size(); i-- > 0;)
+    {
+        const LineDiff::Hunk &hunk = result.hunks.at(i);
+        cursor.setPosition(int(hunk.position));
+        cursor.setPosition(int(hunk.position + hunk.removed), QTextCursor::KeepAnchor);
+        cursor.insertText(result.text.mid(hunk.from, hunk.added));
+    }
+    if (history)
+        history->endGroup();
+
+    scrollBar->setValue(scroll);
+
+    knownSize = result.size;
+    knownModified = result.modified;
+    knownTail = result.tail;
+    decoder = QStringDecoder(textFormat.encoding);
+    pendingCarriageReturn = knownTail.endsWith('\r');
+    inStep = true;
+    finish(true);
+}
+
+void DocumentWatcher::cancel()
+{
+    generation++;
+    if (!running)
+        return;
+
+    // An interrupted append leaves part of the new bytes in the document
+    if (file)
+        inStep = false;
+    running = false;
+    delete file;
+    file = nullptr;
+    textEditor->setReadOnly(false);
+}
+
+void DocumentWatcher::finish(bool success)
+{
+    running = false;
+    delete file;
+    file = nullptr;
+    textEditor->setReadOnly(false);
+
+    emit finished(success);
+}
+
+void DocumentWatcher::rememberTail(const QByteArray &bytes)
+{
+    knownTail = bytes.size() >= TailSize ? bytes.right(TailSize) : (knownTail + bytes).right(TailSize);
+}
+
+bool DocumentWatcher::tailMatches(QFile &source) const
+{
+    return source.seek(knownSize - knownTail.size()) && source.read(knownTail.size()) == knownTail;
+}
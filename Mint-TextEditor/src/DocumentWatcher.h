@@ -0,0 +1,109 @@
+#ifndef DOCUMENTWATCHER_H
+#define DOCUMENTWATCHER_H
+
+#include <QObject>
+#include <QFile>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QStringDecoder>
+#include <QPlainTextEdit>
+
+#include "TextBuffer.h"
+#include "LineDiff.h"
+#include "TextFormat.h"
+#include "UndoHistory.h"
+
+// Keeps a document in step with its file once it changes on disk. The size,
+// date and last bytes of the file as the document holds it are remembered:
+// a file that only grew (a log being written) can then be followed by
+// appending just the new bytes, from short event-loop slices, whatever its
+// size. Any other change is reloaded by diffing the new text against the
+// buffer on a worker thread and applying only the changed lines, as one
+// undoable edit that keeps the cursor and scroll position.
+class DocumentWatcher : public QObject
+{
+    Q_OBJECT
+
+public:
+    enum Change
+    {
+        Unchanged,
+        Following, // new bytes are being appended
+        Changed,
+        Removed
+    };
+
+    DocumentWatcher(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent = nullptr);
+    ~DocumentWatcher();
+
+    void setUndoHistory(UndoHistory *undoHistory) { history = undoHistory; } // a reload undoes in one step
+
+    // The document now holds the first 'size' bytes of the file (all of it
+    // when -1), read in 'format'; an empty path stops watching
+    void setFile(const QString &filePath, const TextFormat &format = TextFormat(), qint64 size = -1);
+    QString filePath() const { return path; }
+
+    // Tail mode: appended bytes are added to an unmodified document
+    bool isFollowing() const { return following; }
+    void setFollowing(bool enabled) { following = enabled; }
+
+    Change check(bool documentModified);
+    void ignoreChange(); // the document stays as it is until the next change
+    void reload();
+    void cancel();
+
+    bool isRunning() const { return running; }
+    bool isAppending() const { return running && file; } // following, not reloading
+    QString errorString() const { return error; }
+
+signals:
+    void finished(bool success); // appended or reloaded
+
+private slots:
+    void appendNextChunk();
+
+private:
+    struct Reload
+    {
+        QString text;
+        QList<LineDiff::Hunk> hunks;
+        qint64 size = 0;
+        qint64 modified = 0;
+        QByteArray tail;
+        QString error;
+    };
+
+    void rememberTail(const QByteArray &bytes);
+    bool tailMatches(QFile &file) const;
+    void applyReload(const Reload &result);
+    void finish(bool success);
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    UndoHistory *history;
+    QString path;
+    TextFormat textFormat;
+    QString error;
+    bool following;
+    bool running;
+
+    // The file as the document holds it
+    bool inStep; // false once a change was ignored
+    qint64 knownSize;
+    qint64 knownModified;
+    QByteArray knownTail; // its last bytes, compared before appending
+
+    // Appending
+    QFile *file;
+    QStringDecoder decoder;
+    bool pendingCarriageReturn;
+    qint64 targetSize;
+    qint64 targetModified;
+    bool keepAtEnd;
+
+    // Reloading
+    QThreadPool pool;
+    QAtomicInteger<quint64> generation;
+};
+
+#endif // DOCUMENTWATCHER_H
@@ -0,0 +1,33 @@
+#include "FileLocation.h"
+#include <QFileInfo>
+#include <QRegularExpression>
+
+FileLocation FileLocation::parse(const QString &argument)
+{
+    FileLocation location;
+    location.path = argument;
+
+    // Colons that are part of an existing file's name aren't a position
+    if (!QFileInfo::exists(argument))
+    {
+        static const QRegularExpression position("^(.+?):(\\d+)(?::(\\d+))?$");
+        const QRegularExpressionMatch match = position.match(argument);
+        if (match.hasMatch())
+        {
+            location.path = match.captured(1);
+            location.line = match.captured(2).toInt();
+            location.column = match.captured(3).toInt();
+        }
+    }
+
+    location.path = QFileInfo(location.path).absoluteFilePath();
+    return location;
+}
+
+QString FileLocation::toString() const
+{
+    if (line <= 0)
+        return path;
+    return column > 0 ? QString("%1:%2:%3").arg(path).arg(line).arg(column)
+                      : QString("%1:%2").arg(path).arg(line);
+}
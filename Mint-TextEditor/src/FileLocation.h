@@ -0,0 +1,18 @@
+#ifndef FILELOCATION_H
+#define FILELOCATION_H
+
+#include <QString>
+
+// A file to open from the command line, with an optional place in it:
+// "file", "file:line" or "file:line:column" (1-based, 0 when not given)
+struct FileLocation
+{
+    QString path; // absolute
+    int line = 0;
+    int column = 0;
+
+    static FileLocation parse(const QString &argument); // relative to the working folder
+    QString toString() const; // parses back to the same location
+};
+
+#endif // FILELOCATION_H
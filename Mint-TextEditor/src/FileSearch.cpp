@@ -0,0 +1,508 @@
+#include "FileSearch.h"
+#include "TextFormat.h"
+#include "TextMatcher.h"
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFile>
+#include <QMutex>
+#include <QQueue>
+#include <QRegularExpression>
+#include <QSharedPointer>
+#include <QStringConverter>
+#include <QStringDecoder>
+#include <QThread>
+#include <QWaitCondition>
+#include <cstring>
+#include <functional>
+#include <optional>
+
+// Files are binary when this much of their start holds a NUL, like git does
+static const qsizetype BinaryProbe = 8192;
+// Characters of a line shown, and of them before the match
+static const qsizetype PreviewChars = 200;
+static const qsizetype PreviewContext = 60;
+// Waiting workers look for a cancel this often
+static const unsigned long WaitMs = 50;
+
+namespace
+{
+// One pattern of a .gitignore or .ignore file, on paths relative to its folder
+struct IgnoreRule
+{
+    QString base; // folder of the ignore file, ending with '/'
+    QRegularExpression regex;
+    bool negated;
+    bool directoryOnly;
+};
+
+using IgnoreRules = QSharedPointer<const QList<IgnoreRule>>;
+
+// gitignore wildcards: "*" and "?" stop at '/', "**" doesn't
+QString wildcardToRegex(const QString &pattern)
+{
+    QString regex;
+    for (qsizetype i = 0; i < pattern.size(); ++i)
+    {
+        const QChar c = pattern.at(i);
+        if (c == '*' && pattern.mid(i, 3) == "**/")
+        {
+            regex += "(?:.*/)?";
+            i += 2;
+        }
+        else if (c == '*' && pattern.mid(i, 2) == "**")
+        {
+            regex += ".*";
+            ++i;
+        }
+        else if (c == '*')
+            regex += "[^/]*";
+        else if (c == '?')
+            regex += "[^/]";
+        else if (c == '[' && pattern.indexOf(']', i + 1) > i + 1)
+        {
+            const qsizetype end = pattern.indexOf(']', i + 1);
+            QString set = pattern.mid(i + 1, end - i - 1);
+            if (set.startsWith('!'))
+                set[0] = '^';
+            regex += '[' + set + ']';
+            i = end;
+        }
+        else if (c == '\\' && i + 1 < pattern.size())
+            regex += QRegularExpression::escape(pattern.at(++i));
+        else
+            regex += QRegularExpression::escape(c);
+    }
+    return regex;
+}
+
+IgnoreRules readIgnoreRules(const QString &folder, const IgnoreRules &inherited)
+{
+    QList<IgnoreRule> rules;
+    const QString base = folder.endsWith('/') ? folder : folder + '/';
+
+    for (const char *name : { ".gitignore", ".ignore" })
+    {
+        QFile file(base + name);
+        if (!file.open(QIODevice::ReadOnly))
+            continue;
+
+        const QList<QByteArray> lines = file.readAll().split('\n');
+        for (const QByteArray &line : lines)
+        {
+            QString pattern = QString::fromUtf8(line.trimmed());
+            if (pattern.isEmpty() || pattern.startsWith('#'))
+                continue;
+
+            IgnoreRule rule{ base, QRegularExpression(), false, false };
+            if (pattern.startsWith('!'))
+            {
+                rule.negated = true;
+                pattern.remove(0, 1);
+            }
+            if (pattern.endsWith('/'))
+            {
+                rule.directoryOnly = true;
+                pattern.chop(1);
+            }
+            // A slash anchors the pattern to the ignore file's folder
+            const bool anchored = pattern.contains('/');
+            if (pattern.startsWith('/'))
+                pattern.remove(0, 1);
+            if (pattern.isEmpty())
+                continue;
+
+            rule.regex = QRegularExpression((anchored ? "^" : "^(?:.*/)?") + wildcardToRegex(pattern) + "$");
+            if (rule.regex.isValid())
+                rules.append(rule);
+        }
+    }
+
+    if (rules.isEmpty())
+        return inherited;
+    if (inherited)
+        rules = *inherited + rules;
+    return IgnoreRules(new QList<IgnoreRule>(rules));
+}
+
+// The last rule matching the path decides
+bool isIgnored(const IgnoreRules &rules, const QString &path, bool directory)
+{
+    if (!rules)
+        return false;
+
+    bool ignored = false;
+    for (const IgnoreRule &rule : *rules)
+    {
+        if ((rule.directoryOnly && !directory) || ignored == !rule.negated || !path.startsWith(rule.base))
+            continue;
+        if (rule.regex.match(QStringView(path).mid(rule.base.size())).hasMatch())
+            ignored = !rule.negated;
+    }
+    return ignored;
+}
+
+// Work shared by the walker and the searching threads
+struct SearchQueue
+{
+    QMutex mutex;
+    QWaitCondition ready;
+    QQueue<QString> files;
+    bool walking = true;
+    QAtomicInteger<qint64> searched;
+    QAtomicInteger<qint64> matches;
+    QAtomicInt workers;
+};
+
+struct Searcher
+{
+    TextMatcher matcher;
+    QRegularExpression regex;
+    bool useRegex;
+    bool wholeWords;
+    bool bytes; // the literal can be matched on UTF-8 or Latin-1 bytes
+};
+
+// UTF-16 units of UTF-8 bytes, for columns
+qsizetype utf16Length(const char *data, qsizetype size)
+{
+    qsizetype units = 0;
+    for (qsizetype i = 0; i < size; ++i)
+    {
+        const uchar byte = uchar(data[i]);
+        if ((byte & 0xC0) != 0x80)
+            units += byte >= 0xF0 ? 2 : 1;
+    }
+    return units;
+}
+
+// Lines and columns of increasing positions, counted once
+template <typename Char>
+struct LineTracker
+{
+    const Char *data;
+    qsizetype line = 0;
+    qsizetype lineStart = 0;
+    qsizetype counted = 0;
+    qsizetype columnPosition = 0;
+    qsizetype column = 0;
+
+    void advance(qsizetype position)
+    {
+        for (; counted < position; ++counted)
+        {
+            if (data[counted] == '\n')
+            {
+                ++line;
+                lineStart = counted + 1;
+            }
+        }
+        if (columnPosition < lineStart)
+        {
+            columnPosition = lineStart;
+            column = 0;
+        }
+    }
+
+    qsizetype lineEnd(qsizetype size) const
+    {
+        qsizetype end = counted;
+        while (end < size && data[end] != '\n')
+            ++end;
+        if (end > lineStart && data[end - 1] == '\r')
+            --end;
+        return end;
+    }
+};
+
+FileSearch::Match makeMatch(qsizetype line, QStringView lineText, qsizetype column, qsizetype length)
+{
+    qsizetype start = 0;
+    if (lineText.size() > PreviewChars)
+        start = qBound(qsizetype(0), column - PreviewContext, lineText.size() - PreviewChars);
+    return FileSearch::Match{ int(line + 1), int(column + 1), int(length),
+                              lineText.mid(start, PreviewChars).toString(), int(column - start) };
+}
+
+// ASCII literal on the bytes: no decoding, UTF-8 only matters for columns
+void searchBytes(const char *data, qsizetype size, const Searcher &searcher, SearchQueue &queue,
+                 QList<FileSearch::Match> &matches, const std::function<bool()> &cancelled)
+{
+    LineTracker<char> lines{ data };
+    const qsizetype length = searcher.matcher.length();
+    qsizetype from = 0;
+
+    while (!cancelled())
+    {
+        const qsizetype index = searcher.matcher.indexIn(data, size, from);
+        if (index < 0 || queue.matches.fetchAndAddRelaxed(1) >= FileSearch::MaxMatches)
+            break;
+
+        lines.advance(index);
+        lines.column += utf16Length(data + lines.columnPosition, index - lines.columnPosition);
+        lines.columnPosition = index;
+
+        // Only the part of a long line around the match is decoded
+        const qsizetype lineEnd = lines.lineEnd(size);
+        const qsizetype windowStart = qMax(lines.lineStart, index - 4 * PreviewContext);
+        const qsizetype windowEnd = qMin(lineEnd, index + 4 * PreviewChars);
+        const QString window = QString::fromUtf8(data + windowStart, windowEnd - windowStart);
+        const qsizetype windowColumn = utf16Length(data + windowStart, index - windowStart);
+
+        FileSearch::Match match = makeMatch(lines.line, window, windowColumn, length);
+        match.column = int(lines.column + 1);
+        matches.append(match);
+        from = index + qMax(length, qsizetype(1));
+    }
+}
+
+// Decoded text, for other patterns and encodings
+void searchText(const QString &text, const Searcher &searcher, SearchQueue &queue,
+                QList<FileSearch::Match> &matches, const std::function<bool()> &cancelled)
+{
+    LineTracker<QChar> lines{ text.constData() };
+    const auto report = [&](qsizetype index, qsizetype length) {
+        if (queue.matches.fetchAndAddRelaxed(1) >= FileSearch::MaxMatches)
+            return false;
+        lines.advance(index);
+        const qsizetype lineEnd = lines.lineEnd(text.size());
+        const QStringView line = QStringView(text).mid(lines.lineStart, lineEnd - lines.lineStart);
+        matches.append(makeMatch(lines.line, line, index - lines.lineStart, length));
+        return !cancelled();
+    };
+
+    if (searcher.useRegex)
+    {
+        QRegularExpressionMatchIterator iterator = searcher.regex.globalMatch(text);
+        while (iterator.hasNext())
+        {
+            const QRegularExpressionMatch match = iterator.next();
+            if (!report(match.capturedStart(), match.capturedLength()))
+                break;
+        }
+        return;
+    }
+
+    const qsizetype length = searcher.matcher.length();
+    qsizetype from = 0;
+    while (true)
+    {
+        const qsizetype index = searcher.matcher.indexIn(text.constData(), text.size(), from);
+        if (index < 0)
+            break;
+        from = index + qMax(length, qsizetype(1));
+
+        const QChar before = index > 0 ? text.at(index - 1) : QChar(' ');
+        const QChar after = index + length < text.size() ? text.at(index + length) : QChar(' ');
+        if (searcher.wholeWords && !TextMatcher::isWholeWord(before, after))
+            continue;
+        if (!report(index, length))
+            break;
+    }
+}
+
+QList<FileSearch::Match> searchFile(const QString &filePath, const Searcher &searcher, SearchQueue &queue,
+                                    const std::function<bool()> &cancelled)
+{
+    QList<FileSearch::Match> matches;
+    QFile file(filePath);
+    if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+        return matches;
+
+    // Mapped, or read when the file can't be (special files)
+    QByteArray contents;
+    const char *data = reinterpret_cast<const char *>(file.map(0, file.size()));
+    qsizetype size = file.size();
+    if (!data)
+    {
+        contents = file.readAll();
+        data = contents.constData();
+        size = contents.size();
+    }
+
+    const QByteArrayView bytes(data, size);
+    const std::optional<QStringConverter::Encoding> encoding = QStringConverter::encodingForData(bytes);
+    const bool utf8 = !encoding || *encoding == QStringConverter::Utf8;
+    if (utf8 && std::memchr(data, 0, size_t(qMin(size, BinaryProbe))))
+        return matches;
+
+    if (searcher.bytes && utf8)
+    {
+        // The byte order mark isn't a character of the first line
+        const qsizetype bom = encoding ? 3 : 0;
+        searchBytes(data + bom, size - bom, searcher, queue, matches, cancelled);
+        return matches;
+    }
+
+    QString text;
+    if (encoding)
+        text = QStringDecoder(*encoding).decode(bytes);
+    else
+    {
+        Utf8Validator validator;
+        validator.append(bytes);
+        text = validator.isValid() ? QString::fromUtf8(bytes) : QString::fromLatin1(bytes);
+    }
+    searchText(text, searcher, queue, matches, cancelled);
+    return matches;
+}
+
+bool matchesFilters(const QString &fileName, const QList<QRegularExpression> &filters)
+{
+    if (filters.isEmpty())
+        return true;
+    for (const QRegularExpression &filter : filters)
+    {
+        if (filter.match(fileName).hasMatch())
+            return true;
+    }
+    return false;
+}
+}
+
+FileSearch::FileSearch(QObject *parent)
+    : QObject(parent), generation(0), running(false)
+{
+    // The walker and a searcher per core
+    pool.setMaxThreadCount(QThread::idealThreadCount() + 1);
+}
+
+FileSearch::~FileSearch()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+bool FileSearch::start(const QString &folder, const Options &options)
+{
+    cancel();
+    error.clear();
+
+    QSharedPointer<Searcher> searcher(new Searcher{ TextMatcher(options.pattern, options.cs), QRegularExpression(),
+                                                    options.regex, options.wholeWords, false });
+    if (options.regex)
+    {
+        QRegularExpression::PatternOptions patternOptions = QRegularExpression::MultilineOption;
+        if (options.cs == Qt::CaseInsensitive)
+            patternOptions |= QRegularExpression::CaseInsensitiveOption;
+        const QString pattern = options.wholeWords ? "\\b(?:" + options.pattern + ")\\b" : options.pattern;
+        searcher->regex = QRegularExpression(pattern, patternOptions);
+        if (!searcher->regex.isValid())
+        {
+            error = searcher->regex.errorString();
+            return false;
+        }
+        searcher->regex.optimize();
+    }
+    else
+    {
+        bool ascii = true;
+        for (QChar c : options.pattern)
+            ascii = ascii && c.unicode() < 0x80;
+        searcher->bytes = ascii && !options.wholeWords;
+    }
+
+    QList<QRegularExpression> filters;
+    for (const QString &filter : options.fileFilters)
+        filters.append(QRegularExpression::fromWildcard(filter.trimmed(), Qt::CaseInsensitive));
+
+    const quint64 id = generation.loadRelaxed();
+    const auto cancelled = [this, id]() { return generation.loadRelaxed() != id; };
+    QSharedPointer<SearchQueue> queue(new SearchQueue);
+    const int workers = qMax(1, pool.maxThreadCount() - 1);
+    queue->workers.storeRelaxed(workers);
+    running = true;
+    timer.start();
+
+    // Walker, depth first
+    pool.start([queue, cancelled, filters, root = QDir(folder).absolutePath()]() {
+        struct Folder
+        {
+            QString path;
+            IgnoreRules rules;
+        };
+        QList<Folder> folders{ Folder{ root, IgnoreRules() } };
+
+        while (!folders.isEmpty() && !cancelled() && queue->matches.loadRelaxed() < MaxMatches)
+        {
+            const Folder current = folders.takeLast();
+            const IgnoreRules rules = readIgnoreRules(current.path, current.rules);
+
+            // Hidden files and folders aren't listed
+            QStringList found;
+            QDirIterator iterator(current.path, QDir::Files | QDir::Dirs | QDir::NoDotAndDotDot);
+            while (iterator.hasNext())
+            {
+                iterator.next();
+                const QFileInfo info = iterator.fileInfo();
+                const QString path = info.filePath();
+                if (info.isDir())
+                {
+                    if (!info.isSymLink() && !isIgnored(rules, path, true))
+                        folders.append(Folder{ path, rules });
+                }
+                else if (matchesFilters(info.fileName(), filters) && !isIgnored(rules, path, false))
+                    found.append(path);
+            }
+
+            if (!found.isEmpty())
+            {
+                QMutexLocker locker(&queue->mutex);
+                queue->files.append(found);
+                queue->ready.wakeAll();
+            }
+        }
+
+        QMutexLocker locker(&queue->mutex);
+        queue->walking = false;
+        queue->ready.wakeAll();
+    });
+
+    // Searchers, each taking the next file once done with one
+    for (int i = 0; i < workers; ++i)
+    {
+        pool.start([this, id, queue, searcher, cancelled]() {
+            while (!cancelled() && queue->matches.loadRelaxed() < MaxMatches)
+            {
+                QString filePath;
+                {
+                    QMutexLocker locker(&queue->mutex);
+                    while (queue->files.isEmpty() && queue->walking && !cancelled())
+                        queue->ready.wait(&queue->mutex, WaitMs);
+                    if (queue->files.isEmpty())
+                        break;
+                    filePath = queue->files.dequeue();
+                }
+
+                const QList<Match> matches = searchFile(filePath, *searcher, *queue, cancelled);
+                queue->searched.fetchAndAddRelaxed(1);
+                if (!matches.isEmpty())
+                {
+                    QMetaObject::invokeMethod(this, [this, id, filePath, matches]() {
+                        if (generation.loadRelaxed() == id)
+                            emit fileMatched(filePath, matches);
+                    }, Qt::QueuedConnection);
+                }
+            }
+
+            // The last searcher to stop reports
+            if (queue->workers.fetchAndAddOrdered(-1) == 1)
+            {
+                QMetaObject::invokeMethod(this, [this, id, queue]() {
+                    if (generation.loadRelaxed() != id)
+                        return;
+                    running = false;
+                    emit finished(queue->searched.loadRelaxed(), qMin(queue->matches.loadRelaxed(), MaxMatches), timer.elapsed());
+                }, Qt::QueuedConnection);
+            }
+        });
+    }
+
+    return true;
+}
+
+void FileSearch::cancel()
+{
+    generation.fetchAndAddOrdered(1);
+    running = false;
+}
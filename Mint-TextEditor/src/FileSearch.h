@@ -0,0 +1,66 @@
+#ifndef FILESEARCH_H
+#define FILESEARCH_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QList>
+
+// Searches every text file under a folder, like grep -r. One pool thread
+// walks the tree, skipping hidden files, binary ones and what .gitignore and
+// .ignore files exclude, and queues the files it finds; every other thread
+// takes the next queued file as soon as it is free, so a few large files
+// don't hold the rest back. Files are memory-mapped: ASCII literals are
+// matched on the bytes, anything else on the decoded text. Matches come
+// back file by file while the search goes on, and a new search or cancel()
+// stops the running one at its next check.
+class FileSearch : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Options
+    {
+        QString pattern;
+        Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+        bool wholeWords = false;
+        bool regex = false;
+        QStringList fileFilters; // wildcards on file names, every file when empty
+    };
+
+    struct Match
+    {
+        int line;          // 1-based
+        int column;        // 1-based, in characters
+        int length;        // in characters
+        QString preview;   // the line, cut when very long
+        int previewColumn; // where the match starts in the preview
+    };
+
+    // The search stops once this many matches are found
+    static const qint64 MaxMatches = 50000;
+
+    explicit FileSearch(QObject *parent = nullptr);
+    ~FileSearch();
+
+    bool start(const QString &folder, const Options &options); // false if the pattern is invalid
+    void cancel();
+
+    bool isRunning() const { return running; }
+    QString errorString() const { return error; }
+
+signals:
+    void fileMatched(const QString &filePath, const QList<FileSearch::Match> &matches);
+    void finished(qint64 filesSearched, qint64 matchCount, qint64 elapsedMs);
+
+private:
+    QThreadPool pool;
+    QAtomicInteger<quint64> generation;
+    QElapsedTimer timer;
+    QString error;
+    bool running;
+};
+
+#endif // FILESEARCH_H
@@ -1,4 +1,5 @@
 #include "FindDialog.h"
+#include "Trace.h"
 #include <QVBoxLayout>
 #include <QHBoxLayout>
 #include <QGridLayout>
@@ -6,15 +7,65 @@
 #include <QTextCursor>
 #include <QTextDocument>
 #include <QMessageBox>
+#include <QApplication>
+#include <QScrollBar>
 
-FindDialog::FindDialog(QTextEdit *textEdit, QWidget *parent) : QDialog(parent), textEditor(textEdit)
+// Delay between the last keystroke in the search field and the search
+static const int SearchDelayMs = 150;
+// Highlights drawn at most, for very dense matches
+static const int MaxHighlights = 2000;
+
+FindDialog::FindDialog(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent)
+    : QDialog(parent), textEditor(nullptr), textBuffer(nullptr), resultsStale(true), searchStart(-1),
+      navigationPending(false), pendingForward(true), pendingPosition(0)
 {
     setWindowTitle("Search & Replace");
     setModal(false); // allow to keep editing
+
+    searchEngine = new SearchEngine(this);
+    searchTimer = new QTimer(this);
+    searchTimer->setSingleShot(true);
+    searchTimer->setInterval(SearchDelayMs);
+
     setupUI();
+    setDocument(textEdit, buffer);
     findLineEdit->setFocus();
 }
 
+void FindDialog::setDocument(QPlainTextEdit *textEdit, TextBuffer *buffer)
+{
+    if (textEdit == textEditor)
+        return;
+
+    // Results and highlights belong to the previous document
+    searchTimer->stop();
+    searchEngine->cancel();
+    navigationPending = false;
+    resultsStale = true;
+
+    if (textEditor)
+    {
+        textEditor->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+        emit matchesChanged(textEditor, QList<qsizetype>());
+        disconnect(textEditor, nullptr, this, nullptr);
+        disconnect(textEditor->verticalScrollBar(), nullptr, this, nullptr);
+        disconnect(textBuffer, nullptr, this, nullptr);
+    }
+
+    textEditor = textEdit;
+    textBuffer = buffer;
+
+    connect(textBuffer, &TextBuffer::edited, this, &FindDialog::documentEdited);
+    connect(textBuffer, &TextBuffer::batchEdited, this, &FindDialog::documentEdited);
+
+    // Highlighting follows the viewport, the label the selection
+    connect(textEditor->verticalScrollBar(), &QScrollBar::valueChanged, this, &FindDialog::updateHighlights);
+    connect(textEditor, &QPlainTextEdit::cursorPositionChanged, this, &FindDialog::updateResultLabel);
+
+    if (isVisible() && !findLineEdit->text().isEmpty())
+        scheduleSearch();
+}
+
 void FindDialog::setupUI()
 {
     // Widgets creation
@@ -26,6 +77,8 @@ void FindDialog::setupUI()
     replaceAllButton = new QPushButton("Replace All");
     caseSensitiveCheck = new QCheckBox("Case Sensitive");
     wholeWordsCheck = new QCheckBox("Whole words only");
+    regexCheck = new QCheckBox("Regular expression");
+    resultLabel = new QLabel;
 
     // Grid layout
     QGridLayout *layout = new QGridLayout;
@@ -35,6 +88,7 @@ void FindDialog::setupUI()
     layout->addWidget(replaceLineEdit, 1,1,1,2);
     layout->addWidget(caseSensitiveCheck, 2,0,1,3);
     layout->addWidget(wholeWordsCheck, 3,0,1,3);
+    layout->addWidget(regexCheck, 4,0,1,3);
 
     // Buttons
     QHBoxLayout *buttonLayout = new QHBoxLayout;
@@ -43,7 +97,8 @@ void FindDialog::setupUI()
     buttonLayout->addWidget(replaceButton);
     buttonLayout->addWidget(replaceAllButton);
 
-    layout->addLayout(buttonLayout, 4,0,1,3);
+    layout->addLayout(buttonLayout, 5,0,1,3);
+    layout->addWidget(resultLabel, 6,0,1,3);
     setLayout(layout);
 
     // Connections
@@ -52,89 +107,451 @@ void FindDialog::setupUI()
     connect(replaceButton, &QPushButton::clicked, this, &FindDialog::replace);
     connect(replaceAllButton, &QPushButton::clicked, this, &FindDialog::replaceAll);
 
-    // Real time search
-    connect(findLineEdit, &QLineEdit::textChanged, this, &FindDialog::findNext);
+    // Background search
+    connect(searchTimer, &QTimer::timeout, this, &FindDialog::startSearch);
+    connect(searchEngine, &SearchEngine::matchesFound, this, &FindDialog::matchesFound);
+    connect(searchEngine, &SearchEngine::finished, this, &FindDialog::searchFinished);
+    connect(caseSensitiveCheck, &QCheckBox::toggled, this, &FindDialog::scheduleSearch);
+    connect(wholeWordsCheck, &QCheckBox::toggled, this, &FindDialog::scheduleSearch);
+    connect(regexCheck, &QCheckBox::toggled, this, &FindDialog::scheduleSearch);
+    // Real time search, selects the first match from the current selection
+    connect(findLineEdit, &QLineEdit::textChanged, this, [this]() {
+        navigationPending = true;
+        pendingForward = true;
+        pendingPosition = textEditor->textCursor().selectionStart();
+        scheduleSearch();
+    });
 }
 
-bool FindDialog::findText(const QString &text, bool forward)
+Qt::CaseSensitivity FindDialog::caseSensitivity() const
 {
-    if (text.isEmpty()) return false;
+    return caseSensitiveCheck->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+}
 
-    // Search options
-    QTextDocument::FindFlags flags;
+const QRegularExpression &FindDialog::regularExpression()
+{
+    QRegularExpression::PatternOptions options = QRegularExpression::MultilineOption;
+    if (!caseSensitiveCheck->isChecked())
+        options |= QRegularExpression::CaseInsensitiveOption;
 
-    if (!forward)
-        flags |= QTextDocument::FindBackward;
+    QString pattern = findLineEdit->text();
+    if (wholeWordsCheck->isChecked())
+        pattern = "\\b(?:" + pattern + ")\\b";
 
-    if (caseSensitiveCheck->isChecked())
-        flags |= QTextDocument::FindCaseSensitively;
+    // Only compiled again when the pattern or its options change
+    if (compiledRegex.pattern() != pattern || compiledRegex.patternOptions() != options)
+    {
+        compiledRegex = QRegularExpression(pattern, options);
+        compiledRegex.optimize();
+    }
 
-    if (wholeWordsCheck->isChecked())
-        flags |= QTextDocument::FindWholeWords;
+    return compiledRegex;
+}
 
-    // Search
-    QTextDocument *document = textEditor->document();
-    QTextCursor cursor = document->find(text, textEditor->textCursor(), flags);
+QString FindDialog::expandReplacement(const QString &replacement, const QRegularExpressionMatch &match)
+{
+    const int groups = match.regularExpression().captureCount();
+    QString result;
 
-    if (cursor.isNull())
+    for (qsizetype i = 0; i < replacement.size(); ++i)
     {
-        // Not found - search from start/end
-        QTextCursor startCursor = textEditor->textCursor();
-        startCursor.movePosition(forward ? QTextCursor::Start : QTextCursor::End);
+        const QChar c = replacement.at(i);
+        const QChar next = i + 1 < replacement.size() ? replacement.at(i + 1) : QChar();
+
+        if ((c == '\\' || c == '$') && next.isDigit())
+        {
+            // \N or $N, two digits when there are that many groups
+            int group = next.digitValue();
+            ++i;
+            if (i + 1 < replacement.size() && replacement.at(i + 1).isDigit()
+                && group * 10 + replacement.at(i + 1).digitValue() <= groups)
+            {
+                group = group * 10 + replacement.at(i + 1).digitValue();
+                ++i;
+            }
+            result += match.captured(group);
+        }
+        else if ((c == '\\' || c == '$') && next == c)
+        {
+            result += c;
+            ++i;
+        }
+        else if (c == '\\' && (next == 'n' || next == 't'))
+        {
+            result += next == 'n' ? QChar('\n') : QChar('\t');
+            ++i;
+        }
+        else
+        {
+            result += c;
+        }
+    }
 
-        // New search from start/end
-        cursor = document->find(text, startCursor, flags);
+    return result;
+}
 
-        if (cursor.isNull())
+void FindDialog::scheduleSearch()
+{
+    searchEngine->cancel();
+    resultsStale = true;
+    searchTimer->start();
+}
+
+void FindDialog::startSearch()
+{
+    searchTimer->stop();
+    resultsStale = false;
+
+    const QString pattern = findLineEdit->text();
+    if (pattern.isEmpty())
+    {
+        searchEngine->cancel();
+        navigationPending = false;
+        resultsStale = true;
+        resultLabel->clear();
+        updateHighlights();
+        return;
+    }
+
+    if (regexCheck->isChecked())
+    {
+        const QRegularExpression &regex = regularExpression();
+        if (!regex.isValid())
         {
-            QMessageBox::information(this, "Search", "Text not found.");
-            return false;
+            searchEngine->cancel();
+            navigationPending = false;
+            resultsStale = true;
+            resultLabel->setText("Invalid expression: " + regex.errorString());
+            updateHighlights();
+            return;
+        }
+
+        resultLabel->setText("Searching ...");
+        searchStart = Trace::begin();
+        searchEngine->search(textBuffer->snapshot(), regex);
+        return;
+    }
+
+    resultLabel->setText("Searching ...");
+    searchStart = Trace::begin();
+    searchEngine->search(textBuffer->snapshot(), pattern, caseSensitivity(), wholeWordsCheck->isChecked());
+}
+
+void FindDialog::matchesFound(qsizetype count)
+{
+    Q_UNUSED(count);
+    selectMatch();
+    updateResultLabel();
+    updateHighlights();
+}
+
+void FindDialog::searchFinished(qsizetype count)
+{
+    Q_UNUSED(count);
+    Trace::end(Trace::Search, searchStart);
+    searchStart = -1;
+    selectMatch();
+    updateResultLabel();
+    updateHighlights();
+    emit matchesChanged(textEditor, searchEngine->matches());
+}
+
+void FindDialog::documentEdited(qsizetype position, qsizetype removed, qsizetype added)
+{
+    // The edits of several carets are searched again as one range
+    if (textBuffer->isBatching())
+        return;
+
+    // Nothing to keep up to date, the next use searches again
+    if (!isVisible() || resultsStale || findLineEdit->text().isEmpty())
+    {
+        resultsStale = true;
+        return;
+    }
+
+    // Only the text around the edit is searched again when possible
+    if (!searchEngine->update(textBuffer->snapshot(), position, removed, added))
+        scheduleSearch();
+    else
+        emit matchesChanged(textEditor, searchEngine->matches());
+}
+
+void FindDialog::updateHighlights()
+{
+    QList<QTextEdit::ExtraSelection> selections;
+
+    if (isVisible() && !resultsStale)
+    {
+        // Range of the blocks on screen
+        QTextCursor top = textEditor->cursorForPosition(QPoint(0, 0));
+        QTextCursor bottom = textEditor->cursorForPosition(textEditor->viewport()->rect().bottomRight());
+        top.movePosition(QTextCursor::StartOfBlock);
+        bottom.movePosition(QTextCursor::EndOfBlock);
+
+        QTextCharFormat format;
+        format.setBackground(QColor("#FFDC34"));
+
+        const QList<qsizetype> &matches = searchEngine->matches();
+        for (qsizetype i = searchEngine->nextMatch(top.position(), true);
+             i >= 0 && i < matches.size() && matches.at(i) <= bottom.position() && selections.size() < MaxHighlights; ++i)
+        {
+            QTextEdit::ExtraSelection selection;
+            selection.cursor = QTextCursor(textEditor->document());
+            selection.cursor.setPosition(int(matches.at(i)));
+            selection.cursor.setPosition(int(matches.at(i) + searchEngine->matchLength(i)), QTextCursor::KeepAnchor);
+            selection.format = format;
+            selections.append(selection);
         }
     }
 
-    // Put found cursor within editor
+    textEditor->setExtraSelections(selections);
+}
+
+void FindDialog::updateResultLabel()
+{
+    if (resultsStale || findLineEdit->text().isEmpty())
+        return;
+
+    const QList<qsizetype> &matches = searchEngine->matches();
+
+    if (searchEngine->isSearching())
+    {
+        resultLabel->setText(QString("%1 match(es) so far ...").arg(matches.size()));
+        return;
+    }
+
+    if (matches.isEmpty())
+    {
+        resultLabel->setText("Text not found.");
+        return;
+    }
+
+    // "N of M" when the selection is one of the matches
+    const QTextCursor cursor = textEditor->textCursor();
+    const qsizetype index = searchEngine->nextMatch(cursor.selectionStart(), true);
+
+    if (index >= 0 && matches.at(index) == cursor.selectionStart()
+        && searchEngine->matchLength(index) == cursor.selectionEnd() - cursor.selectionStart())
+        resultLabel->setText(QString("%1 of %2 match(es)").arg(index + 1).arg(matches.size()));
+    else
+        resultLabel->setText(QString("%1 match(es)").arg(matches.size()));
+}
+
+void FindDialog::navigate(bool forward, qsizetype position)
+{
+    if (findLineEdit->text().isEmpty()) return;
+
+    navigationPending = true;
+    pendingForward = forward;
+    pendingPosition = position;
+
+    // Outdated results are refreshed first, the match is selected once found
+    if (resultsStale || searchTimer->isActive())
+        startSearch();
+    else
+        selectMatch();
+}
+
+bool FindDialog::selectMatch()
+{
+    if (!navigationPending)
+        return false;
+
+    const QList<qsizetype> &matches = searchEngine->matches();
+    qsizetype index = searchEngine->nextMatch(pendingPosition, pendingForward);
+
+    // An empty match under the cursor would be found again and again
+    const QTextCursor current = textEditor->textCursor();
+    if (pendingForward && index >= 0 && !current.hasSelection() && matches.at(index) == current.position()
+        && searchEngine->matchLength(index) == 0)
+    {
+        index = index + 1 < matches.size() ? index + 1 : -1;
+    }
+
+    // Matches arrive in order: a later batch may still hold the one we want
+    if (searchEngine->isSearching())
+    {
+        if (index < 0 && pendingForward)
+            return false;
+        if (!pendingForward && (matches.isEmpty() || matches.last() < pendingPosition))
+            return false;
+    }
+
+    navigationPending = false;
+
+    if (index < 0)
+    {
+        // Wrap around
+        if (matches.isEmpty())
+            return false;
+        index = pendingForward ? 0 : matches.size() - 1;
+    }
+
+    const qsizetype start = matches.at(index);
+    QTextCursor cursor = textEditor->textCursor();
+    cursor.setPosition(int(start));
+    cursor.setPosition(int(start + searchEngine->matchLength(index)), QTextCursor::KeepAnchor);
     textEditor->setTextCursor(cursor);
+
     return true;
 }
 
+void FindDialog::setPattern(const QString &text, const QString &replacement)
+{
+    findLineEdit->setText(text);
+    replaceLineEdit->setText(replacement);
+}
+
 void FindDialog::findNext()
 {
-    findText(findLineEdit->text(), true);
+    navigate(true, textEditor->textCursor().selectionEnd());
 }
 
 void FindDialog::findPrevious()
 {
-    findText(findLineEdit->text(), false);
+    navigate(false, textEditor->textCursor().selectionStart());
 }
 
 void FindDialog::replace()
 {
     QTextCursor cursor = textEditor->textCursor();
 
-    if (cursor.hasSelection() && cursor.selectedText() == findLineEdit->text())
+    if (regexCheck->isChecked())
+    {
+        // The selection must be exactly a match, in the context of the text around it
+        const QRegularExpression &regex = regularExpression();
+        const qsizetype start = cursor.selectionStart();
+        const qsizetype end = cursor.selectionEnd();
+        QString replacement;
+        bool matched = false;
+
+        SearchEngine::findAll(textBuffer->snapshot(), regex, start, end,
+                              [&](const QRegularExpressionMatch &match, qsizetype base) {
+            matched = base + match.capturedStart() == start && base + match.capturedEnd() == end;
+            if (matched)
+                replacement = expandReplacement(replaceLineEdit->text(), match);
+            return false;
+        });
+
+        if (matched)
+            cursor.insertText(replacement);
+    }
+    else if (cursor.hasSelection() && QString::compare(cursor.selectedText(), findLineEdit->text(), caseSensitivity()) == 0)
+    {
         cursor.insertText(replaceLineEdit->text());
+    }
 
     findNext(); // Search for next occurence
 }
 
 void FindDialog::replaceAll()
+{
+    QApplication::setOverrideCursor(Qt::WaitCursor);
+    const int count = replaceAllMatches();
+    QApplication::restoreOverrideCursor();
+
+    if (count >= 0)
+        QMessageBox::information(this, "Search all", QString("Did %1 replacement(s).").arg(count));
+}
+
+int FindDialog::replaceAllMatches()
 {
     QString searchText = findLineEdit->text();
     QString replaceText = replaceLineEdit->text();
 
-    if (searchText.isEmpty()) return;
+    if (searchText.isEmpty() || !textBuffer->isTracking()) return -1;
 
-    QTextCursor cursor = textEditor->textCursor();
-    cursor.movePosition(QTextCursor::Start);
-    textEditor->setTextCursor(cursor);
+    const qint64 traceStart = Trace::begin();
+
+    // Collect every match of the current text in one scan
+    struct Replacement
+    {
+        qsizetype position;
+        qsizetype length;
+        QString text;
+    };
+
+    const TextSnapshot snapshot = textBuffer->snapshot();
+    QList<Replacement> replacements;
+
+    if (regexCheck->isChecked())
+    {
+        const QRegularExpression &regex = regularExpression();
+        if (!regex.isValid())
+        {
+            resultLabel->setText("Invalid expression: " + regex.errorString());
+            return -1;
+        }
 
-    int replacements = 0;
-    while (findText(searchText, true))
+        SearchEngine::findAll(snapshot, regex, 0, snapshot.length(),
+                              [&](const QRegularExpressionMatch &match, qsizetype base) {
+            replacements.append({ base + match.capturedStart(), match.capturedLength(), expandReplacement(replaceText, match) });
+            return true;
+        });
+    }
+    else
     {
-        QTextCursor current = textEditor->textCursor();
-        current.insertText(replaceText);
-        replacements++;
+        const TextMatcher matcher(searchText, caseSensitivity());
+
+        SearchEngine::findAll(snapshot, matcher, wholeWordsCheck->isChecked(), 0, snapshot.length(),
+                              [&](qsizetype position) {
+            replacements.append({ position, matcher.length(), replaceText });
+            return true;
+        });
+    }
+
+    int count = 0;
+
+    if (!replacements.isEmpty())
+    {
+        // Build the replaced range in a single pass, skipping overlapping matches
+        const qsizetype first = replacements.first().position;
+        const qsizetype end = replacements.last().position + replacements.last().length;
+        QString result;
+        qsizetype copied = first;
+
+        for (const Replacement &replacement : replacements)
+        {
+            if (replacement.position < copied)
+                continue;
+            result += snapshot.text(copied, replacement.position - copied);
+            result += replacement.text;
+            copied = replacement.position + replacement.length;
+            count++;
+        }
+        result += snapshot.text(copied, qMax(end, copied) - copied);
+
+        // One change for the document, its layout and the undo stack
+        QTextCursor cursor(textEditor->document());
+        cursor.setPosition(int(first));
+        cursor.setPosition(int(qMax(end, copied)), QTextCursor::KeepAnchor);
+        cursor.beginEditBlock();
+        cursor.insertText(result);
+        cursor.endEditBlock();
     }
 
-    QMessageBox::information(this, "Search all", QString("Did %1 replacement(s).").arg(replacements));
+    Trace::end(Trace::Replace, traceStart);
+    return count;
+}
+
+void FindDialog::showEvent(QShowEvent *event)
+{
+    QDialog::showEvent(event);
+
+    // Highlight the matches of the previous query again
+    if (!findLineEdit->text().isEmpty())
+        scheduleSearch();
+}
+
+void FindDialog::hideEvent(QHideEvent *event)
+{
+    // Nothing to keep searching for once the dialog is gone
+    searchTimer->stop();
+    searchEngine->cancel();
+    navigationPending = false;
+    resultsStale = true;
+    textEditor->setExtraSelections(QList<QTextEdit::ExtraSelection>());
+    emit matchesChanged(textEditor, QList<qsizetype>());
+
+    QDialog::hideEvent(event);
 }
@@ -5,26 +5,61 @@
 #include <QLineEdit>
 #include <QPushButton>
 #include <QCheckBox>
-#include <QTextEdit>
+#include <QLabel>
+#include <QTimer>
+#include <QPlainTextEdit>
+#include <QRegularExpression>
+
+#include "TextBuffer.h"
+#include "SearchEngine.h"
 
 class FindDialog : public QDialog
 {
     Q_OBJECT
 
 public:
-    explicit FindDialog(QTextEdit *textEdit, QWidget *parent = nullptr);
+    FindDialog(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent = nullptr);
 
-private slots:
+    // Searches another editor from now on (tab switch)
+    void setDocument(QPlainTextEdit *textEdit, TextBuffer *buffer);
+
+    // What the fields would hold if typed in, for callers other than the user
+    void setPattern(const QString &text, const QString &replacement = QString());
+    int replaceAllMatches(); // replacements made, -1 if there was nothing to search
+
+public slots:
     void findNext();
     void findPrevious();
+
+signals:
+    // Every match in an editor's text, once a search finished or followed an
+    // edit; none once the dialog is closed or moves to another editor
+    void matchesChanged(QPlainTextEdit *textEdit, const QList<qsizetype> &positions);
+
+private slots:
     void replace();
     void replaceAll();
+    // Background search
+    void startSearch();
+    void scheduleSearch();
+    void matchesFound(qsizetype count);
+    void searchFinished(qsizetype count);
+    void documentEdited(qsizetype position, qsizetype removed, qsizetype added);
+    // Matches on screen and "N of M"
+    void updateHighlights();
+    void updateResultLabel();
 
 private:
     void setupUI();
-    bool findText(const QString &text, bool forward = true);
+    void navigate(bool forward, qsizetype position);
+    bool selectMatch();
+
+    Qt::CaseSensitivity caseSensitivity() const;
+    const QRegularExpression &regularExpression();
+    static QString expandReplacement(const QString &replacement, const QRegularExpressionMatch &match);
 
-    QTextEdit *textEditor;
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
     QLineEdit *findLineEdit;
     QLineEdit *replaceLineEdit;
     QPushButton *findNextButton;
@@ -33,6 +68,23 @@ private:
     QPushButton *replaceAllButton;
     QCheckBox *caseSensitiveCheck;
     QCheckBox *wholeWordsCheck;
+    QCheckBox *regexCheck;
+    QLabel *resultLabel;
+
+    // Results refer to the text as it was when the search started
+    SearchEngine *searchEngine;
+    QRegularExpression compiledRegex;
+    QTimer *searchTimer;
+    bool resultsStale;
+    qint64 searchStart; // trace of the running search
+    // Selection waiting for results: direction and start position
+    bool navigationPending;
+    bool pendingForward;
+    qsizetype pendingPosition;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
 };
 
 #endif // FINDDIALOG_H
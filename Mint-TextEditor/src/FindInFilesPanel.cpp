@@ -0,0 +1,184 @@
+#include "FindInFilesPanel.h"
+#include <QDir>
+#include <QFileDialog>
+#include <QGridLayout>
+#include <QHBoxLayout>
+#include <QRegularExpression>
+#include <QVBoxLayout>
+
+// Item data: the file path on file rows, line and column on match rows
+static const int PathRole = Qt::UserRole;
+static const int LineRole = Qt::UserRole + 1;
+static const int ColumnRole = Qt::UserRole + 2;
+
+FindInFilesPanel::FindInFilesPanel(QWidget *parent)
+    : QDockWidget("Find in files", parent), matchesShown(0)
+{
+    setObjectName("findInFilesPanel");
+
+    fileSearch = new FileSearch(this);
+    connect(fileSearch, &FileSearch::fileMatched, this, &FindInFilesPanel::fileMatched);
+    connect(fileSearch, &FileSearch::finished, this, &FindInFilesPanel::searchFinished);
+
+    patternEdit = new QLineEdit;
+    folderEdit = new QLineEdit;
+    filterEdit = new QLineEdit;
+    filterEdit->setPlaceholderText("*.cpp *.h (every file when empty)");
+    browseButton = new QPushButton("...");
+    searchButton = new QPushButton("Search");
+    caseSensitiveCheck = new QCheckBox("Case sensitive");
+    wholeWordsCheck = new QCheckBox("Whole words");
+    regexCheck = new QCheckBox("Regular expression");
+    resultLabel = new QLabel;
+
+    resultTree = new QTreeWidget;
+    resultTree->setHeaderHidden(true);
+    resultTree->setUniformRowHeights(true); // many rows stay cheap to lay out
+
+    QGridLayout *fieldLayout = new QGridLayout;
+    fieldLayout->addWidget(new QLabel("Find:"), 0, 0);
+    fieldLayout->addWidget(patternEdit, 0, 1);
+    fieldLayout->addWidget(searchButton, 0, 2);
+    fieldLayout->addWidget(new QLabel("In folder:"), 1, 0);
+    fieldLayout->addWidget(folderEdit, 1, 1);
+    fieldLayout->addWidget(browseButton, 1, 2);
+    fieldLayout->addWidget(new QLabel("Files:"), 2, 0);
+    fieldLayout->addWidget(filterEdit, 2, 1);
+
+    QHBoxLayout *optionLayout = new QHBoxLayout;
+    optionLayout->addWidget(caseSensitiveCheck);
+    optionLayout->addWidget(wholeWordsCheck);
+    optionLayout->addWidget(regexCheck);
+    optionLayout->addStretch();
+    optionLayout->addWidget(resultLabel);
+
+    QWidget *content = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(content);
+    layout->addLayout(fieldLayout);
+    layout->addLayout(optionLayout);
+    layout->addWidget(resultTree);
+    setWidget(content);
+
+    connect(searchButton, &QPushButton::clicked, this, &FindInFilesPanel::startOrStop);
+    connect(patternEdit, &QLineEdit::returnPressed, this, &FindInFilesPanel::startOrStop);
+    connect(browseButton, &QPushButton::clicked, this, &FindInFilesPanel::chooseFolder);
+    connect(resultTree, &QTreeWidget::itemActivated, this, &FindInFilesPanel::itemActivated);
+    connect(resultTree, &QTreeWidget::itemClicked, this, &FindInFilesPanel::itemActivated);
+}
+
+void FindInFilesPanel::setFolder(const QString &folder)
+{
+    folderEdit->setText(QDir::toNativeSeparators(folder));
+}
+
+void FindInFilesPanel::setPattern(const QString &pattern)
+{
+    patternEdit->setText(pattern);
+}
+
+void FindInFilesPanel::showEvent(QShowEvent *event)
+{
+    QDockWidget::showEvent(event);
+    patternEdit->selectAll();
+    patternEdit->setFocus();
+}
+
+void FindInFilesPanel::startOrStop()
+{
+    if (fileSearch->isRunning())
+    {
+        fileSearch->cancel();
+        setSearching(false);
+        resultLabel->setText(QString("Stopped, %1 match(es)").arg(matchesShown));
+        return;
+    }
+
+    const QString pattern = patternEdit->text();
+    searchFolder = QDir::fromNativeSeparators(folderEdit->text().trimmed());
+    if (pattern.isEmpty() || searchFolder.isEmpty())
+        return;
+    if (!QDir(searchFolder).exists())
+    {
+        resultLabel->setText("No such folder");
+        return;
+    }
+
+    FileSearch::Options options;
+    options.pattern = pattern;
+    options.cs = caseSensitiveCheck->isChecked() ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    options.wholeWords = wholeWordsCheck->isChecked();
+    options.regex = regexCheck->isChecked();
+    options.fileFilters = filterEdit->text().split(QRegularExpression("[\\s;,]+"), Qt::SkipEmptyParts);
+
+    resultTree->clear();
+    matchesShown = 0;
+    if (!fileSearch->start(searchFolder, options))
+    {
+        resultLabel->setText("Invalid expression: " + fileSearch->errorString());
+        return;
+    }
+    setSearching(true);
+    resultLabel->setText("Searching ...");
+}
+
+void FindInFilesPanel::chooseFolder()
+{
+    const QString folder = QFileDialog::getExistingDirectory(this, "Search in folder", folderEdit->text());
+    if (!folder.isEmpty())
+        setFolder(folder);
+}
+
+void FindInFilesPanel::fileMatched(const QString &filePath, const QList<FileSearch::Match> &matches)
+{
+    QTreeWidgetItem *fileItem = new QTreeWidgetItem;
+    fileItem->setText(0, QString("%1 (%2)").arg(QDir::toNativeSeparators(QDir(searchFolder).relativeFilePath(filePath))).arg(matches.size()));
+    fileItem->setData(0, PathRole, filePath);
+    QFont bold = fileItem->font(0);
+    bold.setBold(true);
+    fileItem->setFont(0, bold);
+
+    QList<QTreeWidgetItem *> matchItems;
+    matchItems.reserve(matches.size());
+    for (const FileSearch::Match &match : matches)
+    {
+        QTreeWidgetItem *item = new QTreeWidgetItem;
+        item->setText(0, QString("%1: %2").arg(match.line).arg(match.preview.trimmed()));
+        item->setData(0, PathRole, filePath);
+        item->setData(0, LineRole, match.line);
+        item->setData(0, ColumnRole, match.column);
+        matchItems.append(item);
+    }
+    fileItem->addChildren(matchItems);
+
+    resultTree->addTopLevelItem(fileItem);
+    fileItem->setExpanded(true);
+    matchesShown += matches.size();
+    resultLabel->setText(QString("Searching ... %1 match(es)").arg(matchesShown));
+}
+
+void FindInFilesPanel::searchFinished(qint64 filesSearched, qint64 matchCount, qint64 elapsedMs)
+{
+    setSearching(false);
+    QString text = QString("%1 match(es) in %2 file(s), %3 searched in %4 ms")
+                       .arg(matchCount).arg(resultTree->topLevelItemCount()).arg(filesSearched).arg(elapsedMs);
+    if (matchCount >= FileSearch::MaxMatches)
+        text += " (stopped at the limit)";
+    resultLabel->setText(text);
+}
+
+void FindInFilesPanel::itemActivated(QTreeWidgetItem *item)
+{
+    if (!item)
+        return;
+
+    FileLocation location;
+    location.path = item->data(0, PathRole).toString();
+    location.line = item->data(0, LineRole).toInt();
+    location.column = item->data(0, ColumnRole).toInt();
+    emit openRequested(location);
+}
+
+void FindInFilesPanel::setSearching(bool searching)
+{
+    searchButton->setText(searching ? "Stop" : "Search");
+}
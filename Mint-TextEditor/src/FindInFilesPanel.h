@@ -0,0 +1,58 @@
+#ifndef FINDINFILESPANEL_H
+#define FINDINFILESPANEL_H
+
+#include <QDockWidget>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QLabel>
+#include <QTreeWidget>
+
+#include "FileSearch.h"
+#include "FileLocation.h"
+
+// Find in Files: searches a folder tree and lists the matches grouped by
+// file as they arrive. Activating a match asks for its file to be opened
+// there.
+class FindInFilesPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit FindInFilesPanel(QWidget *parent = nullptr);
+
+    void setFolder(const QString &folder);
+    void setPattern(const QString &pattern);
+
+signals:
+    void openRequested(const FileLocation &location);
+
+private slots:
+    void startOrStop();
+    void chooseFolder();
+    void fileMatched(const QString &filePath, const QList<FileSearch::Match> &matches);
+    void searchFinished(qint64 filesSearched, qint64 matchCount, qint64 elapsedMs);
+    void itemActivated(QTreeWidgetItem *item);
+
+private:
+    void setSearching(bool searching);
+
+    FileSearch *fileSearch;
+    QLineEdit *patternEdit;
+    QLineEdit *folderEdit;
+    QLineEdit *filterEdit;
+    QPushButton *browseButton;
+    QPushButton *searchButton;
+    QCheckBox *caseSensitiveCheck;
+    QCheckBox *wholeWordsCheck;
+    QCheckBox *regexCheck;
+    QLabel *resultLabel;
+    QTreeWidget *resultTree;
+    QString searchFolder;
+    qint64 matchesShown;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+};
+
+#endif // FINDINFILESPANEL_H
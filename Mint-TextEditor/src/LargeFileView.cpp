@@ -0,0 +1,551 @@
+#include "LargeFileView.h"
+#include "LineIndex.h"
+#include "TextMatcher.h"
+#include <QElapsedTimer>
+#include <QHBoxLayout>
+#include <QSharedPointer>
+#include <QTextBlock>
+#include <QVBoxLayout>
+#include <algorithm>
+
+// Bytes decoded into the editor at once
+static const qint64 WindowSize = 4 * 1024 * 1024;
+// How far a window edge looks back for the start of a line
+static const qint64 BoundarySearch = 64 * 1024;
+// Lines are counted per block, one checkpoint each
+static const qint64 IndexBlock = 1024 * 1024;
+static const qint64 IndexReportMs = 100;
+// Bytes scanned between checks for a newer search
+static const qint64 FindChunk = 16 * 1024 * 1024;
+// Resolution of the scroll bar over the whole file
+static const int ScrollSteps = 1000000;
+// Characters between two byte offsets kept for a UTF-8 window
+static const qsizetype OffsetStep = 4096;
+
+// UTF-8 bytes of a UTF-16 unit, a surrogate pair counting once
+static int utf8Length(QChar c)
+{
+    const ushort unit = c.unicode();
+    if (unit < 0x80)
+        return 1;
+    if (unit < 0x800)
+        return 2;
+    if (c.isHighSurrogate())
+        return 4;
+    return c.isLowSurrogate() ? 0 : 3;
+}
+
+LargeFileView::LargeFileView(QWidget *parent)
+    : QWidget(parent), file(nullptr), fileSize(0), contentStart(0), windowStart(0), windowEnd(0),
+      windowLatin1(false), paging(false), indexedLines(0), indexComplete(false), pendingLine(0), pendingColumn(1),
+      generation(0), findGeneration(0)
+{
+    textView = new QPlainTextEdit(this);
+    textView->setReadOnly(true);
+    textView->setTextInteractionFlags(Qt::TextSelectableByMouse | Qt::TextSelectableByKeyboard);
+    textView->setLineWrapMode(QPlainTextEdit::NoWrap); // a scroll step is a line
+    textView->setVerticalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
+    textView->setFont(QFont("Consolas", 11));
+    setFocusProxy(textView);
+
+    scrollBar = new QScrollBar(Qt::Vertical, this);
+    scrollBar->setRange(0, ScrollSteps);
+    scrollBar->setPageStep(ScrollSteps / 100);
+
+    lineEdit = new QLineEdit;
+    lineEdit->setPlaceholderText("Line");
+    offsetEdit = new QLineEdit;
+    offsetEdit->setPlaceholderText("Byte offset");
+    findEdit = new QLineEdit;
+    findEdit->setPlaceholderText("Find");
+    caseSensitiveCheck = new QCheckBox("Case sensitive");
+    QPushButton *findButton = new QPushButton("Find next");
+    statusLabel = new QLabel;
+
+    QHBoxLayout *barLayout = new QHBoxLayout;
+    barLayout->addWidget(new QLabel("Read-only, large file"));
+    barLayout->addWidget(lineEdit);
+    barLayout->addWidget(offsetEdit);
+    barLayout->addWidget(findEdit);
+    barLayout->addWidget(caseSensitiveCheck);
+    barLayout->addWidget(findButton);
+    barLayout->addStretch();
+    barLayout->addWidget(statusLabel);
+
+    QHBoxLayout *viewLayout = new QHBoxLayout;
+    viewLayout->setSpacing(0);
+    viewLayout->addWidget(textView);
+    viewLayout->addWidget(scrollBar);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+    layout->addLayout(barLayout);
+    layout->addLayout(viewLayout);
+
+    connect(textView->verticalScrollBar(), &QScrollBar::valueChanged, this, &LargeFileView::viewScrolled);
+    connect(textView, &QPlainTextEdit::cursorPositionChanged, this, &LargeFileView::updateStatus);
+    connect(scrollBar, &QScrollBar::valueChanged, this, &LargeFileView::scrollBarMoved);
+    connect(lineEdit, &QLineEdit::returnPressed, this, &LargeFileView::goToEnteredLine);
+    connect(offsetEdit, &QLineEdit::returnPressed, this, &LargeFileView::goToEnteredOffset);
+    connect(findEdit, &QLineEdit::returnPressed, this, &LargeFileView::findNext);
+    connect(findButton, &QPushButton::clicked, this, &LargeFileView::findNext);
+
+    indexPool.setMaxThreadCount(1);
+    findPool.setMaxThreadCount(1);
+}
+
+LargeFileView::~LargeFileView()
+{
+    // The workers post their results to this view
+    generation.fetchAndAddOrdered(1);
+    findGeneration.fetchAndAddOrdered(1);
+    indexPool.waitForDone();
+    findPool.waitForDone();
+}
+
+bool LargeFileView::open(const QString &filePath)
+{
+    file = new QFile(filePath, this);
+    if (!file->open(QIODevice::ReadOnly))
+    {
+        error = file->errorString();
+        return false;
+    }
+
+    fileSize = file->size();
+
+    // UTF-8 unless the start doesn't validate; the style of the first line ending
+    const QByteArray head = read(0, WindowSize);
+    contentStart = head.startsWith("\xEF\xBB\xBF") ? 3 : 0;
+    textFormat.bom = contentStart > 0;
+    Utf8Validator validator;
+    textFormat.encoding = validator.append(head) ? QStringConverter::Utf8 : QStringConverter::Latin1;
+    const qsizetype newline = head.indexOf('\n');
+    if (newline >= 0)
+        textFormat.lineEnding = newline > 0 && head.at(newline - 1) == '\r' ? TextFormat::CRLF : TextFormat::LF;
+
+    startIndexing();
+    loadWindow(contentStart);
+    updateStatus();
+    return true;
+}
+
+QByteArray LargeFileView::read(qint64 offset, qint64 length) const
+{
+    length = qMin(length, fileSize - offset);
+    if (length <= 0 || !file->seek(offset))
+        return QByteArray();
+    return file->read(length);
+}
+
+/* Window */
+
+void LargeFileView::loadWindow(qint64 offset)
+{
+    offset = qBound(contentStart, offset, fileSize);
+
+    // Whole lines around the offset, unless a line is longer than the search
+    const qint64 start = lineStartBefore(qMax(contentStart, qMin(offset - WindowSize / 2, fileSize - WindowSize)));
+    qint64 end = qMin(fileSize, start + WindowSize);
+    if (end < fileSize)
+    {
+        const qint64 lineStart = lineStartBefore(end);
+        end = lineStart > start ? lineStart : characterStart(end);
+    }
+
+    windowStart = start;
+    const QByteArray bytes = read(start, end - start);
+    windowEnd = start + bytes.size();
+
+    // A window that isn't valid UTF-8 is shown as Latin-1, one character a byte
+    Utf8Validator validator;
+    windowLatin1 = textFormat.encoding == QStringConverter::Latin1 || !validator.append(bytes);
+    windowText = windowLatin1 ? QString::fromLatin1(bytes) : QString::fromUtf8(bytes);
+    windowText.replace(QChar('\r'), QChar(' ')); // same length, so offsets still map
+
+    windowOffsets.clear();
+    if (!windowLatin1)
+    {
+        qint64 byte = start;
+        for (qsizetype i = 0; i < windowText.size(); ++i)
+        {
+            if (i % OffsetStep == 0)
+                windowOffsets.append(byte);
+            byte += utf8Length(windowText.at(i));
+        }
+    }
+
+    paging = true;
+    textView->setPlainText(windowText);
+    paging = false;
+}
+
+void LargeFileView::showOffset(qint64 offset, bool atTop)
+{
+    offset = qBound(contentStart, offset, fileSize);
+    if (offset < windowStart || offset > windowEnd || (offset == windowEnd && windowEnd < fileSize))
+        loadWindow(offset);
+
+    if (atTop)
+    {
+        const QTextBlock block = textView->document()->findBlock(int(positionAt(offset)));
+        paging = true;
+        textView->verticalScrollBar()->setValue(block.blockNumber());
+        paging = false;
+    }
+
+    QSignalBlocker blocker(scrollBar);
+    scrollBar->setValue(fileSize > 0 ? int(double(offset) / fileSize * ScrollSteps) : 0);
+}
+
+qint64 LargeFileView::lineStartBefore(qint64 offset) const
+{
+    const qint64 limit = qMax(contentStart, offset - BoundarySearch);
+    const qsizetype newline = read(limit, offset - limit).lastIndexOf('\n');
+    if (newline >= 0)
+        return limit + newline + 1;
+    return limit == contentStart ? contentStart : characterStart(offset);
+}
+
+qint64 LargeFileView::characterStart(qint64 offset) const
+{
+    if (offset >= fileSize || textFormat.encoding == QStringConverter::Latin1)
+        return qMin(offset, fileSize);
+
+    // A UTF-8 sequence starts at most 3 bytes back
+    const qint64 first = qMax(contentStart, offset - 3);
+    const QByteArray bytes = read(first, offset + 1 - first);
+    while (offset > first && offset - first < bytes.size() && (uchar(bytes.at(offset - first)) & 0xC0) == 0x80)
+        --offset;
+    return offset;
+}
+
+qint64 LargeFileView::offsetAt(qsizetype position) const
+{
+    position = qBound(qsizetype(0), position, windowText.size());
+    if (windowLatin1)
+        return windowStart + position;
+
+    qsizetype i = position / OffsetStep * OffsetStep;
+    qint64 offset = windowOffsets.isEmpty() ? windowStart : windowOffsets.at(position / OffsetStep);
+    for (; i < position; ++i)
+        offset += utf8Length(windowText.at(i));
+    return offset;
+}
+
+qsizetype LargeFileView::positionAt(qint64 offset) const
+{
+    if (windowLatin1)
+        return qsizetype(qBound(qint64(0), offset - windowStart, qint64(windowText.size())));
+    if (windowOffsets.isEmpty())
+        return 0;
+
+    const qsizetype step = qMax(qsizetype(0), qsizetype(std::upper_bound(windowOffsets.begin(), windowOffsets.end(), offset) - windowOffsets.begin()) - 1);
+    qsizetype position = step * OffsetStep;
+    qint64 byte = windowOffsets.at(step);
+    while (position < windowText.size() && byte < offset)
+        byte += utf8Length(windowText.at(position++));
+    return position;
+}
+
+void LargeFileView::viewScrolled()
+{
+    if (paging)
+        return;
+
+    // Close to an end of the window, the next one is paged in around what is shown
+    const qint64 top = offsetAt(textView->cursorForPosition(QPoint(0, 0)).position());
+    const QScrollBar *inner = textView->verticalScrollBar();
+    const int margin = inner->maximum() / 10;
+    const bool nearStart = inner->value() <= margin && windowStart > contentStart;
+    const bool nearEnd = inner->value() >= inner->maximum() - margin && windowEnd < fileSize;
+
+    if (nearStart || nearEnd)
+    {
+        const QTextCursor cursor = textView->textCursor();
+        const qint64 anchor = offsetAt(cursor.anchor());
+        const qint64 position = offsetAt(cursor.position());
+        loadWindow(top);
+        showOffset(top, true);
+
+        // The selection stays, if it is in the new window
+        if (anchor >= windowStart && position <= windowEnd && position >= windowStart && anchor <= windowEnd)
+        {
+            QTextCursor restored(textView->document());
+            restored.setPosition(int(positionAt(anchor)));
+            restored.setPosition(int(positionAt(position)), QTextCursor::KeepAnchor);
+            paging = true;
+            textView->setTextCursor(restored);
+            showOffset(top, true);
+            paging = false;
+        }
+        return;
+    }
+
+    QSignalBlocker blocker(scrollBar);
+    scrollBar->setValue(fileSize > 0 ? int(double(top) / fileSize * ScrollSteps) : 0);
+}
+
+void LargeFileView::scrollBarMoved(int value)
+{
+    const qint64 offset = characterStart(qint64(double(value) / ScrollSteps * fileSize));
+    showOffset(lineStartBefore(offset), true);
+}
+
+void LargeFileView::goToOffset(qint64 offset)
+{
+    offset = characterStart(qBound(contentStart, offset, fileSize));
+    showOffset(offset, false);
+
+    QTextCursor cursor(textView->document());
+    cursor.setPosition(int(positionAt(offset)));
+    textView->setTextCursor(cursor);
+    textView->centerCursor();
+    textView->setFocus();
+}
+
+void LargeFileView::goToLine(qint64 line, int column)
+{
+    if (indexComplete)
+        line = qBound(qint64(1), line, indexedLines + 1);
+
+    const qint64 offset = lineOffset(line - 1);
+    if (offset < 0)
+    {
+        // Gone to once the lines before it are counted
+        pendingLine = line;
+        pendingColumn = column;
+        updateStatus();
+        return;
+    }
+    pendingLine = 0;
+
+    showOffset(offset, false);
+    const QTextBlock block = textView->document()->findBlock(int(positionAt(offset)));
+    QTextCursor cursor(textView->document());
+    cursor.setPosition(block.position() + qBound(0, column - 1, block.length() - 1));
+    textView->setTextCursor(cursor);
+    textView->centerCursor();
+    textView->setFocus();
+}
+
+void LargeFileView::goToEnteredLine()
+{
+    bool ok = false;
+    const qint64 line = lineEdit->text().trimmed().toLongLong(&ok);
+    if (ok && line > 0)
+        goToLine(line);
+}
+
+void LargeFileView::goToEnteredOffset()
+{
+    bool ok = false;
+    const qint64 offset = offsetEdit->text().trimmed().toLongLong(&ok, 0); // 0x for hexadecimal
+    if (ok && offset >= 0)
+        goToOffset(offset);
+}
+
+void LargeFileView::showGoToLine()
+{
+    lineEdit->setFocus();
+    lineEdit->selectAll();
+}
+
+void LargeFileView::showFind()
+{
+    const QString selection = textView->textCursor().selectedText();
+    if (!selection.isEmpty() && !selection.contains(QChar::ParagraphSeparator))
+        findEdit->setText(selection);
+    findEdit->setFocus();
+    findEdit->selectAll();
+}
+
+void LargeFileView::updateStatus()
+{
+    const qint64 offset = offsetAt(textView->textCursor().position());
+    const qint64 line = lineAt(offset);
+
+    QString text = line >= 0 ? QString("Line %1").arg(line + 1) : QString("Line ?");
+    text += QString(", offset %1 of %2").arg(offset).arg(fileSize);
+    if (indexComplete)
+        text += QString(" - %1 lines").arg(indexedLines + 1);
+    else
+        text += QString(" - counting lines %1%").arg(fileSize > 0 ? qint64(checkpoints.size()) * IndexBlock * 100 / fileSize : 100);
+    if (pendingLine > 0)
+        text += QString(" - going to line %1").arg(pendingLine);
+    if (file->size() < fileSize)
+        text += " - the file shrank on disk, reopen it";
+    statusLabel->setText(text);
+}
+
+/* Line index */
+
+void LargeFileView::startIndexing()
+{
+    const quint64 id = generation.loadRelaxed();
+    const QString filePath = file->fileName();
+    const qint64 size = fileSize;
+
+    indexPool.start([this, id, filePath, size]() {
+        // A QFile of its own, the view's one is used from the GUI thread
+        QFile source(filePath);
+        const bool opened = source.open(QIODevice::ReadOnly);
+        QByteArray buffer(qMin(IndexBlock, size), Qt::Uninitialized);
+        QList<qint64> counts;
+        QElapsedTimer sinceReport;
+        sinceReport.start();
+
+        for (qint64 start = 0; start < size || counts.isEmpty(); start += IndexBlock)
+        {
+            if (generation.loadRelaxed() != id)
+                return;
+
+            const qint64 length = qMin(IndexBlock, size - start);
+            const qint64 count = length > 0 && opened ? qMax(source.read(buffer.data(), length), qint64(0)) : 0;
+            counts.append(LineIndex::countNewlines(buffer.constData(), count));
+
+            // A file cut short ends the index where its bytes end
+            const bool last = start + IndexBlock >= size || count < length;
+            if (last || sinceReport.elapsed() >= IndexReportMs)
+            {
+                QMetaObject::invokeMethod(this, [this, id, counts, last]() {
+                    if (generation.loadRelaxed() == id)
+                        addCheckpoints(counts, last);
+                }, Qt::QueuedConnection);
+                counts.clear();
+                sinceReport.restart();
+            }
+            if (last)
+                break;
+        }
+    });
+}
+
+void LargeFileView::addCheckpoints(const QList<qint64> &counts, bool last)
+{
+    for (qint64 count : counts)
+    {
+        checkpoints.append(indexedLines);
+        indexedLines += count;
+    }
+    indexComplete = last;
+
+    if (pendingLine > 0 && (indexComplete || pendingLine - 1 <= indexedLines))
+        goToLine(pendingLine, pendingColumn);
+    updateStatus();
+}
+
+qint64 LargeFileView::lineAt(qint64 offset) const
+{
+    const qint64 block = offset / IndexBlock;
+    if (block >= checkpoints.size())
+        return -1;
+    const qint64 start = block * IndexBlock;
+    const QByteArray bytes = read(start, offset - start);
+    return checkpoints.at(block) + LineIndex::countNewlines(bytes.constData(), bytes.size());
+}
+
+qint64 LargeFileView::lineOffset(qint64 line) const
+{
+    if (line <= 0)
+        return contentStart;
+    if (checkpoints.isEmpty() || line > indexedLines)
+        return -1;
+
+    // The newline ending the line before is in the last block with fewer before it
+    const qsizetype block = qsizetype(std::lower_bound(checkpoints.begin(), checkpoints.end(), line) - checkpoints.begin()) - 1;
+    const qint64 start = block * IndexBlock;
+    const QByteArray bytes = read(start, IndexBlock);
+    const qsizetype newline = LineIndex::findNthNewline(bytes.constData(), bytes.size(), line - checkpoints.at(block) - 1);
+    return newline >= 0 ? start + newline + 1 : -1;
+}
+
+/* Find */
+
+void LargeFileView::findNext()
+{
+    const QString pattern = findEdit->text();
+    if (pattern.isEmpty())
+        return;
+
+    // The pattern as the file's bytes: case folds for ASCII, and for all of Latin-1
+    const bool latin1 = textFormat.encoding == QStringConverter::Latin1;
+    bool ascii = true;
+    bool encodable = true;
+    for (QChar c : pattern)
+    {
+        ascii = ascii && c.unicode() < 0x80;
+        encodable = encodable && (!latin1 || c.unicode() <= 0xFF);
+    }
+    if (!encodable)
+    {
+        statusLabel->setText("Not found");
+        return;
+    }
+
+    const QByteArray bytes = latin1 ? pattern.toLatin1() : pattern.toUtf8();
+    const Qt::CaseSensitivity cs = caseSensitiveCheck->isChecked() || !(ascii || latin1) ? Qt::CaseSensitive : Qt::CaseInsensitive;
+    QSharedPointer<const TextMatcher> matcher(new TextMatcher(QString::fromLatin1(bytes), cs));
+
+    const qint64 from = offsetAt(textView->textCursor().selectionEnd());
+    const quint64 id = findGeneration.fetchAndAddOrdered(1) + 1;
+    const QString filePath = file->fileName();
+    const qint64 size = fileSize;
+    const qint64 first = contentStart;
+    statusLabel->setText("Searching ...");
+
+    findPool.start([this, id, matcher, filePath, size, first, from]() {
+        const qint64 length = matcher->length();
+        QFile source(filePath);
+        const bool opened = source.open(QIODevice::ReadOnly);
+        QByteArray buffer(FindChunk + length - 1, Qt::Uninitialized);
+
+        // Chunks overlap by the pattern, each match starts in one chunk only
+        const auto scan = [&](qint64 start, qint64 end) -> qint64 {
+            for (qint64 chunk = start; chunk < end; chunk += FindChunk)
+            {
+                if (findGeneration.loadRelaxed() != id)
+                    return -2;
+                const qint64 chunkEnd = qMin(end, chunk + FindChunk + length - 1);
+                const qint64 count = opened && source.seek(chunk) ? qMax(source.read(buffer.data(), chunkEnd - chunk), qint64(0)) : 0;
+                const qsizetype index = matcher->indexIn(buffer.constData(), count);
+                if (index >= 0)
+                    return chunk + index;
+                if (count < chunkEnd - chunk)
+                    break; // the file shrank
+            }
+            return -1;
+        };
+
+        // To the end, then from the start
+        qint64 found = scan(from, size);
+        const bool wrapped = found == -1;
+        if (wrapped)
+            found = scan(first, qMin(size, from + length - 1));
+        if (found == -2)
+            return;
+
+        QMetaObject::invokeMethod(this, [this, id, found, length, wrapped]() {
+            if (findGeneration.loadRelaxed() == id)
+                findFinished(found, length, wrapped);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LargeFileView::findFinished(qint64 offset, qint64 length, bool wrapped)
+{
+    if (offset < 0)
+    {
+        statusLabel->setText("Not found");
+        return;
+    }
+
+    showOffset(offset, false);
+    QTextCursor cursor(textView->document());
+    cursor.setPosition(int(positionAt(offset)));
+    cursor.setPosition(int(positionAt(offset + length)), QTextCursor::KeepAnchor);
+    textView->setTextCursor(cursor);
+    textView->centerCursor();
+    if (wrapped)
+        statusLabel->setText(statusLabel->text() + " - search wrapped around");
+}
@@ -0,0 +1,107 @@
+#ifndef LARGEFILEVIEW_H
+#define LARGEFILEVIEW_H
+
+#include <QWidget>
+#include <QFile>
+#include <QPlainTextEdit>
+#include <QScrollBar>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QCheckBox>
+#include <QLabel>
+#include <QThreadPool>
+#include <QAtomicInteger>
+
+#include "TextFormat.h"
+
+// Read-only view of a file too large to load. Only a window of a few MB
+// around what is shown is read and decoded into the editor; scrolling close
+// to its ends pages another window in. The scroll bar stands for byte
+// offsets. Lines are counted in the background into a sparse index (one
+// count per MB), which turns line numbers into offsets with at most a MB to
+// scan. Finding reads through the file on a worker. The file is read, never
+// mapped: one cut short by another program only shows less text instead of
+// crashing. Memory use doesn't depend on the file's size.
+class LargeFileView : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LargeFileView(QWidget *parent = nullptr);
+    ~LargeFileView();
+
+    bool open(const QString &filePath);
+    QString errorString() const { return error; }
+    TextFormat format() const { return textFormat; }
+    qint64 memoryCost() const { return windowText.size() * 2; }
+
+    void goToOffset(qint64 offset);
+    void goToLine(qint64 line, int column = 1); // 1-based, once the index reaches it
+    qint64 lineCount() const { return indexComplete ? indexedLines + 1 : -1; } // -1 while indexing
+    void showGoToLine();
+    void showFind();
+
+private slots:
+    void viewScrolled();
+    void scrollBarMoved(int value);
+    void updateStatus();
+    void goToEnteredLine();
+    void goToEnteredOffset();
+    void findNext();
+
+private:
+    // Bytes [offset, offset + length) of the file, fewer if it shrank
+    QByteArray read(qint64 offset, qint64 length) const;
+
+    // Window
+    void loadWindow(qint64 offset);
+    void showOffset(qint64 offset, bool atTop);
+    qint64 lineStartBefore(qint64 offset) const;
+    qint64 characterStart(qint64 offset) const;
+    qint64 offsetAt(qsizetype position) const; // character of the window to byte offset
+    qsizetype positionAt(qint64 offset) const; // and back
+
+    // Line index
+    void startIndexing();
+    void addCheckpoints(const QList<qint64> &counts, bool last);
+    qint64 lineAt(qint64 offset) const; // 0-based, -1 if not indexed yet
+    qint64 lineOffset(qint64 line) const; // -1 if not indexed yet
+
+    void findFinished(qint64 offset, qint64 length, bool wrapped);
+
+    QPlainTextEdit *textView;
+    QScrollBar *scrollBar;
+    QLineEdit *lineEdit;
+    QLineEdit *offsetEdit;
+    QLineEdit *findEdit;
+    QCheckBox *caseSensitiveCheck;
+    QLabel *statusLabel;
+
+    QFile *file;
+    qint64 fileSize; // when opened, the file may shrink since
+    qint64 contentStart; // after the byte order mark
+    TextFormat textFormat;
+    QString error;
+
+    // Decoded window [windowStart, windowEnd) of the file
+    qint64 windowStart;
+    qint64 windowEnd;
+    QString windowText;
+    QList<qint64> windowOffsets; // byte offset of every OffsetStep-th character
+    bool windowLatin1; // one character a byte, no offsets needed
+    bool paging;
+
+    // Newlines before each index block, filled from the worker
+    QList<qint64> checkpoints;
+    qint64 indexedLines;
+    bool indexComplete;
+    qint64 pendingLine; // line to go to once indexed, 0 for none
+    int pendingColumn;
+
+    QThreadPool indexPool;
+    QThreadPool findPool;
+    QAtomicInteger<quint64> generation;
+    QAtomicInteger<quint64> findGeneration;
+};
+
+#endif // LARGEFILEVIEW_H
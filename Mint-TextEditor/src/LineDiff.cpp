@@ -0,0 +1,128 @@
+#include "LineDiff.h"
+#include <QHash>
+#include <algorithm>
+
+namespace
+{
+struct Line
+{
+    qsizetype start;
+    qsizetype length; // with its newline
+    size_t hash;
+};
+
+QList<Line> splitLines(QStringView text)
+{
+    QList<Line> lines;
+    qsizetype start = 0;
+    while (start < text.size())
+    {
+        const qsizetype newline = text.indexOf(u'\n', start);
+        const qsizetype end = newline < 0 ? text.size() : newline + 1;
+        lines.append(Line{ start, end - start, qHash(text.mid(start, end - start)) });
+        start = end;
+    }
+    return lines;
+}
+}
+
+QList<LineDiff::Hunk> LineDiff::compute(QStringView oldText, QStringView newText, qsizetype maxEdits)
+{
+    const QList<Line> a = splitLines(oldText);
+    const QList<Line> b = splitLines(newText);
+    const auto equal = [&](qsizetype i, qsizetype j) {
+        return a.at(i).hash == b.at(j).hash && a.at(i).length == b.at(j).length
+               && oldText.mid(a.at(i).start, a.at(i).length) == newText.mid(b.at(j).start, b.at(j).length);
+    };
+
+    // Common first and last lines, usually most of the text
+    qsizetype prefix = 0;
+    while (prefix < a.size() && prefix < b.size() && equal(prefix, prefix))
+        ++prefix;
+    qsizetype suffix = 0;
+    while (suffix < a.size() - prefix && suffix < b.size() - prefix && equal(a.size() - 1 - suffix, b.size() - 1 - suffix))
+        ++suffix;
+
+    const qsizetype n = a.size() - prefix - suffix;
+    const qsizetype m = b.size() - prefix - suffix;
+
+    // Matching lines of the middle (relative to the prefix), found by
+    // following the furthest-reaching path on each diagonal k = x - y
+    QList<QPair<qsizetype, qsizetype>> matches;
+    const qsizetype limit = qMin(n + m, maxEdits);
+    const qsizetype offset = limit + 1;
+    QList<qsizetype> v(2 * limit + 3, 0);
+    QList<QList<qsizetype>> trace; // v before each step d, on diagonals -d-1 .. d+1
+    qsizetype edits = -1;
+
+    for (qsizetype d = 0; d <= limit && edits < 0; ++d)
+    {
+        trace.append(v.mid(offset - d - 1, 2 * d + 3));
+        for (qsizetype k = -d; k <= d; k += 2)
+        {
+            qsizetype x = (k == -d || (k != d && v.at(offset + k - 1) < v.at(offset + k + 1)))
+                              ? v.at(offset + k + 1)
+                              : v.at(offset + k - 1) + 1;
+            qsizetype y = x - k;
+            while (x < n && y < m && equal(prefix + x, prefix + y))
+            {
+                ++x;
+                ++y;
+            }
+            v[offset + k] = x;
+            if (x >= n && y >= m)
+            {
+                edits = d;
+                break;
+            }
+        }
+    }
+
+    if (edits >= 0)
+    {
+        // Walk the path back, collecting its diagonal moves
+        qsizetype x = n;
+        qsizetype y = m;
+        for (qsizetype d = edits; d >= 0; --d)
+        {
+            const QList<qsizetype> &previous = trace.at(d);
+            const auto at = [&](qsizetype k) { return previous.at(k + d + 1); };
+            const qsizetype k = x - y;
+            const qsizetype previousK = (k == -d || (k != d && at(k - 1) < at(k + 1))) ? k + 1 : k - 1;
+            const qsizetype previousX = d > 0 ? at(previousK) : 0;
+            const qsizetype previousY = d > 0 ? previousX - previousK : 0;
+
+            while (x > previousX && y > previousY)
+            {
+                --x;
+                --y;
+                matches.append(qMakePair(x, y));
+            }
+            x = previousX;
+            y = previousY;
+        }
+        std::reverse(matches.begin(), matches.end());
+    }
+
+    // Hunks are the gaps between matching lines
+    const auto oldPosition = [&](qsizetype line) { return line < a.size() ? a.at(line).start : oldText.size(); };
+    const auto newPosition = [&](qsizetype line) { return line < b.size() ? b.at(line).start : newText.size(); };
+
+    QList<Hunk> hunks;
+    qsizetype x = 0;
+    qsizetype y = 0;
+    matches.append(qMakePair(n, m));
+    for (const auto &match : matches)
+    {
+        if (match.first > x || match.second > y)
+        {
+            const qsizetype position = oldPosition(prefix + x);
+            const qsizetype from = newPosition(prefix + y);
+            hunks.append(Hunk{ position, oldPosition(prefix + match.first) - position,
+                               from, newPosition(prefix + match.second) - from });
+        }
+        x = match.first + 1;
+        y = match.second + 1;
+    }
+    return hunks;
+}
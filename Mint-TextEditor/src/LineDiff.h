@@ -0,0 +1,26 @@
+#ifndef LINEDIFF_H
+#define LINEDIFF_H
+
+#include <QList>
+#include <QStringView>
+
+// Line-level difference of two texts (Myers' algorithm on line hashes, after
+// trimming the common first and last lines), as the character ranges of the
+// old text to replace by ranges of the new one. Past 'maxEdits' inserted or
+// removed lines the whole differing middle becomes a single hunk.
+class LineDiff
+{
+public:
+    struct Hunk
+    {
+        qsizetype position; // in the old text
+        qsizetype removed;
+        qsizetype from;     // in the new text
+        qsizetype added;
+    };
+
+    // Hunks in increasing position order, apply them from the last one
+    static QList<Hunk> compute(QStringView oldText, QStringView newText, qsizetype maxEdits = 1000);
+};
+
+#endif // LINEDIFF_H
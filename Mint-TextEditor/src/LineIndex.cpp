@@ -0,0 +1,125 @@
+#include "LineIndex.h"
+#include "Simd.h"
+#include <QtAlgorithms>
+
+// Blocks of 16 characters are tested at once, one mask bit per character
+static const qsizetype BlockSize = 16;
+
+static inline bool isNewline(char c) { return c == '\n'; }
+static inline bool isNewline(QChar c) { return c.unicode() == u'\n'; }
+
+#ifdef MINT_SSE2
+static inline quint32 newlineMask(const char *data)
+{
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    return quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'))));
+}
+
+static inline quint32 newlineMask(const QChar *data)
+{
+    // Two compares of 8 code units, packed down to one byte per character
+    const __m128i newline = _mm_set1_epi16('\n');
+    const __m128i low = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data)), newline);
+    const __m128i high = _mm_cmpeq_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 8)), newline);
+    return quint32(_mm_movemask_epi8(_mm_packs_epi16(low, high)));
+}
+#else
+template <typename Char>
+static inline quint32 newlineMask(const Char *data)
+{
+    quint32 mask = 0;
+    for (qsizetype i = 0; i < BlockSize; ++i)
+        mask |= quint32(isNewline(data[i])) << i;
+    return mask;
+}
+#endif
+
+template <typename Char>
+static void scanNewlines(const Char *data, qsizetype size, qsizetype base, QList<qsizetype> &newlines)
+{
+    qsizetype i = 0;
+    for (; i + BlockSize <= size; i += BlockSize)
+    {
+        for (quint32 mask = newlineMask(data + i); mask; mask &= mask - 1)
+            newlines.append(base + i + qCountTrailingZeroBits(mask));
+    }
+
+    for (; i < size; ++i)
+    {
+        if (isNewline(data[i]))
+            newlines.append(base + i);
+    }
+}
+
+template <typename Char>
+static qsizetype scanCount(const Char *data, qsizetype size)
+{
+    qsizetype count = 0;
+    qsizetype i = 0;
+    for (; i + BlockSize <= size; i += BlockSize)
+        count += qPopulationCount(newlineMask(data + i));
+
+    for (; i < size; ++i)
+        count += isNewline(data[i]);
+
+    return count;
+}
+
+template <typename Char>
+static qsizetype scanNth(const Char *data, qsizetype size, qsizetype n)
+{
+    qsizetype i = 0;
+    for (; i + BlockSize <= size; i += BlockSize)
+    {
+        quint32 mask = newlineMask(data + i);
+        const qsizetype count = qPopulationCount(mask);
+        if (n >= count)
+        {
+            n -= count;
+            continue;
+        }
+
+        // Drop the n lowest newlines of the block
+        for (; n > 0; --n)
+            mask &= mask - 1;
+        return i + qCountTrailingZeroBits(mask);
+    }
+
+    for (; i < size; ++i)
+    {
+        if (isNewline(data[i]) && n-- == 0)
+            return i;
+    }
+
+    return -1;
+}
+
+void LineIndex::findNewlines(const char *data, qsizetype size, qsizetype base, QList<qsizetype> &newlines)
+{
+    scanNewlines(data, size, base, newlines);
+}
+
+void LineIndex::findNewlines(const QChar *data, qsizetype size, qsizetype base, QList<qsizetype> &newlines)
+{
+    scanNewlines(data, size, base, newlines);
+}
+
+qsizetype LineIndex::countNewlines(const char *data, qsizetype size)
+{
+    return scanCount(data, size);
+}
+
+qsizetype LineIndex::countNewlines(const QChar *data, qsizetype size)
+{
+    return scanCount(data, size);
+}
+
+qsizetype LineIndex::findNthNewline(const char *data, qsizetype size, qsizetype n)
+{
+    return scanNth(data, size, n);
+}
+
+qsizetype LineIndex::findNthNewline(const QChar *data, qsizetype size, qsizetype n)
+{
+    return scanNth(data, size, n);
+}
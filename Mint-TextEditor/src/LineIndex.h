@@ -0,0 +1,24 @@
+#ifndef LINEINDEX_H
+#define LINEINDEX_H
+
+#include <QChar>
+#include <QList>
+
+// Newline scanning used to build line-start indexes. Both encodings are
+// scanned 16 bytes at a time with SSE2 where available.
+class LineIndex
+{
+public:
+    // Appends 'base + i' for every '\n' found at index i
+    static void findNewlines(const char *data, qsizetype size, qsizetype base, QList<qsizetype> &newlines);
+    static void findNewlines(const QChar *data, qsizetype size, qsizetype base, QList<qsizetype> &newlines);
+
+    static qsizetype countNewlines(const char *data, qsizetype size);
+    static qsizetype countNewlines(const QChar *data, qsizetype size);
+
+    // Index of the n-th '\n' (0-based) or -1 when there are fewer
+    static qsizetype findNthNewline(const char *data, qsizetype size, qsizetype n);
+    static qsizetype findNthNewline(const QChar *data, qsizetype size, qsizetype n);
+};
+
+#endif // LINEINDEX_H
@@ -0,0 +1,155 @@
+#include "MarkdownConverter.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+MarkdownConverter::MarkdownConverter(QObject *parent)
+    : QObject(parent), generation(0), running(false)
+{
+    // Conversions run in order, each one starts from the previous blocks
+    pool.setMaxThreadCount(1);
+}
+
+MarkdownConverter::~MarkdownConverter()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+void MarkdownConverter::convert(const TextSnapshot &text)
+{
+    update(text, 0, text.lineCount(), 0);
+}
+
+void MarkdownConverter::update(const TextSnapshot &text, qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta)
+{
+    const quint64 id = generation.fetchAndAddOrdered(1) + 1;
+    const QList<Block> previous = results;
+    running = true;
+
+    pool.start([this, id, text, previous, dirtyFirst, dirtyLast, lineDelta]() {
+        QElapsedTimer timer;
+        timer.start();
+
+        const qsizetype lineCount = text.lineCount();
+        const auto line = [&text, lineCount](qsizetype i) {
+            const qsizetype start = text.lineStart(i);
+            const qsizetype end = i + 1 < lineCount ? text.lineStart(i + 1) - 1 : text.length();
+            return text.text(start, end - start);
+        };
+
+        Update update;
+        if (!convertBlocks(line, lineCount, previous, dirtyFirst, dirtyLast, lineDelta, &update,
+                           [this, id]() { return generation.loadRelaxed() != id; }))
+            return;
+
+        const qint64 elapsedMs = timer.elapsed();
+        QMetaObject::invokeMethod(this, [this, id, update, elapsedMs]() {
+            apply(id, update, elapsedMs);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void MarkdownConverter::cancel()
+{
+    generation.fetchAndAddOrdered(1);
+    running = false;
+}
+
+qsizetype MarkdownConverter::blockAt(qsizetype line) const
+{
+    const auto after = std::upper_bound(results.cbegin(), results.cend(), line, [](qsizetype l, const Block &block) {
+        return l < block.firstLine;
+    });
+    return (after - results.cbegin()) - 1;
+}
+
+bool MarkdownConverter::convertBlocks(const MarkdownParser::LineReader &line, qsizetype lineCount, const QList<Block> &previous,
+                                      qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta, Update *update,
+                                      const std::function<bool()> &cancelled)
+{
+    // The block before the first changed line may grow into it, earlier ones
+    // end before the next non-blank line and are kept
+    const qsizetype before = std::lower_bound(previous.cbegin(), previous.cend(), dirtyFirst, [](const Block &block, qsizetype l) {
+        return block.firstLine < l;
+    }) - previous.cbegin();
+    const qsizetype first = qMax(before - 1, qsizetype(0));
+    qsizetype i = before > 0 ? previous.at(before - 1).firstLine : 0;
+
+    QList<Block> converted;
+    qsizetype next = first; // first previous block not replaced yet
+    bool resynced = false;
+    while (i < lineCount)
+    {
+        if (cancelled && cancelled())
+            return false;
+
+        if (MarkdownParser::isBlank(line(i)))
+        {
+            ++i;
+            continue;
+        }
+
+        // Past the changes, a block starting where one did before is the same
+        // as that one, and so are all the blocks after it
+        if (i > dirtyLast)
+        {
+            while (next < previous.size() && previous.at(next).firstLine + lineDelta < i)
+                ++next;
+            if (next < previous.size() && previous.at(next).firstLine + lineDelta == i)
+            {
+                resynced = true;
+                break;
+            }
+        }
+
+        const qsizetype end = MarkdownParser::blockEnd(line, lineCount, i);
+        QStringList lines;
+        for (qsizetype k = i; k < end; ++k)
+            lines.append(line(k));
+        converted.append(Block{ i, end - i, MarkdownParser::toHtml(lines) });
+        i = end;
+    }
+    if (!resynced)
+        next = previous.size();
+
+    update->blocks = previous.first(first);
+    update->blocks.append(converted);
+    update->blocks.reserve(update->blocks.size() + previous.size() - next);
+    for (qsizetype k = next; k < previous.size(); ++k)
+    {
+        Block block = previous.at(k);
+        block.firstLine += lineDelta;
+        update->blocks.append(block);
+    }
+
+    // Only blocks whose HTML changed go to the preview
+    const qsizetype replaced = next - first;
+    qsizetype same = 0;
+    while (same < converted.size() && same < replaced && converted.at(same).html == previous.at(first + same).html)
+        ++same;
+    qsizetype sameTail = 0;
+    while (sameTail < converted.size() - same && sameTail < replaced - same
+           && converted.at(converted.size() - 1 - sameTail).html == previous.at(next - 1 - sameTail).html)
+        ++sameTail;
+
+    update->first = first + same;
+    update->removed = replaced - same - sameTail;
+    update->html.clear();
+    for (qsizetype k = same; k < converted.size() - sameTail; ++k)
+        update->html.append(converted.at(k).html);
+    return true;
+}
+
+void MarkdownConverter::apply(quint64 id, const Update &update, qint64 elapsedMs)
+{
+    // Result of a conversion cancelled since
+    if (id != generation.loadRelaxed())
+        return;
+
+    results = update.blocks;
+    running = false;
+
+    if (update.removed > 0 || !update.html.isEmpty())
+        emit blocksChanged(update.first, update.removed, update.html);
+    emit finished(elapsedMs);
+}
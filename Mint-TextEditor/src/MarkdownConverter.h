@@ -0,0 +1,71 @@
+#ifndef MARKDOWNCONVERTER_H
+#define MARKDOWNCONVERTER_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QStringList>
+#include <functional>
+
+#include "PieceTable.h"
+#include "MarkdownParser.h"
+
+// Converts a Markdown text snapshot to HTML on a worker thread, keeping the
+// HTML of each top-level block. After an edit only the blocks from just
+// before the changed lines up to the first block that starts where it did
+// before are converted again; the preview is told which blocks changed.
+class MarkdownConverter : public QObject
+{
+    Q_OBJECT
+
+public:
+    struct Block
+    {
+        qsizetype firstLine;
+        qsizetype lineCount;
+        QString html;
+    };
+
+    // Blocks [first, first + removed) of the previous conversion replaced by 'html'
+    struct Update
+    {
+        QList<Block> blocks;
+        qsizetype first;
+        qsizetype removed;
+        QStringList html;
+    };
+
+    explicit MarkdownConverter(QObject *parent = nullptr);
+    ~MarkdownConverter();
+
+    void convert(const TextSnapshot &text);
+    // Lines [dirtyFirst, dirtyLast] of 'text' changed since the previous
+    // conversion, and 'lineDelta' lines were added. Wait for finished()
+    // before the next update, it starts from the blocks of this one.
+    void update(const TextSnapshot &text, qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta);
+    void cancel();
+
+    bool isRunning() const { return running; }
+    const QList<Block> &blocks() const { return results; }
+    qsizetype blockAt(qsizetype line) const; // last block starting at or before 'line', -1 if none
+
+    // The conversion itself, 'previous' being the blocks before the edit.
+    // Returns false if cancelled() returned true.
+    static bool convertBlocks(const MarkdownParser::LineReader &line, qsizetype lineCount, const QList<Block> &previous,
+                              qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta, Update *update,
+                              const std::function<bool()> &cancelled = std::function<bool()>());
+
+signals:
+    void blocksChanged(qsizetype first, qsizetype removed, const QStringList &html);
+    void finished(qint64 elapsedMs);
+
+private:
+    void apply(quint64 id, const Update &update, qint64 elapsedMs);
+
+    QThreadPool pool;
+    QAtomicInteger<quint64> generation;
+    QList<Block> results;
+    bool running;
+};
+
+#endif // MARKDOWNCONVERTER_H
@@ -0,0 +1,835 @@
+#include "MarkdownParser.h"
+#include <QRegularExpression>
+#include <QList>
+#include <climits>
+
+// Line classification
+
+// Columns of leading whitespace (tab stops every 4 columns), and the index
+// of the first other character
+static int indentOf(const QString &line, qsizetype *contentStart = nullptr)
+{
+    int columns = 0;
+    qsizetype i = 0;
+    for (; i < line.size(); ++i)
+    {
+        if (line.at(i) == u' ')
+            columns++;
+        else if (line.at(i) == u'\t')
+            columns += 4 - columns % 4;
+        else
+            break;
+    }
+
+    if (contentStart)
+        *contentStart = i;
+    return columns;
+}
+
+// 'line' without up to 'columns' columns of leading whitespace
+static QString stripIndent(const QString &line, int columns)
+{
+    int column = 0;
+    qsizetype i = 0;
+    for (; i < line.size() && column < columns; ++i)
+    {
+        if (line.at(i) == u' ')
+            column++;
+        else if (line.at(i) == u'\t')
+        {
+            const int width = 4 - column % 4;
+            // Part of the tab belongs to the content
+            if (column + width > columns)
+                return QString(column + width - columns, u' ') + line.mid(i + 1);
+            column += width;
+        }
+        else
+            break;
+    }
+    return line.mid(i);
+}
+
+bool MarkdownParser::isBlank(const QString &line)
+{
+    for (QChar c : line)
+    {
+        if (c != u' ' && c != u'\t')
+            return false;
+    }
+    return true;
+}
+
+static bool isThematicBreak(const QString &line)
+{
+    qsizetype i;
+    if (indentOf(line, &i) > 3 || i >= line.size())
+        return false;
+
+    const QChar marker = line.at(i);
+    if (marker != u'*' && marker != u'-' && marker != u'_')
+        return false;
+
+    int count = 0;
+    for (; i < line.size(); ++i)
+    {
+        if (line.at(i) == marker)
+            count++;
+        else if (line.at(i) != u' ' && line.at(i) != u'\t')
+            return false;
+    }
+    return count >= 3;
+}
+
+// Level of an ATX heading ("## Title"), 0 for other lines
+static int headingLevel(const QString &line)
+{
+    qsizetype i;
+    if (indentOf(line, &i) > 3)
+        return 0;
+
+    int level = 0;
+    while (i + level < line.size() && line.at(i + level) == u'#')
+        level++;
+    if (level == 0 || level > 6)
+        return 0;
+
+    const qsizetype next = i + level;
+    return next == line.size() || line.at(next) == u' ' || line.at(next) == u'\t' ? level : 0;
+}
+
+// Level of a setext heading underline ("===" or "---"), 0 for other lines
+static int setextLevel(const QString &line)
+{
+    qsizetype i;
+    if (indentOf(line, &i) > 3 || i >= line.size())
+        return 0;
+
+    const QChar marker = line.at(i);
+    if (marker != u'=' && marker != u'-')
+        return 0;
+
+    while (i < line.size() && line.at(i) == marker)
+        ++i;
+    return MarkdownParser::isBlank(line.mid(i)) ? (marker == u'=' ? 1 : 2) : 0;
+}
+
+struct Fence
+{
+    QChar marker;
+    int length;
+    int indent;
+    QString info;
+};
+
+static bool openFence(const QString &line, Fence *fence)
+{
+    qsizetype i;
+    const int indent = indentOf(line, &i);
+    if (indent > 3 || i >= line.size())
+        return false;
+
+    const QChar marker = line.at(i);
+    if (marker != u'`' && marker != u'~')
+        return false;
+
+    int length = 0;
+    while (i + length < line.size() && line.at(i + length) == marker)
+        length++;
+    if (length < 3)
+        return false;
+
+    const QString info = line.mid(i + length).trimmed();
+    if (marker == u'`' && info.contains(u'`'))
+        return false;
+
+    if (fence)
+        *fence = Fence{ marker, length, indent, info };
+    return true;
+}
+
+static bool closesFence(const QString &line, const Fence &fence)
+{
+    qsizetype i;
+    if (indentOf(line, &i) > 3)
+        return false;
+
+    int length = 0;
+    for (; i < line.size() && line.at(i) == fence.marker; ++i)
+        length++;
+    return length >= fence.length && MarkdownParser::isBlank(line.mid(i));
+}
+
+enum HtmlBlock
+{
+    NoHtml,
+    RawHtml,     // <pre>, <script>, <style>, <textarea>: up to the closing tag
+    CommentHtml, // up to "-->"
+    TagHtml      // block-level tag: up to a blank line
+};
+
+static HtmlBlock htmlBlockKind(const QString &line)
+{
+    static const QRegularExpression raw(R"re((?:script|pre|style|textarea)(?:\s|>|$))re",
+                                        QRegularExpression::CaseInsensitiveOption);
+    static const QRegularExpression tag(R"re(/?(?:address|article|aside|blockquote|body|details|dialog|dd|div|dl|dt|)re"
+                                        R"re(fieldset|figcaption|figure|footer|form|h[1-6]|head|header|hr|html|iframe|)re"
+                                        R"re(legend|li|main|menu|nav|ol|p|section|summary|table|tbody|td|tfoot|th|)re"
+                                        R"re(thead|tr|ul)(?:\s|/?>|$))re",
+                                        QRegularExpression::CaseInsensitiveOption);
+
+    qsizetype i;
+    if (indentOf(line, &i) > 3 || i >= line.size() || line.at(i) != u'<')
+        return NoHtml;
+
+    if (QStringView(line).mid(i + 1).startsWith(u"!--"))
+        return CommentHtml;
+    if (raw.match(line, i + 1, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption).hasMatch())
+        return RawHtml;
+    if (tag.match(line, i + 1, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption).hasMatch())
+        return TagHtml;
+    return NoHtml;
+}
+
+static bool closesHtmlBlock(const QString &line, HtmlBlock kind)
+{
+    static const QRegularExpression rawEnd("</(?:script|pre|style|textarea)>", QRegularExpression::CaseInsensitiveOption);
+
+    if (kind == CommentHtml)
+        return line.contains(u"-->");
+    return line.contains(rawEnd);
+}
+
+static bool isQuote(const QString &line)
+{
+    qsizetype i;
+    return indentOf(line, &i) <= 3 && i < line.size() && line.at(i) == u'>';
+}
+
+struct ListMarker
+{
+    bool ordered;
+    QChar delimiter;   // bullet, or '.' / ')' after a number
+    int start;
+    qsizetype end;     // index after the marker
+    int markerColumn;  // column after the marker
+    int contentIndent; // column of the item's content
+    bool empty;        // nothing after the marker
+};
+
+static bool listMarker(const QString &line, ListMarker *marker)
+{
+    qsizetype i;
+    const int indent = indentOf(line, &i);
+    if (indent > 3 || i >= line.size())
+        return false;
+
+    ListMarker m{ false, line.at(i), 1, i, 0, 0, false };
+    if (m.delimiter == u'-' || m.delimiter == u'+' || m.delimiter == u'*')
+        m.end = i + 1;
+    else
+    {
+        while (m.end < line.size() && m.end - i < 9 && line.at(m.end) >= u'0' && line.at(m.end) <= u'9')
+            m.end++;
+        if (m.end == i || m.end >= line.size() || (line.at(m.end) != u'.' && line.at(m.end) != u')'))
+            return false;
+
+        m.ordered = true;
+        m.start = line.mid(i, m.end - i).toInt();
+        m.delimiter = line.at(m.end);
+        m.end++;
+    }
+
+    if (m.end < line.size() && line.at(m.end) != u' ' && line.at(m.end) != u'\t')
+        return false;
+
+    // Content starts after one to four spaces, or one if there are more
+    m.markerColumn = indent + int(m.end - i);
+    m.empty = MarkdownParser::isBlank(line.mid(m.end));
+    const int spaces = indentOf(QString(m.markerColumn, u' ') + line.mid(m.end)) - m.markerColumn;
+    m.contentIndent = m.markerColumn + (m.empty || spaces > 4 ? 1 : spaces);
+
+    if (marker)
+        *marker = m;
+    return true;
+}
+
+static bool sameList(const ListMarker &a, const ListMarker &b)
+{
+    return a.ordered == b.ordered && a.delimiter == b.delimiter;
+}
+
+static bool interruptsParagraph(const QString &line)
+{
+    ListMarker marker;
+    return headingLevel(line) || isThematicBreak(line) || openFence(line, nullptr) || isQuote(line)
+        || htmlBlockKind(line) != NoHtml
+        || (listMarker(line, &marker) && !marker.empty && (!marker.ordered || marker.start == 1));
+}
+
+// Block boundaries
+
+static qsizetype listEnd(const MarkdownParser::LineReader &line, qsizetype lineCount, qsizetype first, const ListMarker &list)
+{
+    int indent = list.contentIndent; // of the current item
+    qsizetype end = first + 1;       // after the last non-blank line
+    bool blank = false;
+
+    for (qsizetype i = first + 1; i < lineCount; ++i)
+    {
+        const QString text = line(i);
+        ListMarker marker;
+
+        if (MarkdownParser::isBlank(text))
+            blank = true;
+        else if (indentOf(text) >= indent)
+            end = i + 1; // item content
+        else if (!isThematicBreak(text) && listMarker(text, &marker) && sameList(marker, list))
+        {
+            indent = marker.contentIndent; // next item
+            end = i + 1;
+        }
+        else if (blank || interruptsParagraph(text))
+            break;
+        else
+            end = i + 1; // lazy continuation
+
+        if (end == i + 1)
+            blank = false;
+    }
+    return end;
+}
+
+qsizetype MarkdownParser::blockEnd(const LineReader &line, qsizetype lineCount, qsizetype first)
+{
+    const QString start = line(first);
+    qsizetype i = first + 1;
+
+    // Indented code, without its trailing blank lines
+    if (indentOf(start) >= 4)
+    {
+        qsizetype end = first + 1;
+        for (; i < lineCount; ++i)
+        {
+            const QString text = line(i);
+            if (isBlank(text))
+                continue;
+            if (indentOf(text) < 4)
+                break;
+            end = i + 1;
+        }
+        return end;
+    }
+
+    if (headingLevel(start) || isThematicBreak(start))
+        return first + 1;
+
+    Fence fence;
+    if (openFence(start, &fence))
+    {
+        for (; i < lineCount; ++i)
+        {
+            if (closesFence(line(i), fence))
+                return i + 1;
+        }
+        return lineCount; // unclosed, runs to the end
+    }
+
+    if (const HtmlBlock kind = htmlBlockKind(start))
+    {
+        if (kind != TagHtml && closesHtmlBlock(start, kind))
+            return first + 1;
+        for (; i < lineCount; ++i)
+        {
+            const QString text = line(i);
+            if (kind == TagHtml && isBlank(text))
+                return i;
+            if (kind != TagHtml && closesHtmlBlock(text, kind))
+                return i + 1;
+        }
+        return lineCount;
+    }
+
+    // Quoted lines, and lazy paragraph continuations
+    if (isQuote(start))
+    {
+        for (; i < lineCount; ++i)
+        {
+            const QString text = line(i);
+            if (isBlank(text) || (!isQuote(text) && interruptsParagraph(text)))
+                break;
+        }
+        return i;
+    }
+
+    ListMarker marker;
+    if (!isThematicBreak(start) && listMarker(start, &marker))
+        return listEnd(line, lineCount, first, marker);
+
+    // Paragraph, an underline turns it into a heading
+    for (; i < lineCount; ++i)
+    {
+        const QString text = line(i);
+        if (isBlank(text))
+            break;
+        if (setextLevel(text))
+            return i + 1;
+        if (interruptsParagraph(text))
+            break;
+    }
+    return i;
+}
+
+// Blocks to HTML
+
+static QString headingHtml(int level, const QString &content)
+{
+    const QString tag = "h" + QString::number(level);
+    return "<" + tag + ">" + content + "</" + tag + ">\n";
+}
+
+static QString listHtml(const QStringList &lines, const ListMarker &list)
+{
+    // Items without their marker and content indentation
+    QList<QStringList> items;
+    int indent = 0;
+    bool loose = false;
+    bool blank = false;
+
+    for (const QString &line : lines)
+    {
+        ListMarker marker;
+
+        if (MarkdownParser::isBlank(line))
+        {
+            items.last().append(QString());
+            blank = true;
+            continue;
+        }
+
+        if (!items.isEmpty() && indentOf(line) >= indent)
+            items.last().append(stripIndent(line, indent));
+        else if (!isThematicBreak(line) && listMarker(line, &marker) && sameList(marker, list))
+        {
+            // Items separated by blank lines make a loose list
+            loose = loose || (blank && !items.isEmpty());
+            indent = marker.contentIndent;
+            const QString content = QString(marker.markerColumn, u' ') + line.mid(marker.end);
+            items.append(QStringList{ stripIndent(content, indent) });
+        }
+        else
+            items.last().append(line.trimmed()); // lazy continuation
+        blank = false;
+    }
+
+    // So do blank lines between the blocks of an item
+    for (QStringList &item : items)
+    {
+        while (!item.isEmpty() && MarkdownParser::isBlank(item.last()))
+            item.removeLast();
+
+        const MarkdownParser::LineReader line = [&item](qsizetype i) { return item.at(i); };
+        for (qsizetype i = 0; i < item.size() && !loose;)
+        {
+            if (MarkdownParser::isBlank(item.at(i)))
+            {
+                ++i;
+                continue;
+            }
+            i = MarkdownParser::blockEnd(line, item.size(), i);
+            loose = i < item.size() && MarkdownParser::isBlank(item.at(i));
+        }
+    }
+
+    QString html;
+    if (!list.ordered)
+        html = "<ul>\n";
+    else if (list.start == 1)
+        html = "<ol>\n";
+    else
+        html = "<ol start=\"" + QString::number(list.start) + "\">\n";
+
+    for (const QStringList &item : items)
+        html += "<li>" + MarkdownParser::toHtml(item, !loose) + "</li>\n";
+
+    html += list.ordered ? "</ol>\n" : "</ul>\n";
+    return html;
+}
+
+static QString blockHtml(const QStringList &lines, bool tight)
+{
+    const QString &first = lines.first();
+
+    if (indentOf(first) >= 4)
+    {
+        QString code;
+        for (const QString &line : lines)
+            code += stripIndent(line, 4) + u'\n';
+        return "<pre><code>" + code.toHtmlEscaped() + "</code></pre>\n";
+    }
+
+    if (const int level = headingLevel(first))
+    {
+        static const QRegularExpression closingSequence(R"re((?:^|[ \t]+)#+[ \t]*$)re");
+        QString text = first.trimmed().mid(level).trimmed();
+        text.remove(closingSequence);
+        return headingHtml(level, MarkdownParser::inlineToHtml(text.trimmed()));
+    }
+
+    if (isThematicBreak(first))
+        return "<hr />\n";
+
+    Fence fence;
+    if (openFence(first, &fence))
+    {
+        const qsizetype end = lines.size() > 1 && closesFence(lines.last(), fence) ? lines.size() - 1 : lines.size();
+        QString code;
+        for (qsizetype i = 1; i < end; ++i)
+            code += stripIndent(lines.at(i), fence.indent) + u'\n';
+
+        const QString language = fence.info.section(u' ', 0, 0);
+        const QString attribute = language.isEmpty() ? QString() : " class=\"language-" + language.toHtmlEscaped() + "\"";
+        return "<pre><code" + attribute + ">" + code.toHtmlEscaped() + "</code></pre>\n";
+    }
+
+    if (htmlBlockKind(first) != NoHtml)
+        return lines.join(u'\n') + u'\n';
+
+    if (isQuote(first))
+    {
+        QStringList content;
+        for (const QString &line : lines)
+        {
+            qsizetype i;
+            if (!isQuote(line))
+            {
+                content.append(line); // lazy continuation
+                continue;
+            }
+            indentOf(line, &i);
+            content.append(stripIndent(line.mid(i + 1), 1));
+        }
+        return "<blockquote>\n" + MarkdownParser::toHtml(content) + "</blockquote>\n";
+    }
+
+    ListMarker marker;
+    if (!isThematicBreak(first) && listMarker(first, &marker))
+        return listHtml(lines, marker);
+
+    // Paragraph, or setext heading
+    QStringList text = lines;
+    const int level = text.size() > 1 ? setextLevel(text.last()) : 0;
+    if (level)
+        text.removeLast();
+
+    for (QString &line : text)
+        line = stripIndent(line, INT_MAX);
+    QString joined = text.join(u'\n');
+    while (joined.endsWith(u' ') || joined.endsWith(u'\t'))
+        joined.chop(1);
+
+    const QString content = MarkdownParser::inlineToHtml(joined);
+    if (level)
+        return headingHtml(level, content);
+    return tight ? content + u'\n' : "<p>" + content + "</p>\n";
+}
+
+QString MarkdownParser::toHtml(const QStringList &lines, bool tight)
+{
+    const LineReader line = [&lines](qsizetype i) { return lines.at(i); };
+
+    QString html;
+    for (qsizetype i = 0; i < lines.size();)
+    {
+        if (isBlank(lines.at(i)))
+        {
+            ++i;
+            continue;
+        }
+
+        const qsizetype end = blockEnd(line, lines.size(), i);
+        html += blockHtml(lines.mid(i, end - i), tight);
+        i = end;
+    }
+    return html;
+}
+
+// Inline content
+
+static bool isPunctuation(QChar c)
+{
+    return c.isPunct() || c.isSymbol();
+}
+
+static bool isAsciiPunctuation(QChar c)
+{
+    return c.unicode() < 128 && isPunctuation(c);
+}
+
+static QString unescaped(const QString &text)
+{
+    QString result;
+    result.reserve(text.size());
+    for (qsizetype i = 0; i < text.size(); ++i)
+    {
+        if (text.at(i) == u'\\' && i + 1 < text.size() && isAsciiPunctuation(text.at(i + 1)))
+            ++i;
+        result += text.at(i);
+    }
+    return result;
+}
+
+// "[label](destination "title")", 'open' being at the '['
+static bool parseLink(const QString &text, qsizetype open, qsizetype *end, QString *label, QString *destination, QString *title)
+{
+    static const QRegularExpression target(R"re(\(\s*(<[^<>\n]*>|(?:[^\s()\\]|\\.|\((?:[^\s()\\]|\\.)*\))*))re"
+                                           R"re((?:\s+("(?:[^"\\]|\\.)*"|'(?:[^'\\]|\\.)*'|\((?:[^()\\]|\\.)*\)))?\s*\))re");
+
+    // Matching bracket, nested ones are part of the label
+    int depth = 0;
+    qsizetype close = open;
+    for (; close < text.size(); ++close)
+    {
+        const QChar c = text.at(close);
+        if (c == u'\\')
+            ++close;
+        else if (c == u'[')
+            ++depth;
+        else if (c == u']' && --depth == 0)
+            break;
+    }
+    if (close + 1 >= text.size() || text.at(close + 1) != u'(')
+        return false;
+
+    const QRegularExpressionMatch match = target.match(text, close + 1, QRegularExpression::NormalMatch,
+                                                       QRegularExpression::AnchorAtOffsetMatchOption);
+    if (!match.hasMatch())
+        return false;
+
+    QString link = match.captured(1);
+    if (link.startsWith(u'<'))
+        link = link.mid(1, link.size() - 2);
+    const QString quoted = match.captured(2);
+
+    *label = text.mid(open + 1, close - open - 1);
+    *destination = unescaped(link);
+    *title = quoted.isEmpty() ? QString() : unescaped(quoted.mid(1, quoted.size() - 2));
+    *end = match.capturedEnd();
+    return true;
+}
+
+QString MarkdownParser::inlineToHtml(const QString &text)
+{
+    static const QRegularExpression autolink(R"re(<([A-Za-z][A-Za-z0-9+.\-]{1,31}:[^\s<>]*)>)re");
+    static const QRegularExpression email(R"re(<([A-Za-z0-9.!#$%&'*+/=?^_`{|}~\-]+@[A-Za-z0-9](?:[A-Za-z0-9\-]{0,61}[A-Za-z0-9])?)re"
+                                          R"re((?:\.[A-Za-z0-9](?:[A-Za-z0-9\-]{0,61}[A-Za-z0-9])?)*)>)re");
+    static const QRegularExpression tag(R"re(<(?:[A-Za-z][A-Za-z0-9\-]*(?:\s+[A-Za-z_:][A-Za-z0-9_.:\-]*)re"
+                                        R"re((?:\s*=\s*(?:[^\s"'=<>`]+|'[^']*'|"[^"]*"))?)*\s*/?|)re"
+                                        R"re(/[A-Za-z][A-Za-z0-9\-]*\s*|!--(?:[^-]|-[^-])*--)>)re");
+    static const QRegularExpression entity(R"re(&(?:#[0-9]{1,7}|#[xX][0-9a-fA-F]{1,6}|[A-Za-z][A-Za-z0-9]{1,31});)re");
+    static const QRegularExpression tags("<[^>]*>");
+
+    const auto matchAt = [&text](const QRegularExpression &regex, qsizetype position) {
+        return regex.match(text, position, QRegularExpression::NormalMatch, QRegularExpression::AnchorAtOffsetMatchOption);
+    };
+
+    // HTML, or a run of '*' or '_' that may still become emphasis
+    struct Node
+    {
+        QString html;
+        QChar delimiter;
+        int count = 0;
+        int length = 0; // of the whole run
+        bool canOpen = false;
+        bool canClose = false;
+        QString openTags;
+        QString closeTags;
+    };
+
+    QList<Node> nodes;
+    QString html; // since the last delimiter run
+    const auto flush = [&nodes, &html]() {
+        Node node;
+        node.html = html;
+        nodes.append(node);
+        html.clear();
+    };
+
+    qsizetype i = 0;
+    while (i < text.size())
+    {
+        const QChar c = text.at(i);
+
+        if (c == u'\\' && i + 1 < text.size() && (isAsciiPunctuation(text.at(i + 1)) || text.at(i + 1) == u'\n'))
+        {
+            html += text.at(i + 1) == u'\n' ? QString("<br />\n") : QString(text.at(i + 1)).toHtmlEscaped();
+            i += 2;
+        }
+        else if (c == u'`')
+        {
+            qsizetype run = 1;
+            while (i + run < text.size() && text.at(i + run) == u'`')
+                ++run;
+
+            // Code span up to a run of the same length
+            qsizetype close = i + run;
+            while ((close = text.indexOf(QString(run, u'`'), close)) >= 0)
+            {
+                qsizetype closeRun = 0;
+                while (close + closeRun < text.size() && text.at(close + closeRun) == u'`')
+                    ++closeRun;
+                if (closeRun == run)
+                    break;
+                close += closeRun;
+            }
+
+            if (close < 0)
+            {
+                html += QString(run, u'`');
+                i += run;
+                continue;
+            }
+
+            QString code = text.mid(i + run, close - i - run);
+            code.replace(u'\n', u' ');
+            if (code.size() >= 2 && code.startsWith(u' ') && code.endsWith(u' ') && !isBlank(code))
+                code = code.mid(1, code.size() - 2);
+            html += "<code>" + code.toHtmlEscaped() + "</code>";
+            i = close + run;
+        }
+        else if (c == u'*' || c == u'_')
+        {
+            qsizetype run = 1;
+            while (i + run < text.size() && text.at(i + run) == c)
+                ++run;
+
+            // Flanking rules: whether the run can open and/or close emphasis
+            const QChar before = i > 0 ? text.at(i - 1) : QChar(u' ');
+            const QChar after = i + run < text.size() ? text.at(i + run) : QChar(u' ');
+            const bool leftFlanking = !after.isSpace() && (!isPunctuation(after) || before.isSpace() || isPunctuation(before));
+            const bool rightFlanking = !before.isSpace() && (!isPunctuation(before) || after.isSpace() || isPunctuation(after));
+
+            Node node;
+            node.delimiter = c;
+            node.count = node.length = int(run);
+            node.canOpen = c == u'*' ? leftFlanking : leftFlanking && (!rightFlanking || isPunctuation(before));
+            node.canClose = c == u'*' ? rightFlanking : rightFlanking && (!leftFlanking || isPunctuation(after));
+
+            flush();
+            nodes.append(node);
+            i += run;
+        }
+        else if (c == u'[' || (c == u'!' && i + 1 < text.size() && text.at(i + 1) == u'['))
+        {
+            const bool image = c == u'!';
+            qsizetype end;
+            QString label, destination, title;
+            if (!parseLink(text, image ? i + 1 : i, &end, &label, &destination, &title))
+            {
+                html += c;
+                ++i;
+                continue;
+            }
+
+            const QString titleAttribute = title.isEmpty() ? QString() : " title=\"" + title.toHtmlEscaped() + "\"";
+            if (image)
+                html += "<img src=\"" + destination.toHtmlEscaped() + "\" alt=\"" + inlineToHtml(label).remove(tags) + "\""
+                        + titleAttribute + " />";
+            else
+                html += "<a href=\"" + destination.toHtmlEscaped() + "\"" + titleAttribute + ">" + inlineToHtml(label) + "</a>";
+            i = end;
+        }
+        else if (c == u'<')
+        {
+            QRegularExpressionMatch match = matchAt(autolink, i);
+            if (match.hasMatch())
+            {
+                const QString url = match.captured(1).toHtmlEscaped();
+                html += "<a href=\"" + url + "\">" + url + "</a>";
+            }
+            else if ((match = matchAt(email, i)).hasMatch())
+            {
+                const QString address = match.captured(1).toHtmlEscaped();
+                html += "<a href=\"mailto:" + address + "\">" + address + "</a>";
+            }
+            else if ((match = matchAt(tag, i)).hasMatch())
+                html += match.captured(); // raw HTML
+
+            if (match.hasMatch())
+                i = match.capturedEnd();
+            else
+            {
+                html += "&lt;";
+                ++i;
+            }
+        }
+        else if (c == u'&')
+        {
+            // Entities are kept, other ampersands escaped
+            const QRegularExpressionMatch match = matchAt(entity, i);
+            html += match.hasMatch() ? match.captured() : QString("&amp;");
+            i = match.hasMatch() ? match.capturedEnd() : i + 1;
+        }
+        else if (c == u'\n')
+        {
+            // Two trailing spaces make a hard break
+            int spaces = 0;
+            for (; html.endsWith(u' '); ++spaces)
+                html.chop(1);
+            html += spaces >= 2 ? "<br />\n" : "\n";
+
+            for (++i; i < text.size() && (text.at(i) == u' ' || text.at(i) == u'\t'); ++i)
+                ;
+        }
+        else
+        {
+            if (c == u'>')
+                html += "&gt;";
+            else if (c == u'"')
+                html += "&quot;";
+            else
+                html += c;
+            ++i;
+        }
+    }
+    flush();
+
+    // Each closer takes the nearest opener of the same kind, strong first
+    for (qsizetype closer = 0; closer < nodes.size(); ++closer)
+    {
+        if (!nodes.at(closer).canClose)
+            continue;
+
+        while (nodes.at(closer).count > 0)
+        {
+            const Node &current = nodes.at(closer);
+            qsizetype opener = closer - 1;
+            for (; opener >= 0; --opener)
+            {
+                const Node &candidate = nodes.at(opener);
+                const int sum = candidate.length + current.length;
+                // The rule of three, for runs that can both open and close
+                const bool ruleOfThree = (candidate.canClose || current.canOpen) && sum % 3 == 0
+                                         && (candidate.length % 3 != 0 || current.length % 3 != 0);
+                if (candidate.count > 0 && candidate.canOpen && candidate.delimiter == current.delimiter && !ruleOfThree)
+                    break;
+            }
+            if (opener < 0)
+                break;
+
+            const int use = nodes.at(opener).count >= 2 && nodes.at(closer).count >= 2 ? 2 : 1;
+            nodes[opener].count -= use;
+            nodes[opener].openTags.prepend(use == 2 ? "<strong>" : "<em>");
+            nodes[closer].count -= use;
+            nodes[closer].closeTags.append(use == 2 ? "</strong>" : "</em>");
+
+            // Runs in between stay literal
+            for (qsizetype k = opener + 1; k < closer; ++k)
+                nodes[k].canOpen = nodes[k].canClose = false;
+        }
+    }
+
+    QString result;
+    for (const Node &node : nodes)
+        result += node.closeTags + node.html + QString(node.count, node.delimiter) + node.openTags;
+    return result;
+}
@@ -0,0 +1,33 @@
+#ifndef MARKDOWNPARSER_H
+#define MARKDOWNPARSER_H
+
+#include <QString>
+#include <QStringList>
+#include <functional>
+
+// CommonMark-style Markdown to HTML: ATX and setext headings, paragraphs,
+// fenced and indented code, block quotes, nested lists, thematic breaks,
+// HTML blocks, and inline code, emphasis, links, images, autolinks, raw
+// HTML, escapes and hard breaks. Link reference definitions aren't resolved.
+//
+// A document is a sequence of top-level blocks. Where a block ends only
+// depends on its own lines and on the next non-blank one, so a document can
+// be split and converted one block at a time.
+class MarkdownParser
+{
+public:
+    using LineReader = std::function<QString(qsizetype line)>;
+
+    static bool isBlank(const QString &line);
+
+    // Line after the end of the block starting at 'first', a non-blank line
+    static qsizetype blockEnd(const LineReader &line, qsizetype lineCount, qsizetype first);
+
+    // HTML of the blocks in 'lines'. Paragraphs of tight lists aren't wrapped.
+    static QString toHtml(const QStringList &lines, bool tight = false);
+
+    // HTML of the inline content of a paragraph or heading
+    static QString inlineToHtml(const QString &text);
+};
+
+#endif // MARKDOWNPARSER_H
@@ -0,0 +1,236 @@
+#include "MarkdownPreview.h"
+#include <QElapsedTimer>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <QTextCursor>
+#include <QAbstractTextDocumentLayout>
+
+// Typing pause before converting again
+static const int DebounceMs = 300;
+// Preview blocks replaced per step, and time spent per event loop iteration
+static const qsizetype BlocksPerStep = 32;
+static const qint64 SliceMs = 10;
+
+MarkdownPreview::MarkdownPreview(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent)
+    : QTextBrowser(parent), textEditor(textEdit), textBuffer(buffer), dirty(false), fullConversion(false),
+      dirtyFirst(0), dirtyLast(0), lineDelta(0), lineCount(buffer->table().lineCount()), textLength(buffer->length())
+{
+    setOpenExternalLinks(true);
+
+    converter = new MarkdownConverter(this);
+    connect(converter, &MarkdownConverter::blocksChanged, this, &MarkdownPreview::queueBlocks);
+    connect(converter, &MarkdownConverter::finished, this, &MarkdownPreview::conversionFinished);
+
+    debounceTimer = new QTimer(this);
+    debounceTimer->setSingleShot(true);
+    debounceTimer->setInterval(DebounceMs);
+    connect(debounceTimer, &QTimer::timeout, this, &MarkdownPreview::startConversion);
+
+    applyTimer = new QTimer(this);
+    applyTimer->setSingleShot(true);
+    applyTimer->setInterval(0);
+    connect(applyTimer, &QTimer::timeout, this, &MarkdownPreview::applyQueuedBlocks);
+
+    connect(textBuffer, &TextBuffer::edited, this, &MarkdownPreview::documentEdited);
+    connect(textBuffer, &TextBuffer::batchEdited, this, &MarkdownPreview::documentEdited);
+    connect(textEditor->verticalScrollBar(), &QScrollBar::valueChanged, this, &MarkdownPreview::syncScroll);
+
+    converter->convert(textBuffer->snapshot());
+}
+
+void MarkdownPreview::documentEdited(qsizetype position, qsizetype removed, qsizetype added)
+{
+    // The lines of several carets' edits are converted again together
+    if (textBuffer->isBatching())
+        return;
+
+    const PieceTable &text = textBuffer->table();
+
+    // The whole text replaced (file loaded)
+    if (position == 0 && removed == textLength)
+        fullConversion = true;
+    else
+    {
+        // Lines [first, last - delta] became [first, last]
+        const qsizetype first = text.lineAt(position);
+        const qsizetype last = text.lineAt(position + added);
+        const qsizetype delta = text.lineCount() - lineCount;
+        const qsizetype previousLast = last - delta;
+
+        if (!dirty)
+        {
+            dirtyFirst = first;
+            dirtyLast = last;
+            lineDelta = delta;
+        }
+        else
+        {
+            // Lines changed before move with this edit
+            const qsizetype from = dirtyFirst < first ? dirtyFirst : (dirtyFirst > previousLast ? dirtyFirst + delta : first);
+            const qsizetype to = dirtyLast < first ? dirtyLast : (dirtyLast > previousLast ? dirtyLast + delta : last);
+            dirtyFirst = qMin(from, first);
+            dirtyLast = qMax(to, last);
+            lineDelta += delta;
+        }
+    }
+
+    dirty = true;
+    lineCount = text.lineCount();
+    textLength = text.length();
+    debounceTimer->start();
+}
+
+void MarkdownPreview::startConversion()
+{
+    // The next one starts from the blocks of the running one
+    if (!dirty || converter->isRunning())
+        return;
+
+    if (fullConversion)
+        converter->convert(textBuffer->snapshot());
+    else
+        converter->update(textBuffer->snapshot(), dirtyFirst, dirtyLast, lineDelta);
+
+    dirty = false;
+    fullConversion = false;
+}
+
+void MarkdownPreview::conversionFinished()
+{
+    if (!debounceTimer->isActive())
+        startConversion();
+}
+
+void MarkdownPreview::queueBlocks(qsizetype first, qsizetype removed, const QStringList &html)
+{
+    queuedChanges.append(Change{ first, removed, html });
+    applyTimer->start();
+}
+
+void MarkdownPreview::applyQueuedBlocks()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    // Large changes (a whole file) go in steps so typing isn't held up
+    while (!queuedChanges.isEmpty() && timer.elapsed() < SliceMs)
+    {
+        Change &change = queuedChanges.first();
+        const QStringList step = change.html.first(qMin(BlocksPerStep, change.html.size()));
+        replaceBlocks(change.first, change.removed, step);
+
+        change.first += step.size();
+        change.removed = 0;
+        change.html.remove(0, step.size());
+        if (change.html.isEmpty())
+            queuedChanges.removeFirst();
+    }
+
+    if (!queuedChanges.isEmpty())
+        applyTimer->start();
+    syncScroll();
+}
+
+void MarkdownPreview::replaceBlocks(qsizetype first, qsizetype removed, const QStringList &html)
+{
+    QTextDocument *preview = document();
+
+    // Preview paragraphs of the blocks before and of the replaced ones
+    int start = 0;
+    for (qsizetype i = 0; i < first; ++i)
+        start += blockSpans.at(i);
+    int count = 0;
+    for (qsizetype i = first; i < first + removed; ++i)
+        count += blockSpans.at(i);
+    blockSpans.remove(first, removed);
+
+    QTextCursor cursor(preview);
+    cursor.beginEditBlock();
+
+    if (count > 0)
+    {
+        const QTextBlock firstBlock = preview->findBlockByNumber(start);
+        const QTextBlock lastBlock = preview->findBlockByNumber(start + count - 1);
+        cursor.setPosition(firstBlock.position());
+        cursor.setPosition(lastBlock.position() + lastBlock.length() - 1, QTextCursor::KeepAnchor);
+        cursor.removeSelectedText();
+
+        if (html.isEmpty())
+        {
+            // Drop the emptied paragraph too, keeping the format of the next one
+            if (start > 0)
+                cursor.deletePreviousChar();
+            else if (cursor.block().next().isValid())
+            {
+                const QTextBlockFormat format = cursor.block().next().blockFormat();
+                cursor.deleteChar();
+                cursor.setBlockFormat(format);
+            }
+            cursor.endEditBlock();
+            return;
+        }
+        cursor.setBlockFormat(QTextBlockFormat());
+        cursor.setBlockCharFormat(QTextCharFormat());
+    }
+    else if (html.isEmpty())
+    {
+        cursor.endEditBlock();
+        return;
+    }
+    else if (blockSpans.isEmpty())
+    {
+        // Only the empty paragraph of an empty document
+        cursor.select(QTextCursor::Document);
+        cursor.removeSelectedText();
+        cursor.setBlockFormat(QTextBlockFormat());
+        cursor.setBlockCharFormat(QTextCharFormat());
+    }
+    else if (first < blockSpans.size())
+    {
+        // A new paragraph before the block at 'first', which keeps its format
+        const QTextBlock next = preview->findBlockByNumber(start);
+        const QTextBlockFormat format = next.blockFormat();
+        cursor.setPosition(next.position());
+        cursor.insertBlock(format);
+        cursor.movePosition(QTextCursor::PreviousBlock);
+        cursor.setBlockFormat(QTextBlockFormat());
+        cursor.setBlockCharFormat(QTextCharFormat());
+    }
+    else
+    {
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+    }
+
+    // Each block fills the paragraph at the cursor and the ones it adds
+    for (qsizetype i = 0; i < html.size(); ++i)
+    {
+        if (i > 0)
+            cursor.insertBlock(QTextBlockFormat(), QTextCharFormat());
+
+        const int before = preview->blockCount();
+        cursor.insertHtml(html.at(i));
+        blockSpans.insert(first + i, preview->blockCount() - before + 1);
+    }
+
+    cursor.endEditBlock();
+}
+
+void MarkdownPreview::syncScroll()
+{
+    // Show the block of the top line of the editor at the top
+    const qsizetype line = textEditor->cursorForPosition(QPoint(0, 0)).blockNumber();
+    const qsizetype index = qMin(converter->blockAt(line), blockSpans.size() - 1);
+    if (index < 0)
+    {
+        verticalScrollBar()->setValue(0);
+        return;
+    }
+
+    int paragraph = 0;
+    for (qsizetype i = 0; i < index; ++i)
+        paragraph += blockSpans.at(i);
+
+    const QTextBlock block = document()->findBlockByNumber(paragraph);
+    verticalScrollBar()->setValue(int(document()->documentLayout()->blockBoundingRect(block).top()));
+}
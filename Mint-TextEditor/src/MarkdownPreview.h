@@ -0,0 +1,59 @@
+#ifndef MARKDOWNPREVIEW_H
+#define MARKDOWNPREVIEW_H
+
+#include <QTextBrowser>
+#include <QPlainTextEdit>
+#include <QTimer>
+
+#include "TextBuffer.h"
+#include "MarkdownConverter.h"
+
+// Live HTML preview of a Markdown editor. Edits are collected as a range of
+// changed lines and converted once typing pauses; the blocks whose HTML
+// changed are then replaced in the preview document, a few at a time from
+// the event loop, instead of rendering the whole page again.
+class MarkdownPreview : public QTextBrowser
+{
+    Q_OBJECT
+
+public:
+    MarkdownPreview(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent = nullptr);
+
+private slots:
+    void documentEdited(qsizetype position, qsizetype removed, qsizetype added);
+    void startConversion();
+    void conversionFinished();
+    void queueBlocks(qsizetype first, qsizetype removed, const QStringList &html);
+    void applyQueuedBlocks();
+    void syncScroll();
+
+private:
+    struct Change
+    {
+        qsizetype first;
+        qsizetype removed;
+        QStringList html;
+    };
+
+    void replaceBlocks(qsizetype first, qsizetype removed, const QStringList &html);
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    MarkdownConverter *converter;
+    QTimer *debounceTimer;
+    QTimer *applyTimer;
+    QList<Change> queuedChanges;
+    QList<int> blockSpans; // preview paragraphs of each Markdown block
+
+    // Lines changed since the last conversion, in the current numbering
+    bool dirty;
+    bool fullConversion;
+    qsizetype dirtyFirst;
+    qsizetype dirtyLast;
+    qsizetype lineDelta;
+    // Text at the last edit
+    qsizetype lineCount;
+    qsizetype textLength;
+};
+
+#endif // MARKDOWNPREVIEW_H
@@ -0,0 +1,342 @@
+#include "Minimap.h"
+#include <QApplication>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QTextBlock>
+#include <algorithm>
+
+static const int MinimapWidth = 90;
+static const int TileRows = 64;
+// A row standing for many lines shows a few of them, evenly spread
+static const int SampledLines = 4;
+static const int TabColumns = 4;
+static const int RenderDelayMs = 100;
+static const QColor ModifiedColor("#3EB489");
+static const QColor HitColor("#FFDC34");
+static const QColor ViewportColor(128, 128, 128, 60);
+
+namespace
+{
+QRgb blend(QRgb from, QRgb to, int alpha)
+{
+    return qRgb(qRed(from) + (qRed(to) - qRed(from)) * alpha / 255, qGreen(from) + (qGreen(to) - qGreen(from)) * alpha / 255,
+                qBlue(from) + (qBlue(to) - qBlue(from)) * alpha / 255);
+}
+
+// The rows of one tile, a pixel a character column
+QImage renderTile(const TextSnapshot &text, int tile, qsizetype linesPerRow, int rowHeight, QRgb background, QRgb foreground)
+{
+    QImage image(MinimapWidth, TileRows * rowHeight, QImage::Format_RGB32);
+    image.fill(background);
+    QList<int> density(MinimapWidth);
+    const qsizetype lines = text.lineCount();
+
+    for (int row = 0; row < TileRows; ++row)
+    {
+        const qsizetype first = (qsizetype(tile) * TileRows + row) * linesPerRow;
+        if (first >= lines)
+            break;
+        const qsizetype last = qMin(lines, first + linesPerRow);
+        const qsizetype step = qMax(qsizetype(1), (last - first) / SampledLines);
+
+        density.fill(0);
+        int samples = 0;
+        for (qsizetype line = first; line < last && samples < SampledLines; line += step, ++samples)
+        {
+            const qsizetype start = text.lineStart(line);
+            const qsizetype end = line + 1 < lines ? text.lineStart(line + 1) - 1 : text.length();
+            const QString characters = text.text(start, qMin(end - start, qsizetype(MinimapWidth)));
+            int column = 0;
+            for (QChar c : characters)
+            {
+                if (c == u'\t')
+                {
+                    column += TabColumns - column % TabColumns;
+                    continue;
+                }
+                if (column >= MinimapWidth)
+                    break;
+                if (!c.isSpace())
+                    density[column]++;
+                ++column;
+            }
+        }
+
+        QRgb *pixels = reinterpret_cast<QRgb *>(image.scanLine(row * rowHeight));
+        for (int x = 0; x < MinimapWidth; ++x)
+        {
+            if (density.at(x) > 0)
+                pixels[x] = blend(background, foreground, 80 + 175 * density.at(x) / samples);
+        }
+    }
+    return image;
+}
+}
+
+Minimap::Minimap(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent)
+    : QWidget(parent), textEditor(textEdit), textBuffer(buffer), linesPerRow(1), rowHeight(2), knownLines(0), generation(0)
+{
+    setFixedWidth(MinimapWidth);
+    setCursor(Qt::PointingHandCursor);
+    pool.setMaxThreadCount(1);
+
+    renderTimer = new QTimer(this);
+    renderTimer->setSingleShot(true);
+    renderTimer->setInterval(RenderDelayMs);
+    connect(renderTimer, &QTimer::timeout, this, &Minimap::startRendering);
+
+    connect(textBuffer, &TextBuffer::edited, this, &Minimap::documentEdited);
+    connect(textBuffer, &TextBuffer::batchEdited, this, &Minimap::documentEdited);
+    connect(textEditor->verticalScrollBar(), &QScrollBar::valueChanged, this, qOverload<>(&QWidget::update));
+
+    knownLines = textBuffer->table().lineCount();
+    updateScale();
+    invalidateAll();
+}
+
+Minimap::~Minimap()
+{
+    generation.fetchAndAddOrdered(1);
+    pool.waitForDone();
+}
+
+bool Minimap::updateScale()
+{
+    // Two pixels a line while the document fits, else as many lines a row as needed
+    const qsizetype lines = textBuffer->table().lineCount();
+    const int available = qMax(1, height());
+    qsizetype perRow = 1;
+    int rowPixels = 1;
+    if (lines * 2 <= available)
+        rowPixels = 2;
+    else if (lines > available)
+        perRow = (lines + available - 1) / available;
+
+    const qsizetype rows = (lines + perRow - 1) / perRow;
+    const qsizetype tileCount = (rows + TileRows - 1) / TileRows;
+    const bool changed = perRow != linesPerRow || rowPixels != rowHeight;
+    linesPerRow = perRow;
+    rowHeight = rowPixels;
+
+    if (changed)
+        tiles = QList<QImage>(tileCount);
+    else
+    {
+        for (qsizetype tile = tiles.size(); tile < tileCount; ++tile)
+            dirtyTiles.insert(int(tile));
+        tiles.resize(tileCount);
+        dirtyTiles.removeIf([tileCount](int tile) { return tile >= tileCount; });
+    }
+    return changed;
+}
+
+void Minimap::invalidateAll()
+{
+    generation.fetchAndAddOrdered(1);
+    dirtyTiles.clear();
+    for (qsizetype tile = 0; tile < tiles.size(); ++tile)
+        dirtyTiles.insert(int(tile));
+    renderTimer->start();
+}
+
+void Minimap::invalidateLines(qsizetype first, qsizetype last)
+{
+    generation.fetchAndAddOrdered(1);
+    const qsizetype rowLines = linesPerRow * TileRows;
+    const qsizetype lastTile = qMin(last / rowLines, tiles.size() - 1);
+    for (qsizetype tile = first / rowLines; tile <= lastTile; ++tile)
+        dirtyTiles.insert(int(tile));
+    renderTimer->start();
+}
+
+void Minimap::documentEdited(qsizetype position, qsizetype removed, qsizetype added)
+{
+    // The edits of several carets are marked and drawn again as one range
+    if (textBuffer->isBatching())
+        return;
+
+    markModified(position, removed, added);
+
+    const TextSnapshot &text = textBuffer->table();
+    const bool linesMoved = text.lineCount() != knownLines;
+    knownLines = text.lineCount();
+
+    if (updateScale())
+        invalidateAll();
+    else
+        invalidateLines(text.lineAt(position), linesMoved ? knownLines : text.lineAt(position + added));
+
+    // Hits are the find dialog's, it sends them again
+    update();
+}
+
+void Minimap::markModified(qsizetype position, qsizetype removed, qsizetype added)
+{
+    // Ranges after the edit move with it, the ones it touches join it
+    const qsizetype delta = added - removed;
+    const qsizetype removedEnd = position + removed;
+    Range edited{ position, position + qMax(added, qsizetype(1)) }; // a deletion marks where it was
+    QList<Range> ranges;
+    ranges.reserve(modifiedRanges.size() + 1);
+    bool placed = false;
+
+    for (const Range &range : std::as_const(modifiedRanges))
+    {
+        if (range.end < position)
+            ranges.append(range);
+        else if (range.start > removedEnd)
+        {
+            if (!placed)
+            {
+                ranges.append(edited);
+                placed = true;
+            }
+            ranges.append(Range{ range.start + delta, range.end + delta });
+        }
+        else
+        {
+            edited.start = qMin(edited.start, range.start);
+            edited.end = qMax(edited.end, range.end > removedEnd ? range.end + delta : position + added);
+        }
+    }
+    if (!placed)
+        ranges.append(edited);
+    modifiedRanges = ranges;
+}
+
+void Minimap::clearModified()
+{
+    modifiedRanges.clear();
+    update();
+}
+
+void Minimap::setSearchHits(const QList<qsizetype> &positions)
+{
+    const TextSnapshot &text = textBuffer->table();
+    hitLines.clear();
+    for (qsizetype position : positions)
+    {
+        const qsizetype line = text.lineAt(qMin(position, text.length()));
+        if (hitLines.isEmpty() || hitLines.last() != line)
+            hitLines.append(line);
+    }
+    update();
+}
+
+void Minimap::startRendering()
+{
+    if (dirtyTiles.isEmpty() || !isVisible())
+        return;
+
+    // Tiles in order, the ones in the results of a newer edit are thrown away
+    QList<int> order(dirtyTiles.begin(), dirtyTiles.end());
+    std::sort(order.begin(), order.end());
+    const quint64 id = generation.fetchAndAddOrdered(1) + 1;
+    const TextSnapshot text = textBuffer->snapshot();
+    const qsizetype perRow = linesPerRow;
+    const int pixels = rowHeight;
+    const QRgb background = textEditor->palette().color(QPalette::Base).rgb();
+    const QRgb foreground = textEditor->palette().color(QPalette::Text).rgb();
+
+    pool.start([this, id, order, text, perRow, pixels, background, foreground]() {
+        for (int tile : order)
+        {
+            if (generation.loadRelaxed() != id)
+                return;
+            const QImage image = renderTile(text, tile, perRow, pixels, background, foreground);
+            QMetaObject::invokeMethod(this, [this, id, tile, image]() { tileRendered(id, tile, image); }, Qt::QueuedConnection);
+        }
+    });
+}
+
+void Minimap::tileRendered(quint64 id, int tile, const QImage &image)
+{
+    if (generation.loadRelaxed() != id || tile >= tiles.size())
+        return;
+
+    tiles[tile] = image;
+    dirtyTiles.remove(tile);
+    const int tileHeight = TileRows * rowHeight;
+    update(0, tile * tileHeight, width(), tileHeight);
+}
+
+void Minimap::paintEvent(QPaintEvent *event)
+{
+    QPainter painter(this);
+    painter.fillRect(event->rect(), textEditor->palette().color(QPalette::Base));
+
+    // Cached tiles, a stale one stays until its new rendering comes
+    const int tileHeight = TileRows * rowHeight;
+    for (qsizetype tile = event->rect().top() / tileHeight; tile < tiles.size(); ++tile)
+    {
+        if (tile * tileHeight > event->rect().bottom())
+            break;
+        if (!tiles.at(tile).isNull())
+            painter.drawImage(0, int(tile * tileHeight), tiles.at(tile));
+    }
+
+    // Modified lines on the left edge, search hits on the right one
+    const TextSnapshot &text = textBuffer->table();
+    const int markHeight = qMax(rowHeight, 2);
+    for (const Range &range : std::as_const(modifiedRanges))
+    {
+        const int top = yForLine(text.lineAt(qMin(range.start, text.length())));
+        const int bottom = yForLine(text.lineAt(qMin(range.end, text.length())));
+        painter.fillRect(0, top, 3, bottom - top + markHeight, ModifiedColor);
+    }
+    int lastHit = -1;
+    for (qsizetype line : std::as_const(hitLines))
+    {
+        const int y = yForLine(line);
+        if (y == lastHit)
+            continue;
+        painter.fillRect(width() - 5, y, 5, markHeight, HitColor);
+        lastHit = y;
+    }
+
+    // What the editor shows
+    const qsizetype firstVisible = textEditor->firstVisibleBlock().blockNumber();
+    const qsizetype lastVisible = textEditor->cursorForPosition(textEditor->viewport()->rect().bottomLeft()).blockNumber();
+    const int top = yForLine(firstVisible);
+    painter.fillRect(0, top, width(), yForLine(lastVisible) - top + rowHeight, ViewportColor);
+}
+
+void Minimap::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    if (updateScale())
+        invalidateAll();
+}
+
+void Minimap::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    renderTimer->start(); // nothing is rendered while hidden
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton)
+        scrollTo(event->position().toPoint().y());
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event)
+{
+    if (event->buttons() & Qt::LeftButton)
+        scrollTo(event->position().toPoint().y());
+}
+
+void Minimap::wheelEvent(QWheelEvent *event)
+{
+    QApplication::sendEvent(textEditor->verticalScrollBar(), event);
+}
+
+void Minimap::scrollTo(int y)
+{
+    // The line under the mouse goes to the middle of the editor
+    const qsizetype line = qsizetype(qMax(y, 0) / rowHeight) * linesPerRow;
+    const qsizetype firstVisible = textEditor->firstVisibleBlock().blockNumber();
+    const qsizetype lastVisible = textEditor->cursorForPosition(textEditor->viewport()->rect().bottomLeft()).blockNumber();
+    textEditor->verticalScrollBar()->setValue(int(line - (lastVisible - firstVisible) / 2));
+}
@@ -0,0 +1,77 @@
+#ifndef MINIMAP_H
+#define MINIMAP_H
+
+#include <QWidget>
+#include <QPlainTextEdit>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QTimer>
+#include <QImage>
+#include <QSet>
+
+#include "TextBuffer.h"
+
+// Overview of the whole document beside its editor: a pixel row per line,
+// or per group of lines in a long document, drawn as the density of the
+// characters. The rows are rendered by tiles on a worker thread from a
+// snapshot of the buffer and cached; an edit only marks the tiles of the
+// lines it touched (and the ones after, when lines come or go) to be
+// rendered again once typing pauses. Lines modified since the last save
+// and search hits are marked, and clicking or dragging scrolls the editor.
+class Minimap : public QWidget
+{
+    Q_OBJECT
+
+public:
+    Minimap(QPlainTextEdit *textEdit, TextBuffer *buffer, QWidget *parent = nullptr);
+    ~Minimap();
+
+    void setSearchHits(const QList<qsizetype> &positions);
+    void clearModified(); // the document is the file's text again
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+private slots:
+    void documentEdited(qsizetype position, qsizetype removed, qsizetype added);
+    void startRendering();
+
+private:
+    struct Range
+    {
+        qsizetype start;
+        qsizetype end;
+    };
+
+    bool updateScale(); // true if it changed, every tile is then out of date
+    void invalidateLines(qsizetype first, qsizetype last);
+    void invalidateAll();
+    void markModified(qsizetype position, qsizetype removed, qsizetype added);
+    void tileRendered(quint64 id, int tile, const QImage &image);
+    void scrollTo(int y);
+    int yForLine(qsizetype line) const { return int(line / linesPerRow) * rowHeight; }
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    QTimer *renderTimer;
+
+    // Scale: lines of a pixel row, and its height
+    qsizetype linesPerRow;
+    int rowHeight;
+    qsizetype knownLines;
+
+    QList<QImage> tiles; // null until rendered
+    QSet<int> dirtyTiles;
+    QThreadPool pool;
+    QAtomicInteger<quint64> generation;
+
+    QList<Range> modifiedRanges; // sorted, in characters
+    QList<qsizetype> hitLines; // sorted
+};
+
+#endif // MINIMAP_H
@@ -0,0 +1,417 @@
+#include "PieceTable.h"
+#include "LineIndex.h"
+#include <QSet>
+#include <algorithm>
+#include <cstring>
+
+// Capacity of each add buffer chunk. Big insertions (pastes) get a chunk of
+// their own with a newline index, so add buffer scans stay short.
+static const qsizetype AddChunkCapacity = 64 * 1024;
+static const qsizetype OwnChunkThreshold = AddChunkCapacity / 4;
+
+/* --------------- *
+ *   TEXT CHUNKS   *
+ * --------------- */
+TextChunk::TextChunk(const QString &text)
+    : storage(text), latin1Data(nullptr), utf16Data(storage.constData()),
+      used(storage.size()), capacity(storage.size()), indexed(true)
+{
+    LineIndex::findNewlines(utf16Data, used, 0, newlines);
+    hashes.append(utf16Data, used);
+}
+
+TextChunk::TextChunk(QString text, QList<qsizetype> newlines, const TextHash::Sampler &hashes)
+    : storage(std::move(text)), latin1Data(nullptr), utf16Data(storage.constData()),
+      used(storage.size()), capacity(storage.size()), newlines(std::move(newlines)), indexed(true), hashes(hashes)
+{
+}
+
+TextChunk::TextChunk(QByteArray latin1Text, QList<qsizetype> newlines, const TextHash::Sampler &hashes)
+    : latin1Storage(std::move(latin1Text)), latin1Data(latin1Storage.constData()), utf16Data(nullptr),
+      used(latin1Storage.size()), capacity(latin1Storage.size()), newlines(std::move(newlines)), indexed(true), hashes(hashes)
+{
+}
+
+TextChunk::TextChunk(qsizetype reserved)
+    : latin1Data(nullptr), used(0), capacity(reserved), indexed(false)
+{
+    // Allocated once and never reallocated, so pointers into it stay valid
+    storage.resize(reserved);
+    utf16Data = storage.constData();
+    hashes.reserve(reserved);
+}
+
+qsizetype TextChunk::append(QStringView text)
+{
+    Q_ASSERT(text.size() <= available());
+
+    const qsizetype offset = used;
+    std::memcpy(const_cast<QChar *>(utf16Data) + offset, text.data(), size_t(text.size()) * sizeof(QChar));
+    used += text.size();
+    hashes.append(text.data(), text.size());
+    return offset;
+}
+
+qint64 TextChunk::memoryUsed() const
+{
+    return qint64(latin1Storage.capacity()) + qint64(storage.capacity()) * 2
+           + qint64(newlines.capacity()) * qint64(sizeof(qsizetype))
+           + qint64(hashes.prefixes().capacity()) * qint64(sizeof(quint64));
+}
+
+qsizetype TextChunk::countNewlines(qsizetype start, qsizetype length) const
+{
+    if (indexed)
+    {
+        const auto first = std::lower_bound(newlines.cbegin(), newlines.cend(), start);
+        return std::lower_bound(first, newlines.cend(), start + length) - first;
+    }
+
+    return isLatin1() ? LineIndex::countNewlines(latin1Data + start, length)
+                      : LineIndex::countNewlines(utf16Data + start, length);
+}
+
+qsizetype TextChunk::findNthNewline(qsizetype start, qsizetype length, qsizetype n) const
+{
+    if (indexed)
+    {
+        const qsizetype first = std::lower_bound(newlines.cbegin(), newlines.cend(), start) - newlines.cbegin();
+        if (first + n >= newlines.size() || newlines.at(first + n) >= start + length)
+            return -1;
+        return newlines.at(first + n) - start;
+    }
+
+    return isLatin1() ? LineIndex::findNthNewline(latin1Data + start, length, n)
+                      : LineIndex::findNthNewline(utf16Data + start, length, n);
+}
+
+quint64 TextChunk::hash(qsizetype start, qsizetype length, quint64 lengthPower) const
+{
+    return TextHash::difference(prefixHash(start + length), prefixHash(start), lengthPower);
+}
+
+quint64 TextChunk::prefixHash(qsizetype end) const
+{
+    // Nearest sample, then at most SampleInterval - 1 characters
+    const qsizetype sample = end / TextHash::SampleInterval;
+    const qsizetype from = sample * TextHash::SampleInterval;
+    const quint64 hash = hashes.prefixes().at(sample);
+    return isLatin1() ? TextHash::extend(hash, latin1Data + from, end - from)
+                      : TextHash::extend(hash, utf16Data + from, end - from);
+}
+
+void TextSpan::appendTo(QString &out) const
+{
+    if (latin1)
+        out.append(QLatin1String(latin1, length));
+    else
+        out.append(QStringView(utf16, length));
+}
+
+/* --------------- *
+ *    SNAPSHOTS    *
+ * --------------- */
+QChar TextSnapshot::at(qsizetype position) const
+{
+    const PieceNode *node = root.data();
+
+    while (node)
+    {
+        const qsizetype leftLength = node->left ? node->left->totalLength : 0;
+        if (position < leftLength)
+            node = node->left.data();
+        else if (position < leftLength + node->length)
+        {
+            const TextChunk *chunk = node->chunk.data();
+            const qsizetype offset = node->start + position - leftLength;
+            return chunk->isLatin1() ? QChar(uchar(chunk->latin1()[offset])) : chunk->utf16()[offset];
+        }
+        else
+        {
+            position -= leftLength + node->length;
+            node = node->right.data();
+        }
+    }
+
+    return QChar();
+}
+
+qsizetype TextSnapshot::lineAt(qsizetype position) const
+{
+    // Number of newlines before 'position'
+    const PieceNode *node = root.data();
+    qsizetype line = 0;
+
+    while (node)
+    {
+        const qsizetype leftLength = node->left ? node->left->totalLength : 0;
+        if (position < leftLength)
+        {
+            node = node->left.data();
+            continue;
+        }
+
+        line += node->left ? node->left->totalLineFeeds : 0;
+        position -= leftLength;
+        if (position < node->length)
+            return line + node->chunk->countNewlines(node->start, position);
+
+        line += node->lineFeeds;
+        position -= node->length;
+        node = node->right.data();
+    }
+
+    return line;
+}
+
+qsizetype TextSnapshot::lineStart(qsizetype line) const
+{
+    // Position right after the line-th newline
+    if (line <= 0)
+        return 0;
+
+    const PieceNode *node = root.data();
+    qsizetype position = 0;
+    qsizetype remaining = line - 1; // 0-based index of the newline to find
+
+    while (node)
+    {
+        const qsizetype leftLineFeeds = node->left ? node->left->totalLineFeeds : 0;
+        if (remaining < leftLineFeeds)
+        {
+            node = node->left.data();
+            continue;
+        }
+
+        remaining -= leftLineFeeds;
+        position += node->left ? node->left->totalLength : 0;
+        if (remaining < node->lineFeeds)
+            return position + node->chunk->findNthNewline(node->start, node->length, remaining) + 1;
+
+        remaining -= node->lineFeeds;
+        position += node->length;
+        node = node->right.data();
+    }
+
+    return length(); // past the last line
+}
+
+QString TextSnapshot::text(qsizetype position, qsizetype count) const
+{
+    QString result;
+    result.reserve(qMax(qMin(count, length() - position), qsizetype(0)));
+    forEachSpan(position, count, [&result](const TextSpan &span) {
+        span.appendTo(result);
+        return true;
+    });
+    return result;
+}
+
+/* --------------- *
+ *   PIECE TABLE   *
+ * --------------- */
+PieceTable::PieceTable()
+    : seed(0x9E3779B9u)
+{
+}
+
+static void collectChunks(const PieceNode *node, QSet<const TextChunk *> &chunks)
+{
+    for (; node; node = node->right.data())
+    {
+        chunks.insert(node->chunk.data());
+        collectChunks(node->left.data(), chunks);
+    }
+}
+
+qint64 PieceTable::memoryUsed() const
+{
+    QSet<const TextChunk *> chunks;
+    collectChunks(root.data(), chunks);
+    if (addChunk)
+        chunks.insert(addChunk.data());
+
+    qint64 bytes = qint64(pieceCount()) * qint64(sizeof(PieceNode));
+    for (const TextChunk *chunk : std::as_const(chunks))
+        bytes += chunk->memoryUsed();
+    return bytes;
+}
+
+void PieceTable::reset(const QSharedPointer<TextChunk> &original)
+{
+    root.reset();
+    addChunk.reset();
+
+    if (original && original->size() > 0)
+        root = makePiece(original, 0, original->size());
+}
+
+void PieceTable::insert(qsizetype position, QStringView text)
+{
+    if (text.isEmpty())
+        return;
+
+    position = qBound(qsizetype(0), position, length());
+
+    NodePtr left, right;
+    split(root, position, left, right);
+
+    // Typing: the previous piece ends where the add buffer ends, just grow it
+    const PieceNode *previous = lastPiece(left);
+    if (previous && addChunk && previous->chunk == addChunk
+        && previous->start + previous->length == addChunk->size() && text.size() <= addChunk->available())
+    {
+        addChunk->append(text);
+        root = merge(extendLast(left, text.size()), right);
+        return;
+    }
+
+    if (text.size() > OwnChunkThreshold)
+    {
+        const QSharedPointer<TextChunk> chunk = QSharedPointer<TextChunk>::create(text.toString());
+        root = merge(merge(left, makePiece(chunk, 0, text.size())), right);
+        return;
+    }
+
+    if (!addChunk || text.size() > addChunk->available())
+        addChunk = QSharedPointer<TextChunk>::create(AddChunkCapacity);
+
+    const qsizetype start = addChunk->append(text);
+    root = merge(merge(left, makePiece(addChunk, start, text.size())), right);
+}
+
+void PieceTable::remove(qsizetype position, qsizetype count)
+{
+    position = qBound(qsizetype(0), position, length());
+    count = qMin(count, length() - position);
+    if (count <= 0)
+        return;
+
+    NodePtr left, middle, right, rest;
+    split(root, position, left, rest);
+    split(rest, count, middle, right);
+    root = merge(left, right);
+}
+
+PieceTable::NodePtr PieceTable::makePiece(const QSharedPointer<TextChunk> &chunk, qsizetype start, qsizetype length)
+{
+    // xorshift32, priorities only need to be well spread
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return makeNode(chunk, start, length, seed, NodePtr(), NodePtr());
+}
+
+PieceTable::NodePtr PieceTable::makeNode(const QSharedPointer<TextChunk> &chunk, qsizetype start, qsizetype length,
+                                         quint32 priority, const NodePtr &left, const NodePtr &right)
+{
+    QSharedPointer<PieceNode> node = QSharedPointer<PieceNode>::create();
+    node->chunk = chunk;
+    node->start = start;
+    node->length = length;
+    node->priority = priority;
+    node->lineFeeds = chunk->countNewlines(start, length);
+    node->hashPower = TextHash::power(length);
+    node->hash = chunk->hash(start, length, node->hashPower);
+    return link(node, left, right);
+}
+
+PieceTable::NodePtr PieceTable::copyNode(const PieceNode &node, const NodePtr &left, const NodePtr &right)
+{
+    // Same piece, only the subtree changes
+    return link(QSharedPointer<PieceNode>::create(node), left, right);
+}
+
+PieceTable::NodePtr PieceTable::link(const QSharedPointer<PieceNode> &node, const NodePtr &left, const NodePtr &right)
+{
+    node->left = left;
+    node->right = right;
+
+    node->totalLength = node->length;
+    node->totalLineFeeds = node->lineFeeds;
+    node->totalPieces = 1;
+    node->totalHash = node->hash;
+    node->totalHashPower = node->hashPower;
+    if (left)
+    {
+        node->totalLength += left->totalLength;
+        node->totalLineFeeds += left->totalLineFeeds;
+        node->totalPieces += left->totalPieces;
+        node->totalHash = TextHash::concat(left->totalHash, node->totalHash, node->totalHashPower);
+        node->totalHashPower = TextHash::product(left->totalHashPower, node->totalHashPower);
+    }
+    if (right)
+    {
+        node->totalLength += right->totalLength;
+        node->totalLineFeeds += right->totalLineFeeds;
+        node->totalPieces += right->totalPieces;
+        node->totalHash = TextHash::concat(node->totalHash, right->totalHash, right->totalHashPower);
+        node->totalHashPower = TextHash::product(node->totalHashPower, right->totalHashPower);
+    }
+
+    return node;
+}
+
+PieceTable::NodePtr PieceTable::merge(const NodePtr &left, const NodePtr &right)
+{
+    if (!left)
+        return right;
+    if (!right)
+        return left;
+
+    if (left->priority > right->priority)
+        return copyNode(*left, left->left, merge(left->right, right));
+
+    return copyNode(*right, merge(left, right->left), right->right);
+}
+
+void PieceTable::split(const NodePtr &node, qsizetype position, NodePtr &left, NodePtr &right)
+{
+    // Nodes are shared with snapshots, every touched node is copied
+    if (!node)
+    {
+        left.reset();
+        right.reset();
+        return;
+    }
+
+    const qsizetype leftLength = node->left ? node->left->totalLength : 0;
+
+    if (position <= leftLength)
+    {
+        NodePtr subLeft, subRight;
+        split(node->left, position, subLeft, subRight);
+        left = subLeft;
+        right = copyNode(*node, subRight, node->right);
+    }
+    else if (position >= leftLength + node->length)
+    {
+        NodePtr subLeft, subRight;
+        split(node->right, position - leftLength - node->length, subLeft, subRight);
+        left = copyNode(*node, node->left, subLeft);
+        right = subRight;
+    }
+    else
+    {
+        // Cut inside this piece, both halves keep its priority
+        const qsizetype cut = position - leftLength;
+        left = makeNode(node->chunk, node->start, cut, node->priority, node->left, NodePtr());
+        right = makeNode(node->chunk, node->start + cut, node->length - cut, node->priority, NodePtr(), node->right);
+    }
+}
+
+PieceTable::NodePtr PieceTable::extendLast(const NodePtr &node, qsizetype count)
+{
+    if (node->right)
+        return copyNode(*node, node->left, extendLast(node->right, count));
+
+    return makeNode(node->chunk, node->start, node->length + count, node->priority, node->left, NodePtr());
+}
+
+const PieceNode *PieceTable::lastPiece(const NodePtr &node)
+{
+    const PieceNode *last = node.data();
+    while (last && last->right)
+        last = last->right.data();
+    return last;
+}
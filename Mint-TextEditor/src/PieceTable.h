@@ -0,0 +1,200 @@
+#ifndef PIECETABLE_H
+#define PIECETABLE_H
+
+#include <QString>
+#include <QStringView>
+#include <QSharedPointer>
+#include <QByteArray>
+#include <QList>
+
+#include "TextHash.h"
+
+// Storage referenced by the pieces of a PieceTable. A chunk is either the
+// original text, an owned copy of the loaded text (as Latin-1 bytes when
+// those are the characters, UTF-16 otherwise), or the append-only "add"
+// buffer. Text that a piece
+// refers to is never modified, which makes snapshots safe to read from other
+// threads while the editor keeps appending.
+// Fixed chunks carry the offsets of their newlines, the add buffer is small
+// enough to be scanned instead. All chunks sample their prefix hashes.
+class TextChunk
+{
+public:
+    explicit TextChunk(const QString &text);                            // decoded text
+    // Take over the loader's text and index
+    TextChunk(QString text, QList<qsizetype> newlines, const TextHash::Sampler &hashes);
+    TextChunk(QByteArray latin1Text,                                    // bytes that are the characters
+              QList<qsizetype> newlines, const TextHash::Sampler &hashes);
+    explicit TextChunk(qsizetype reserved);                             // empty add buffer
+
+    bool isLatin1() const { return latin1Data != nullptr; }
+    const char *latin1() const { return latin1Data; }
+    const QChar *utf16() const { return utf16Data; }
+    qsizetype size() const { return used; }
+    qsizetype available() const { return capacity - used; }
+    qint64 memoryUsed() const; // bytes of the text, its newline index and hash samples
+
+    // Add buffer only: copies 'text' behind the used part, returns its offset
+    qsizetype append(QStringView text);
+
+    // Newlines within [start, start + length), the n-th one relative to start
+    qsizetype countNewlines(qsizetype start, qsizetype length) const;
+    qsizetype findNthNewline(qsizetype start, qsizetype length, qsizetype n) const;
+
+    // TextHash of [start, start + length), 'lengthPower' is TextHash::power(length)
+    quint64 hash(qsizetype start, qsizetype length, quint64 lengthPower) const;
+
+private:
+    Q_DISABLE_COPY(TextChunk)
+
+    QString storage;
+    QByteArray latin1Storage;
+    const char *latin1Data;
+    const QChar *utf16Data;
+    qsizetype used;
+    qsizetype capacity;
+    QList<qsizetype> newlines;
+    bool indexed;
+    TextHash::Sampler hashes;
+
+    quint64 prefixHash(qsizetype end) const;
+};
+
+// Contiguous run of text, in either Latin-1 or UTF-16 storage
+struct TextSpan
+{
+    const char *latin1;
+    const QChar *utf16;
+    qsizetype length;
+
+    QChar at(qsizetype i) const { return latin1 ? QChar(uchar(latin1[i])) : utf16[i]; }
+    TextSpan mid(qsizetype position, qsizetype count) const
+    {
+        return TextSpan{ latin1 ? latin1 + position : nullptr, latin1 ? nullptr : utf16 + position, count };
+    }
+    void appendTo(QString &out) const;
+};
+
+// Immutable node of the piece tree (a treap ordered by text position)
+struct PieceNode
+{
+    QSharedPointer<TextChunk> chunk;
+    qsizetype start;
+    qsizetype length;
+    quint32 priority;
+    qsizetype lineFeeds;
+    quint64 hash;
+    quint64 hashPower; // TextHash::power(length)
+
+    // Subtree aggregates
+    qsizetype totalLength;
+    qsizetype totalLineFeeds;
+    int totalPieces;
+    quint64 totalHash;
+    quint64 totalHashPower;
+
+    QSharedPointer<const PieceNode> left;
+    QSharedPointer<const PieceNode> right;
+};
+
+// Read-only view of the text at one point in time. Copying is O(1) and the
+// copy stays valid whatever happens to the PieceTable afterwards.
+class TextSnapshot
+{
+public:
+    qsizetype length() const { return root ? root->totalLength : 0; }
+    bool isEmpty() const { return length() == 0; }
+    int pieceCount() const { return root ? root->totalPieces : 0; }
+    // TextHash of the whole text, kept up to date by every edit in O(log n)
+    quint64 hash() const { return root ? root->totalHash : 0; }
+
+    QChar at(qsizetype position) const;
+    QString text(qsizetype position, qsizetype count) const;
+    QString toString() const { return text(0, length()); }
+
+    // Lines are 0-based, all lookups are O(log n)
+    qsizetype lineCount() const { return (root ? root->totalLineFeeds : 0) + 1; }
+    qsizetype lineAt(qsizetype position) const;
+    qsizetype lineStart(qsizetype line) const;
+    qsizetype columnAt(qsizetype position) const { return position - lineStart(lineAt(position)); }
+
+    // Calls fn(const TextSpan &) for each piece overlapping the range, in
+    // order, until it returns false
+    template <typename Fn>
+    void forEachSpan(qsizetype position, qsizetype count, Fn fn) const
+    {
+        visit(root.data(), position, qMin(position + count, length()), fn);
+    }
+
+protected:
+    using NodePtr = QSharedPointer<const PieceNode>;
+
+    template <typename Fn>
+    static bool visit(const PieceNode *node, qsizetype from, qsizetype to, Fn &fn)
+    {
+        // [from, to) is relative to the subtree's first character
+        while (node && from < to)
+        {
+            const qsizetype leftLength = node->left ? node->left->totalLength : 0;
+            if (from < leftLength && !visit(node->left.data(), from, qMin(to, leftLength), fn))
+                return false;
+
+            const qsizetype begin = qMax(from - leftLength, qsizetype(0));
+            const qsizetype end = qMin(to - leftLength, node->length);
+            if (begin < end)
+            {
+                const TextChunk *chunk = node->chunk.data();
+                const qsizetype offset = node->start + begin;
+                if (!fn(TextSpan{ chunk->isLatin1() ? chunk->latin1() + offset : nullptr,
+                                  chunk->isLatin1() ? nullptr : chunk->utf16() + offset,
+                                  end - begin }))
+                    return false;
+            }
+
+            // Continue with the right subtree without recursing
+            const qsizetype skipped = leftLength + node->length;
+            from = qMax(from - skipped, qsizetype(0));
+            to -= skipped;
+            node = node->right.data();
+        }
+        return true;
+    }
+
+    NodePtr root;
+};
+
+// Piece table holding the editor's text beside the QTextDocument, which
+// still stores and lays out its own copy. The original text is one chunk
+// that edits never modify: they only add pieces pointing into the
+// append-only add buffer. Inserts and
+// removals are O(log n) in the number of pieces, and snapshot() is O(1).
+class PieceTable : public TextSnapshot
+{
+public:
+    PieceTable();
+
+    void reset(const QSharedPointer<TextChunk> &original = QSharedPointer<TextChunk>());
+    void insert(qsizetype position, QStringView text);
+    void remove(qsizetype position, qsizetype count);
+
+    TextSnapshot snapshot() const { return *this; }
+
+    // Bytes held by the chunks it references, each counted once, and the pieces
+    qint64 memoryUsed() const;
+
+private:
+    NodePtr makePiece(const QSharedPointer<TextChunk> &chunk, qsizetype start, qsizetype length);
+    static NodePtr makeNode(const QSharedPointer<TextChunk> &chunk, qsizetype start, qsizetype length,
+                            quint32 priority, const NodePtr &left, const NodePtr &right);
+    static NodePtr copyNode(const PieceNode &node, const NodePtr &left, const NodePtr &right);
+    static NodePtr link(const QSharedPointer<PieceNode> &node, const NodePtr &left, const NodePtr &right);
+    static NodePtr merge(const NodePtr &left, const NodePtr &right);
+    static void split(const NodePtr &node, qsizetype position, NodePtr &left, NodePtr &right);
+    static NodePtr extendLast(const NodePtr &node, qsizetype count);
+    static const PieceNode *lastPiece(const NodePtr &node);
+
+    QSharedPointer<TextChunk> addChunk;
+    quint32 seed;
+};
+
+#endif // PIECETABLE_H
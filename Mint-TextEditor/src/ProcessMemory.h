@@ -0,0 +1,13 @@
+#ifndef PROCESSMEMORY_H
+#define PROCESSMEMORY_H
+
+#include <QtGlobal>
+
+// Memory usage of the running process, for reports
+class ProcessMemory
+{
+public:
+    static qint64 peakResident(); // bytes, -1 if unknown
+};
+
+#endif // PROCESSMEMORY_H
@@ -0,0 +1,277 @@
+#include "SearchEngine.h"
+#include <QElapsedTimer>
+#include <algorithm>
+
+// Characters scanned between two cancellation checks
+static const qsizetype SliceSize = 1024 * 1024;
+// Matches are sent to the GUI thread by batches of this size, or this often
+static const qsizetype BatchSize = 4096;
+static const qint64 BatchIntervalMs = 50;
+// Regular expressions see this much text before and after their window
+static const qsizetype RegexLookbehind = 256;
+static const qsizetype RegexOverlap = 64 * 1024;
+
+SearchEngine::SearchEngine(QObject *parent)
+    : QObject(parent), generation(0), patternLength(0), literalCase(Qt::CaseSensitive),
+      literalWholeWords(false), searching(false)
+{
+    // One scan at a time, a new one only starts when the stale one gave up
+    pool.setMaxThreadCount(1);
+}
+
+SearchEngine::~SearchEngine()
+{
+    cancel();
+    pool.waitForDone();
+}
+
+void SearchEngine::search(const TextSnapshot &text, const QString &pattern, Qt::CaseSensitivity cs, bool wholeWords)
+{
+    literalPattern = pattern;
+    literalCase = cs;
+    literalWholeWords = wholeWords;
+
+    start(pattern.size(), [text, pattern, cs, wholeWords](const Report &report, const std::function<bool()> &cancelled) {
+        const TextMatcher matcher(pattern, cs);
+        findAll(text, matcher, wholeWords, 0, text.length(), [&](qsizetype position) {
+            return report(position, matcher.length());
+        }, cancelled);
+    });
+}
+
+void SearchEngine::search(const TextSnapshot &text, const QRegularExpression &regex)
+{
+    start(-1, [text, regex](const Report &report, const std::function<bool()> &cancelled) {
+        findAll(text, regex, 0, text.length(), [&](const QRegularExpressionMatch &match, qsizetype base) {
+            return report(base + match.capturedStart(), match.capturedLength());
+        }, cancelled);
+    });
+}
+
+void SearchEngine::start(qsizetype fixedLength, const Scan &scan)
+{
+    const quint64 id = generation.fetchAndAddOrdered(1) + 1;
+    const bool variable = fixedLength < 0;
+
+    results.clear();
+    lengths.clear();
+    patternLength = fixedLength;
+    searching = true;
+
+    pool.start([this, id, scan, variable]() {
+        const auto stale = [this, id]() { return generation.loadRelaxed() != id; };
+
+        QList<qsizetype> batch;
+        QList<qsizetype> batchLengths;
+        QElapsedTimer sinceFlush;
+        sinceFlush.start();
+
+        const auto flush = [this, id, &batch, &batchLengths, &sinceFlush](bool last) {
+            QMetaObject::invokeMethod(this, [this, id, batch, batchLengths, last]() {
+                addMatches(id, batch, batchLengths, last);
+            }, Qt::QueuedConnection);
+            batch.clear();
+            batchLengths.clear();
+            sinceFlush.restart();
+        };
+
+        scan([&](qsizetype position, qsizetype length) {
+            batch.append(position);
+            if (variable)
+                batchLengths.append(length);
+            if (batch.size() >= BatchSize || sinceFlush.elapsed() >= BatchIntervalMs)
+                flush(false);
+            return !stale();
+        }, stale);
+
+        if (!stale())
+            flush(true);
+    });
+}
+
+void SearchEngine::cancel()
+{
+    generation.fetchAndAddOrdered(1);
+    searching = false;
+}
+
+bool SearchEngine::update(const TextSnapshot &text, qsizetype position, qsizetype removed, qsizetype added)
+{
+    if (searching || patternLength <= 0 || qMax(removed, added) > SliceSize)
+        return false;
+
+    // Matches overlapping the edit, or next to it for whole words, are dropped
+    const qsizetype m = patternLength;
+    const qsizetype first = std::lower_bound(results.cbegin(), results.cend(), position - m) - results.cbegin();
+    const qsizetype last = std::lower_bound(results.cbegin() + first, results.cend(), position + removed + 1) - results.cbegin();
+
+    // and found again in the new text around the edit
+    QList<qsizetype> updated = results.first(first);
+    const TextMatcher matcher(literalPattern, literalCase);
+    findAll(text, matcher, literalWholeWords, qMax(qsizetype(0), position - m), qMin(text.length(), position + added + m),
+            [&updated](qsizetype match) {
+        updated.append(match);
+        return true;
+    });
+
+    // Matches after the edit only move
+    updated.reserve(updated.size() + results.size() - last);
+    for (qsizetype i = last; i < results.size(); ++i)
+        updated.append(results.at(i) + added - removed);
+
+    results = std::move(updated);
+    emit finished(results.size());
+    return true;
+}
+
+void SearchEngine::addMatches(quint64 id, const QList<qsizetype> &batch, const QList<qsizetype> &batchLengths, bool last)
+{
+    // Results of a search that has been replaced since
+    if (id != generation.loadRelaxed())
+        return;
+
+    results.append(batch);
+    lengths.append(batchLengths);
+    emit matchesFound(results.size());
+
+    if (last)
+    {
+        searching = false;
+        emit finished(results.size());
+    }
+}
+
+qsizetype SearchEngine::nextMatch(qsizetype position, bool forward) const
+{
+    const auto it = std::lower_bound(results.cbegin(), results.cend(), position);
+
+    if (forward)
+        return it == results.cend() ? -1 : it - results.cbegin();
+
+    return it == results.cbegin() ? -1 : (it - results.cbegin()) - 1;
+}
+
+void SearchEngine::findAll(const TextSnapshot &text, const TextMatcher &matcher, bool wholeWords,
+                           qsizetype from, qsizetype to, const std::function<bool(qsizetype)> &report,
+                           const std::function<bool()> &cancelled)
+{
+    const qsizetype m = matcher.length();
+    if (m == 0 || to - from < m)
+        return;
+
+    const auto accept = [&](qsizetype position) {
+        if (wholeWords)
+        {
+            const QChar before = position > 0 ? text.at(position - 1) : QChar();
+            const QChar after = position + m < text.length() ? text.at(position + m) : QChar();
+            if (!TextMatcher::isWholeWord(before, after))
+                return true;
+        }
+        return report(position);
+    };
+
+    const auto indexIn = [&matcher](const TextSpan &span, qsizetype size, qsizetype start) {
+        return span.latin1 ? matcher.indexIn(span.latin1, size, start) : matcher.indexIn(span.utf16, size, start);
+    };
+
+    qsizetype base = from; // offset of the current span
+    QString tail;          // the m - 1 characters before it
+
+    text.forEachSpan(from, to - from, [&](const TextSpan &span) {
+        // Matches starting in the previous spans and ending in this one
+        if (!tail.isEmpty())
+        {
+            QString window = tail;
+            span.mid(0, qMin(span.length, m - 1)).appendTo(window);
+
+            for (qsizetype i = matcher.indexIn(window.constData(), window.size()); i >= 0 && i < tail.size();
+                 i = matcher.indexIn(window.constData(), window.size(), i + 1))
+            {
+                if (i + m > tail.size() && !accept(base - tail.size() + i))
+                    return false;
+            }
+        }
+
+        // Matches inside the span, by slices to check for cancellation
+        for (qsizetype start = 0; start < span.length; start += SliceSize)
+        {
+            if (cancelled && cancelled())
+                return false;
+
+            const qsizetype end = qMin(span.length, start + SliceSize + m - 1);
+            for (qsizetype i = indexIn(span, end, start); i >= 0 && i < start + SliceSize; i = indexIn(span, end, i + 1))
+            {
+                if (!accept(base + i))
+                    return false;
+            }
+        }
+
+        // Keep the last m - 1 characters for the next boundary
+        if (span.length >= m - 1)
+        {
+            tail.clear();
+            span.mid(span.length - (m - 1), m - 1).appendTo(tail);
+        }
+        else
+        {
+            span.appendTo(tail);
+            tail = tail.right(m - 1);
+        }
+
+        base += span.length;
+        return true;
+    });
+}
+
+void SearchEngine::findAll(const TextSnapshot &text, const QRegularExpression &regex, qsizetype from, qsizetype to,
+                           const std::function<bool(const QRegularExpressionMatch &, qsizetype)> &report,
+                           const std::function<bool()> &cancelled)
+{
+    if (!regex.isValid())
+        return;
+
+    // Each window accepts the matches starting in [position, acceptEnd); the
+    // text around it keeps lookarounds, ^ and $ right at its edges
+    for (qsizetype position = from; position <= to;)
+    {
+        if (cancelled && cancelled())
+            return;
+
+        const qsizetype base = qMax(qsizetype(0), position - RegexLookbehind);
+        const qsizetype acceptEnd = qMin(to, position + SliceSize);
+        const qsizetype windowEnd = qMin(text.length(), acceptEnd + RegexOverlap);
+        const bool lastWindow = acceptEnd == to;
+        const QString window = text.text(base, windowEnd - base);
+
+        qsizetype next = acceptEnd;
+        bool cut = false;
+
+        QRegularExpressionMatchIterator it = regex.globalMatch(window, position - base);
+        while (it.hasNext())
+        {
+            const QRegularExpressionMatch match = it.next();
+            const qsizetype start = base + match.capturedStart();
+            const qsizetype end = base + match.capturedEnd();
+
+            if (end > to || (start >= acceptEnd && !lastWindow))
+                break;
+
+            // A match reaching the end of the window may go on after it:
+            // retry it from the next window, unless it is too long for any
+            if (end == windowEnd && windowEnd < text.length() && start > position)
+            {
+                next = start;
+                cut = true;
+                break;
+            }
+
+            if (!report(match, base))
+                return;
+            next = qMax(next, end);
+        }
+
+        if (lastWindow && !cut)
+            return;
+        position = next;
+    }
+}
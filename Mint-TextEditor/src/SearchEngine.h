@@ -0,0 +1,81 @@
+#ifndef SEARCHENGINE_H
+#define SEARCHENGINE_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QAtomicInteger>
+#include <QRegularExpression>
+#include <QList>
+#include <functional>
+
+#include "PieceTable.h"
+#include "TextMatcher.h"
+
+// Finds every occurrence of a literal pattern or a regular expression in a
+// text snapshot on a worker thread. Match offsets are streamed back in batches while the scan goes on,
+// and starting a new search makes the previous one stop at its next check.
+class SearchEngine : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SearchEngine(QObject *parent = nullptr);
+    ~SearchEngine();
+
+    void search(const TextSnapshot &text, const QString &pattern, Qt::CaseSensitivity cs, bool wholeWords);
+    void search(const TextSnapshot &text, const QRegularExpression &regex);
+    void cancel();
+
+    // Keeps the results of a finished literal search in step with an edit:
+    // 'removed' characters at 'position' replaced by 'added' ones in 'text'.
+    // Only the text around the edit is scanned again. Returns false when a
+    // new search is needed instead (regular expression, search running,
+    // large edit).
+    bool update(const TextSnapshot &text, qsizetype position, qsizetype removed, qsizetype added);
+
+    bool isSearching() const { return searching; }
+    const QList<qsizetype> &matches() const { return results; }
+    qsizetype matchLength(qsizetype index) const { return patternLength >= 0 ? patternLength : lengths.at(index); }
+
+    // Index in matches() of the first match starting at or after 'position'
+    // (forward) or of the last one starting before it, -1 if there is none
+    qsizetype nextMatch(qsizetype position, bool forward) const;
+
+    // Scans [from, to) and calls report() for each match fully inside it,
+    // stops as soon as report() returns false or cancelled() returns true
+    static void findAll(const TextSnapshot &text, const TextMatcher &matcher, bool wholeWords,
+                        qsizetype from, qsizetype to, const std::function<bool(qsizetype)> &report,
+                        const std::function<bool()> &cancelled = std::function<bool()>());
+
+    // Same for a regular expression, matched over windows of contiguous text
+    // so that matches may span lines. report() gets the match and the offset
+    // of the text it was run on.
+    static void findAll(const TextSnapshot &text, const QRegularExpression &regex, qsizetype from, qsizetype to,
+                        const std::function<bool(const QRegularExpressionMatch &, qsizetype)> &report,
+                        const std::function<bool()> &cancelled = std::function<bool()>());
+
+signals:
+    void matchesFound(qsizetype count);
+    void finished(qsizetype count);
+
+private:
+    using Report = std::function<bool(qsizetype position, qsizetype length)>;
+    using Scan = std::function<void(const Report &report, const std::function<bool()> &cancelled)>;
+
+    // Runs 'scan' on the worker, a negative length means matches vary in length
+    void start(qsizetype fixedLength, const Scan &scan);
+    void addMatches(quint64 id, const QList<qsizetype> &batch, const QList<qsizetype> &batchLengths, bool last);
+
+    QThreadPool pool;
+    QAtomicInteger<quint64> generation;
+    QList<qsizetype> results;
+    QList<qsizetype> lengths; // only for variable length matches
+    qsizetype patternLength;
+    // Literal search parameters, for update()
+    QString literalPattern;
+    Qt::CaseSensitivity literalCase;
+    bool literalWholeWords;
+    bool searching;
+};
+
+#endif // SEARCHENGINE_H
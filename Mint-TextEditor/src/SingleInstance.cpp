@@ -0,0 +1,93 @@
+#include "SingleInstance.h"
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+// A running instance answers at once, a missing one fails at once: only a
+// hung instance makes a launch wait this long before starting its own
+static const int ForwardTimeoutMs = 1000;
+static const char Accepted = '\1';
+
+SingleInstance::SingleInstance(QObject *parent)
+    : QObject(parent), server(nullptr)
+{
+}
+
+QString SingleInstance::serverName()
+{
+    // Per user: sessions of different users never share an instance
+    const QByteArray user = QDir::homePath().toUtf8();
+    return QCoreApplication::applicationName() + "-"
+           + QCryptographicHash::hash(user, QCryptographicHash::Sha1).toHex().left(16);
+}
+
+bool SingleInstance::forward(const QStringList &arguments)
+{
+    QLocalSocket socket;
+    socket.connectToServer(serverName());
+    if (!socket.waitForConnected(ForwardTimeoutMs))
+        return false;
+
+    QByteArray message;
+    QDataStream out(&message, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_6_0);
+    out << arguments;
+    socket.write(message);
+    if (!socket.waitForBytesWritten(ForwardTimeoutMs))
+        return false;
+
+    // Acknowledged once the instance has read them
+    char reply = 0;
+    while (socket.bytesAvailable() < 1)
+    {
+        if (!socket.waitForReadyRead(ForwardTimeoutMs))
+            return false;
+    }
+    return socket.getChar(&reply) && reply == Accepted;
+}
+
+bool SingleInstance::listen()
+{
+    server = new QLocalServer(this);
+    server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(server, &QLocalServer::newConnection, this, &SingleInstance::newConnection);
+
+    if (server->listen(serverName()))
+        return true;
+
+    // Another launch may have just won the race, else the name was left
+    // behind by an instance that crashed
+    QLocalSocket probe;
+    probe.connectToServer(serverName());
+    if (probe.waitForConnected(ForwardTimeoutMs))
+        return false;
+    QLocalServer::removeServer(serverName());
+    return server->listen(serverName());
+}
+
+void SingleInstance::newConnection()
+{
+    while (QLocalSocket *socket = server->nextPendingConnection())
+    {
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QLocalSocket::readyRead, this, [this, socket]() {
+            QDataStream in(socket);
+            in.setVersion(QDataStream::Qt_6_0);
+
+            // The message may arrive in several reads
+            in.startTransaction();
+            QStringList arguments;
+            in >> arguments;
+            if (!in.commitTransaction())
+                return;
+
+            socket->putChar(Accepted);
+            socket->flush();
+            socket->disconnectFromServer();
+            emit argumentsReceived(arguments);
+        });
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef SINGLEINSTANCE_H
+#define SINGLEINSTANCE_H
+
+#include <QObject>
+#include <QStringList>
+
+class QLocalServer;
+
+// One Mint per user session. A later launch hands its arguments to the
+// running instance over a local socket and exits before any window, theme
+// or document is set up; the instance opens them in new tabs.
+class SingleInstance : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SingleInstance(QObject *parent = nullptr);
+
+    // Client side: true once an instance has taken the arguments
+    static bool forward(const QStringList &arguments);
+    // Server side: becomes the instance later launches forward to
+    bool listen();
+
+signals:
+    void argumentsReceived(const QStringList &arguments);
+
+private slots:
+    void newConnection();
+
+private:
+    static QString serverName();
+
+    QLocalServer *server;
+};
+
+#endif // SINGLEINSTANCE_H
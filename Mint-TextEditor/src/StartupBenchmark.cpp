@@ -0,0 +1,62 @@
+#include "StartupBenchmark.h"
+#include "ProcessMemory.h"
+#include <QCoreApplication>
+#include <QEvent>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QTimer>
+#include <QWidget>
+#include <cstdio>
+
+StartupBenchmark::StartupBenchmark(QObject *parent)
+    : QObject(parent), window(nullptr), reporting(false)
+{
+    timer.start();
+}
+
+void StartupBenchmark::mark(const QString &phase)
+{
+    phases.append(Phase{ phase, timer.nsecsElapsed() });
+}
+
+void StartupBenchmark::watch(QWidget *widget, bool report)
+{
+    window = widget;
+    reporting = report;
+    window->installEventFilter(this);
+}
+
+bool StartupBenchmark::eventFilter(QObject *watched, QEvent *event)
+{
+    if (watched == window && event->type() == QEvent::Paint)
+    {
+        // The first paint is what the user waits for, later ones don't matter
+        window->removeEventFilter(this);
+        QTimer::singleShot(0, this, [this]() {
+            mark("firstPaint");
+            if (reporting)
+            {
+                report();
+                QCoreApplication::quit();
+            }
+        });
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void StartupBenchmark::report()
+{
+    QJsonArray list;
+    for (const Phase &phase : phases)
+        list.append(QJsonObject{ { "name", phase.name }, { "ms", phase.elapsedNs / 1e6 } });
+
+    const QJsonObject result{
+        { "phases", list },
+        { "totalMs", phases.isEmpty() ? 0.0 : phases.last().elapsedNs / 1e6 },
+        { "peakResidentBytes", ProcessMemory::peakResident() },
+    };
+    const QByteArray json = QJsonDocument(result).toJson();
+    std::fwrite(json.constData(), 1, size_t(json.size()), stdout);
+    std::fflush(stdout);
+}
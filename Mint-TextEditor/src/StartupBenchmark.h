@@ -0,0 +1,42 @@
+#ifndef STARTUPBENCHMARK_H
+#define STARTUPBENCHMARK_H
+
+#include <QObject>
+#include <QElapsedTimer>
+#include <QList>
+
+class QWidget;
+
+// Times the startup phases, from main() to the first paint of the window.
+// With --startup-benchmark the phases are printed as JSON once the window
+// has painted, and the application quits: run it a few times after dropping
+// the system caches for cold starts.
+class StartupBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StartupBenchmark(QObject *parent = nullptr); // starts the clock
+
+    void mark(const QString &phase); // time since the start
+    void watch(QWidget *window, bool report); // marks its first paint
+
+protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
+
+private:
+    void report();
+
+    struct Phase
+    {
+        QString name;
+        qint64 elapsedNs;
+    };
+
+    QElapsedTimer timer;
+    QList<Phase> phases;
+    QWidget *window;
+    bool reporting;
+};
+
+#endif // STARTUPBENCHMARK_H
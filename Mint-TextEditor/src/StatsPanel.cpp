@@ -0,0 +1,107 @@
+#include "StatsPanel.h"
+#include "Trace.h"
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QPushButton>
+#include <QFileDialog>
+#include <QMessageBox>
+
+// Table refresh while the panel is shown
+static const int RefreshMs = 500;
+
+StatsPanel::StatsPanel(QWidget *parent)
+    : QDockWidget("Performance", parent)
+{
+    setObjectName("statsPanel");
+
+    const QStringList columns = { "Count", "Mean", "p50", "p95", "p99", "Max" };
+    table = new QTableWidget(Trace::OperationCount, columns.size(), this);
+    table->setHorizontalHeaderLabels(columns);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionMode(QAbstractItemView::NoSelection);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    for (int row = 0; row < Trace::OperationCount; ++row)
+    {
+        table->setVerticalHeaderItem(row, new QTableWidgetItem(Trace::name(Trace::Operation(row))));
+        for (int column = 0; column < columns.size(); ++column)
+        {
+            QTableWidgetItem *item = new QTableWidgetItem;
+            item->setTextAlignment(Qt::AlignRight | Qt::AlignVCenter);
+            table->setItem(row, column, item);
+        }
+    }
+
+    recordCheck = new QCheckBox("Record");
+    QPushButton *resetButton = new QPushButton("Reset");
+    QPushButton *exportButton = new QPushButton("Export trace ...");
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(recordCheck);
+    buttonLayout->addStretch();
+    buttonLayout->addWidget(resetButton);
+    buttonLayout->addWidget(exportButton);
+
+    QWidget *content = new QWidget(this);
+    QVBoxLayout *layout = new QVBoxLayout(content);
+    layout->addWidget(table);
+    layout->addLayout(buttonLayout);
+    setWidget(content);
+
+    connect(recordCheck, &QCheckBox::toggled, this, [](bool checked) { Trace::setEnabled(checked); });
+    connect(resetButton, &QPushButton::clicked, this, [this]() {
+        Trace::reset();
+        refresh();
+    });
+    connect(exportButton, &QPushButton::clicked, this, &StatsPanel::exportTrace);
+
+    refreshTimer = new QTimer(this);
+    refreshTimer->setInterval(RefreshMs);
+    connect(refreshTimer, &QTimer::timeout, this, &StatsPanel::refresh);
+
+    // Opening the panel is asking for numbers
+    Trace::setEnabled(true);
+    recordCheck->setChecked(true);
+}
+
+void StatsPanel::refresh()
+{
+    const auto milliseconds = [](qint64 ns) { return QString::number(ns / 1e6, 'f', ns < 10000000 ? 2 : 0) + " ms"; };
+
+    for (int row = 0; row < Trace::OperationCount; ++row)
+    {
+        const Trace::Stats stats = Trace::stats(Trace::Operation(row));
+        const bool empty = stats.count == 0;
+        table->item(row, 0)->setText(QString::number(stats.count));
+        table->item(row, 1)->setText(empty ? QString() : milliseconds(stats.totalNs / stats.count));
+        table->item(row, 2)->setText(empty ? QString() : milliseconds(stats.percentileNs(50)));
+        table->item(row, 3)->setText(empty ? QString() : milliseconds(stats.percentileNs(95)));
+        table->item(row, 4)->setText(empty ? QString() : milliseconds(stats.percentileNs(99)));
+        table->item(row, 5)->setText(empty ? QString() : milliseconds(stats.maxNs));
+    }
+    recordCheck->setChecked(Trace::isEnabled());
+}
+
+void StatsPanel::exportTrace()
+{
+    const QString fileName = QFileDialog::getSaveFileName(this, "Export trace", "mint-trace.json", "Chrome trace (*.json)");
+    if (fileName.isEmpty())
+        return;
+
+    QString error;
+    if (!Trace::exportChromeTrace(fileName, &error))
+        QMessageBox::warning(this, "Error", QString("The trace couldn't be saved :\n%1").arg(error));
+}
+
+void StatsPanel::showEvent(QShowEvent *event)
+{
+    QDockWidget::showEvent(event);
+    refresh();
+    refreshTimer->start();
+}
+
+void StatsPanel::hideEvent(QHideEvent *event)
+{
+    refreshTimer->stop();
+    QDockWidget::hideEvent(event);
+}
@@ -0,0 +1,33 @@
+#ifndef STATSPANEL_H
+#define STATSPANEL_H
+
+#include <QDockWidget>
+#include <QTableWidget>
+#include <QCheckBox>
+#include <QTimer>
+
+// Latency of each traced operation (count, mean, percentiles, worst), kept
+// up to date while shown, with the Chrome trace export. Recording starts
+// when the panel is first opened.
+class StatsPanel : public QDockWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StatsPanel(QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void exportTrace();
+
+private:
+    QTableWidget *table;
+    QCheckBox *recordCheck;
+    QTimer *refreshTimer;
+
+protected:
+    void showEvent(QShowEvent *event) override;
+    void hideEvent(QHideEvent *event) override;
+};
+
+#endif // STATSPANEL_H
@@ -0,0 +1,208 @@
+#include "SyntaxHighlighter.h"
+#include <QTextDocument>
+#include <QTextLayout>
+
+// Edits spanning more blocks than this (pastes, loads) go to the lazy pass
+static const int MaxEagerBlocks = 200;
+// Blocks highlighted past the bottom of the screen, ready for scrolling
+static const int LookaheadBlocks = 30;
+
+// Formats of a block were computed from this start state and revision
+class HighlightData : public QTextBlockUserData
+{
+public:
+    int startState = -1;
+    int revision = -1;
+};
+
+SyntaxHighlighter::SyntaxHighlighter(QPlainTextEdit *textEdit, QObject *parent)
+    : QObject(parent), textEditor(textEdit), document(textEdit->document()), currentLanguage(nullptr),
+      frontier(0), blockCount(textEdit->document()->blockCount()), formatting(false)
+{
+    // Mint palette
+    formats[SyntaxLanguage::Keyword].setForeground(QColor("#00918E"));
+    formats[SyntaxLanguage::Keyword].setFontWeight(QFont::Bold);
+    formats[SyntaxLanguage::Type].setForeground(QColor("#2E8B57"));
+    formats[SyntaxLanguage::String].setForeground(QColor("#B7791F"));
+    formats[SyntaxLanguage::Number].setForeground(QColor("#C0392B"));
+    formats[SyntaxLanguage::Comment].setForeground(QColor("#A0A0A0"));
+    formats[SyntaxLanguage::Comment].setFontItalic(true);
+    formats[SyntaxLanguage::Preprocessor].setForeground(QColor("#8E44AD"));
+    formats[SyntaxLanguage::Tag].setForeground(QColor("#00918E"));
+    formats[SyntaxLanguage::Attribute].setForeground(QColor("#2E8B57"));
+    formats[SyntaxLanguage::Heading].setForeground(QColor("#00918E"));
+    formats[SyntaxLanguage::Heading].setFontWeight(QFont::Bold);
+    formats[SyntaxLanguage::Emphasis].setFontItalic(true);
+    formats[SyntaxLanguage::Code].setForeground(QColor("#110133"));
+    formats[SyntaxLanguage::Code].setBackground(QColor("#F0F0F0"));
+    formats[SyntaxLanguage::Link].setForeground(QColor("#2980B9"));
+    formats[SyntaxLanguage::Link].setFontUnderline(true);
+
+    // Coalesces scrolls and repaints into one pass per event loop iteration
+    updateTimer = new QTimer(this);
+    updateTimer->setSingleShot(true);
+    updateTimer->setInterval(0);
+    connect(updateTimer, &QTimer::timeout, this, &SyntaxHighlighter::highlightVisibleBlocks);
+
+    connect(document, &QTextDocument::contentsChange, this, &SyntaxHighlighter::contentsChanged);
+    connect(textEditor, &QPlainTextEdit::updateRequest, this, &SyntaxHighlighter::scheduleUpdate);
+}
+
+void SyntaxHighlighter::setLanguage(const SyntaxLanguage *language)
+{
+    if (language == currentLanguage)
+        return;
+
+    clearFormats();
+    currentLanguage = language;
+    frontier = 0;
+    scheduleUpdate();
+}
+
+void SyntaxHighlighter::clearFormats()
+{
+    // Only blocks that have been on screen carry formats
+    formatting = true;
+    for (QTextBlock block = document->begin(); block.isValid(); block = block.next())
+    {
+        if (!block.userData())
+            continue;
+
+        block.setUserData(nullptr);
+        block.layout()->clearFormats();
+        document->markContentsDirty(block.position(), block.length());
+    }
+    formatting = false;
+}
+
+void SyntaxHighlighter::scheduleUpdate()
+{
+    if (currentLanguage)
+        updateTimer->start();
+}
+
+int SyntaxHighlighter::previousState(const QTextBlock &block)
+{
+    const QTextBlock previous = block.previous();
+    return previous.isValid() ? qMax(previous.userState(), 0) : 0;
+}
+
+int SyntaxHighlighter::lastVisibleBlock() const
+{
+    return textEditor->cursorForPosition(QPoint(0, textEditor->viewport()->height() - 1)).block().blockNumber();
+}
+
+void SyntaxHighlighter::contentsChanged(int position, int charsRemoved, int charsAdded)
+{
+    Q_UNUSED(charsRemoved);
+
+    if (formatting)
+        return;
+
+    const int delta = document->blockCount() - blockCount;
+    blockCount = document->blockCount();
+
+    if (!currentLanguage)
+        return;
+
+    scheduleUpdate();
+
+    const QTextBlock first = document->findBlock(position);
+    QTextBlock last = document->findBlock(position + charsAdded);
+    if (!last.isValid())
+        last = document->lastBlock();
+
+    // Nothing is known past the frontier anyway
+    if (!first.isValid() || first.blockNumber() >= frontier)
+        return;
+
+    // Valid states after the edit moved with their blocks
+    frontier = qMax(frontier + delta, last.blockNumber() + 1);
+
+    if (last.blockNumber() - first.blockNumber() > MaxEagerBlocks)
+    {
+        frontier = first.blockNumber();
+        return;
+    }
+
+    const int bottom = lastVisibleBlock() + LookaheadBlocks;
+    for (QTextBlock block = first; block.isValid() && block.blockNumber() < frontier; block = block.next())
+    {
+        const int previous = block.userState();
+        const int state = highlightBlock(block, previousState(block));
+
+        if (block.blockNumber() < last.blockNumber())
+            continue;
+
+        // The next blocks start as before, their states still hold
+        if (state == previous)
+            return;
+
+        // Off screen, the rest waits for the lazy pass
+        if (block.blockNumber() >= bottom)
+        {
+            frontier = block.blockNumber() + 1;
+            return;
+        }
+    }
+}
+
+void SyntaxHighlighter::highlightVisibleBlocks()
+{
+    if (!currentLanguage)
+        return;
+
+    const QTextBlock top = textEditor->cursorForPosition(QPoint(0, 0)).block();
+    const int first = top.blockNumber();
+    const int last = lastVisibleBlock() + LookaheadBlocks;
+
+    // States of the blocks above the screen, without building any format
+    QTextBlock block = document->findBlockByNumber(frontier);
+    for (; block.isValid() && block.blockNumber() < first; block = block.next())
+        block.setUserState(currentLanguage->highlightLine(block.text(), previousState(block), nullptr));
+    frontier = qMax(frontier, first);
+
+    // Blocks on screen, unless their formats are up to date
+    for (block = top; block.isValid() && block.blockNumber() <= last; block = block.next())
+    {
+        const int startState = previousState(block);
+        const HighlightData *data = static_cast<HighlightData *>(block.userData());
+
+        if (block.blockNumber() >= frontier || !data || data->startState != startState
+            || data->revision != block.revision())
+            highlightBlock(block, startState);
+    }
+    frontier = qMax(frontier, qMin(last + 1, document->blockCount()));
+}
+
+int SyntaxHighlighter::highlightBlock(QTextBlock block, int startState)
+{
+    QList<SyntaxLanguage::Token> tokens;
+    const int endState = currentLanguage->highlightLine(block.text(), startState, &tokens);
+
+    QList<QTextLayout::FormatRange> ranges;
+    ranges.reserve(tokens.size());
+    for (const SyntaxLanguage::Token &token : tokens)
+        ranges.append(QTextLayout::FormatRange{ token.start, token.length, formats[token.category] });
+
+    HighlightData *data = static_cast<HighlightData *>(block.userData());
+    if (!data)
+    {
+        data = new HighlightData;
+        block.setUserData(data);
+    }
+    data->startState = startState;
+    data->revision = block.revision();
+    block.setUserState(endState);
+
+    // Relayout only when the formats really change
+    if (block.layout()->formats() != ranges)
+    {
+        formatting = true;
+        block.layout()->setFormats(ranges);
+        document->markContentsDirty(block.position(), block.length());
+        formatting = false;
+    }
+
+    return endState;
+}
@@ -0,0 +1,48 @@
+#ifndef SYNTAXHIGHLIGHTER_H
+#define SYNTAXHIGHLIGHTER_H
+
+#include <QObject>
+#include <QPlainTextEdit>
+#include <QTextBlock>
+#include <QTextCharFormat>
+#include <QTimer>
+
+#include "SyntaxLanguage.h"
+
+// Highlights an editor's document lazily: only blocks that reach the screen
+// get formats. The lexer state at the end of each block is cached in its
+// user state; blocks before 'frontier' have a valid one. An edit re-lexes
+// the changed blocks, then the following ones only while their end state
+// changes. Whatever lies past the screen is left for when it is scrolled to.
+class SyntaxHighlighter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SyntaxHighlighter(QPlainTextEdit *textEdit, QObject *parent = nullptr);
+
+    void setLanguage(const SyntaxLanguage *language); // nullptr for plain text
+    const SyntaxLanguage *language() const { return currentLanguage; }
+
+private slots:
+    void contentsChanged(int position, int charsRemoved, int charsAdded);
+    void highlightVisibleBlocks();
+
+private:
+    int highlightBlock(QTextBlock block, int startState);
+    void clearFormats();
+    void scheduleUpdate();
+    int lastVisibleBlock() const;
+    static int previousState(const QTextBlock &block);
+
+    QPlainTextEdit *textEditor;
+    QTextDocument *document;
+    const SyntaxLanguage *currentLanguage;
+    QTextCharFormat formats[SyntaxLanguage::CategoryCount];
+    QTimer *updateTimer;
+    int frontier;   // blocks before it have a valid end state
+    int blockCount; // at the last change, to follow block renumbering
+    bool formatting;
+};
+
+#endif // SYNTAXHIGHLIGHTER_H
@@ -0,0 +1,306 @@
+#include "SyntaxLanguage.h"
+#include <QFileInfo>
+
+// Keyword trie
+
+SyntaxLanguage::KeywordTrie::KeywordTrie()
+{
+    nodes.append(Node{ 0, -1, -1, -1 }); // root
+}
+
+void SyntaxLanguage::KeywordTrie::insert(QStringView word, int value)
+{
+    int node = 0;
+    for (QChar c : word)
+    {
+        int child = nodes.at(node).child;
+        while (child >= 0 && nodes.at(child).c != c.unicode())
+            child = nodes.at(child).sibling;
+
+        if (child < 0)
+        {
+            child = int(nodes.size());
+            nodes.append(Node{ c.unicode(), -1, nodes.at(node).child, -1 });
+            nodes[node].child = child;
+        }
+        node = child;
+    }
+    nodes[node].value = value;
+}
+
+int SyntaxLanguage::KeywordTrie::find(QStringView word) const
+{
+    int node = 0;
+    for (QChar c : word)
+    {
+        node = nodes.at(node).child;
+        while (node >= 0 && nodes.at(node).c != c.unicode())
+            node = nodes.at(node).sibling;
+        if (node < 0)
+            return -1;
+    }
+    return nodes.at(node).value;
+}
+
+// Lexer
+
+SyntaxLanguage::SyntaxLanguage(const Definition &definition)
+    : languageName(definition.name), fileExtensions(definition.extensions), hasWords(false)
+{
+    for (const QString &word : definition.keywords)
+        keywords.insert(word, Keyword);
+    for (const QString &word : definition.types)
+        keywords.insert(word, Type);
+
+    QStringList alternatives;
+    for (const Span &span : definition.spans)
+    {
+        alternatives.append(span.start);
+        spans.append(CompiledSpan{ span.category, QRegularExpression(span.end) });
+        spans.last().end.optimize();
+    }
+    for (const Rule &rule : definition.rules)
+    {
+        alternatives.append(rule.pattern);
+        rules.append(rule.category);
+    }
+    if (!definition.wordPattern.isEmpty())
+    {
+        alternatives.append(definition.wordPattern);
+        hasWords = true;
+    }
+
+    // Each alternative is a group of its own, which tells which one matched
+    QString pattern;
+    int group = 1;
+    for (const QString &alternative : alternatives)
+    {
+        if (!pattern.isEmpty())
+            pattern += '|';
+        pattern += '(' + alternative + ')';
+        alternativeGroups.append(group);
+        group += 1 + QRegularExpression(alternative).captureCount();
+    }
+
+    tokenPattern = QRegularExpression(pattern, QRegularExpression::MultilineOption);
+    tokenPattern.optimize();
+}
+
+int SyntaxLanguage::alternativeAt(const QRegularExpressionMatch &match) const
+{
+    for (int i = 0; i < alternativeGroups.size(); ++i)
+    {
+        if (match.capturedStart(alternativeGroups.at(i)) >= 0)
+            return i;
+    }
+    return -1;
+}
+
+int SyntaxLanguage::highlightLine(const QString &text, int state, QList<Token> *tokens) const
+{
+    const auto add = [tokens](qsizetype start, qsizetype end, Category category) {
+        if (tokens && end > start)
+            tokens->append(Token{ int(start), int(end - start), category });
+    };
+
+    qsizetype position = 0;
+
+    // Span left open by the previous line
+    if (state > 0 && state <= spans.size())
+    {
+        const CompiledSpan &span = spans.at(state - 1);
+        const QRegularExpressionMatch end = span.end.match(text);
+        if (!end.hasMatch())
+        {
+            add(0, text.size(), span.category);
+            return state;
+        }
+        add(0, end.capturedEnd(), span.category);
+        position = end.capturedEnd();
+    }
+
+    while (position < text.size())
+    {
+        const QRegularExpressionMatch match = tokenPattern.match(text, position);
+        if (!match.hasMatch())
+            break;
+
+        const int alternative = alternativeAt(match);
+        const qsizetype start = match.capturedStart();
+        qsizetype end = match.capturedEnd();
+
+        if (alternative < spans.size())
+        {
+            const CompiledSpan &span = spans.at(alternative);
+            const QRegularExpressionMatch close = span.end.match(text, end);
+            if (!close.hasMatch())
+            {
+                add(start, text.size(), span.category);
+                return alternative + 1;
+            }
+            end = close.capturedEnd();
+            add(start, end, span.category);
+        }
+        else if (alternative < spans.size() + rules.size())
+        {
+            add(start, end, rules.at(alternative - spans.size()));
+        }
+        else if (hasWords)
+        {
+            const int category = keywords.find(QStringView(text).mid(start, end - start));
+            if (category >= 0)
+                add(start, end, Category(category));
+        }
+
+        position = qMax(end, start + 1);
+    }
+
+    return 0;
+}
+
+// Languages
+
+static QList<SyntaxLanguage::Definition> definitions()
+{
+    using L = SyntaxLanguage;
+    const QString identifier = R"([A-Za-z_][A-Za-z0-9_]*)";
+    const QString number = R"(\b(?:0[xX][0-9a-fA-F']+|[0-9][0-9']*(?:\.[0-9]*)?(?:[eE][+-]?[0-9]+)?)[uUlLfF]*\b)";
+    const QString doubleQuoted = R"("(?:[^"\\]|\\.)*")";
+    const QString singleQuoted = R"('(?:[^'\\]|\\.)*')";
+
+    QList<SyntaxLanguage::Definition> languages;
+
+    languages.append(L::Definition{
+        "C++",
+        { "c", "cc", "cpp", "cxx", "h", "hh", "hpp", "hxx", "inl" },
+        { "alignas", "alignof", "asm", "auto", "break", "case", "catch", "class", "co_await", "co_return",
+          "co_yield", "concept", "const", "const_cast", "consteval", "constexpr", "constinit", "continue",
+          "decltype", "default", "delete", "do", "dynamic_cast", "else", "enum", "explicit", "export",
+          "extern", "false", "final", "for", "friend", "goto", "if", "inline", "mutable", "namespace",
+          "new", "noexcept", "nullptr", "operator", "override", "private", "protected", "public",
+          "register", "reinterpret_cast", "requires", "return", "signals", "slots", "sizeof", "static",
+          "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+          "throw", "true", "try", "typedef", "typeid", "typename", "union", "using", "virtual",
+          "volatile", "while", "emit" },
+        { "bool", "char", "char8_t", "char16_t", "char32_t", "double", "float", "int", "long", "short",
+          "signed", "unsigned", "void", "wchar_t", "size_t", "ptrdiff_t", "int8_t", "int16_t", "int32_t",
+          "int64_t", "uint8_t", "uint16_t", "uint32_t", "uint64_t", "qint64", "quint64", "qsizetype",
+          "QString", "QChar", "QList", "QObject", "QWidget" },
+        identifier,
+        { { L::Comment, R"(/\*)", R"(\*/)" } },
+        { { L::Preprocessor, R"(^\s*#\s*[A-Za-z_]+(?:\s*<[^>]*>)?)" },
+          { L::Comment, R"(//.*)" },
+          { L::String, R"re(R"\((?:[^)]|\)(?!"))*\)")re" },
+          { L::String, doubleQuoted },
+          { L::String, singleQuoted },
+          { L::Number, number } }
+    });
+
+    languages.append(L::Definition{
+        "Python",
+        { "py", "pyw", "pyi" },
+        { "False", "None", "True", "and", "as", "assert", "async", "await", "break", "class", "continue",
+          "def", "del", "elif", "else", "except", "finally", "for", "from", "global", "if", "import",
+          "in", "is", "lambda", "match", "case", "nonlocal", "not", "or", "pass", "raise", "return",
+          "try", "while", "with", "yield", "self" },
+        { "bool", "bytes", "dict", "float", "frozenset", "int", "list", "object", "set", "str", "tuple",
+          "type", "len", "print", "range", "open", "super", "isinstance", "enumerate", "zip" },
+        identifier,
+        { { L::String, R"([rRbBuUfF]{0,2}""")", R"(""")" },
+          { L::String, R"([rRbBuUfF]{0,2}''')", R"(''')" } },
+        { { L::Comment, R"(#.*)" },
+          { L::Preprocessor, R"(^\s*@[A-Za-z_][\w.]*)" },
+          { L::String, R"([rRbBuUfF]{0,2})" + doubleQuoted },
+          { L::String, R"([rRbBuUfF]{0,2})" + singleQuoted },
+          { L::Number, R"(\b(?:0[xXoObB][0-9a-fA-F_]+|[0-9][0-9_]*(?:\.[0-9_]*)?(?:[eE][+-]?[0-9]+)?j?)\b)" } }
+    });
+
+    languages.append(L::Definition{
+        "JavaScript",
+        { "js", "mjs", "cjs", "jsx", "ts", "tsx" },
+        { "async", "await", "break", "case", "catch", "class", "const", "continue", "debugger", "default",
+          "delete", "do", "else", "export", "extends", "false", "finally", "for", "from", "function", "if",
+          "import", "in", "instanceof", "let", "new", "null", "of", "return", "static", "super", "switch",
+          "this", "throw", "true", "try", "typeof", "undefined", "var", "void", "while", "with", "yield",
+          "interface", "type", "enum", "implements", "private", "public", "protected", "readonly" },
+        { "Array", "Boolean", "Date", "Error", "JSON", "Map", "Math", "Number", "Object", "Promise",
+          "RegExp", "Set", "String", "Symbol", "console", "document", "window", "number", "string",
+          "boolean", "any", "unknown", "never" },
+        R"([A-Za-z_$][A-Za-z0-9_$]*)",
+        { { L::Comment, R"(/\*)", R"(\*/)" },
+          { L::String, R"(`)", R"((?<!\\)`)" } },
+        { { L::Comment, R"(//.*)" },
+          { L::String, doubleQuoted },
+          { L::String, singleQuoted },
+          { L::Number, R"(\b(?:0[xXoObB][0-9a-fA-F_]+|[0-9][0-9_]*(?:\.[0-9_]*)?(?:[eE][+-]?[0-9]+)?n?)\b)" } }
+    });
+
+    languages.append(L::Definition{
+        "HTML",
+        { "html", "htm", "xhtml", "xml", "svg" },
+        {},
+        {},
+        QString(),
+        { { L::Comment, R"(<!--)", R"(-->)" } },
+        { { L::Preprocessor, R"(<![A-Za-z][^>]*>)" },
+          { L::Tag, R"(</?[A-Za-z][\w:-]*|/?>)" },
+          { L::Attribute, R"([A-Za-z_:][\w:.-]*(?=\s*=))" },
+          { L::String, R"("[^"]*"|'[^']*')" },
+          { L::Number, R"(&[#\w]+;)" } }
+    });
+
+    languages.append(L::Definition{
+        "CSS",
+        { "css", "scss", "less" },
+        { "!important", "inherit", "initial", "unset", "none", "auto", "solid", "dashed", "bold", "normal",
+          "block", "inline", "flex", "grid", "absolute", "relative", "fixed", "sticky", "hidden" },
+        {},
+        R"(!?[A-Za-z_-][A-Za-z0-9_-]*)",
+        { { L::Comment, R"(/\*)", R"(\*/)" } },
+        { { L::Preprocessor, R"(@[\w-]+)" },
+          { L::Attribute, R"([\w-]+(?=\s*:(?!:)))" },
+          { L::Tag, R"([.#][A-Za-z_-][\w-]*(?![^{]*;))" },
+          { L::String, doubleQuoted },
+          { L::String, singleQuoted },
+          { L::Number, R"(#[0-9a-fA-F]{3,8}\b|-?\b[0-9]+(?:\.[0-9]+)?(?:px|em|rem|%|vh|vw|pt|s|ms|deg|fr)?)" } }
+    });
+
+    languages.append(L::Definition{
+        "Markdown",
+        { "md", "markdown", "mdown", "mkd" },
+        {},
+        {},
+        QString(),
+        { { L::Code, R"(^\s*```)", R"(^\s*```)" } },
+        { { L::Heading, R"(^#{1,6}\s.*)" },
+          { L::Comment, R"(^\s*>.*)" },
+          { L::Keyword, R"(^\s*(?:[-*+]|\d+\.)(?=\s))" },
+          { L::Code, R"(`[^`]+`)" },
+          { L::Link, R"(!?\[[^\]]*\]\([^)]*\))" },
+          { L::Emphasis, R"(\*\*[^*]+\*\*|__[^_]+__|\*[^*\s][^*]*\*|\b_[^_\s][^_]*_\b)" } }
+    });
+
+    return languages;
+}
+
+const SyntaxLanguage *SyntaxLanguage::forFileName(const QString &fileName)
+{
+    // Compiled once, on first use
+    static const QList<SyntaxLanguage> languages = []() {
+        QList<SyntaxLanguage> compiled;
+        for (const Definition &definition : definitions())
+            compiled.append(SyntaxLanguage(definition));
+        return compiled;
+    }();
+
+    const QString extension = QFileInfo(fileName).suffix().toLower();
+    if (extension.isEmpty())
+        return nullptr;
+
+    for (const SyntaxLanguage &language : languages)
+    {
+        if (language.fileExtensions.contains(extension))
+            return &language;
+    }
+    return nullptr;
+}
@@ -0,0 +1,116 @@
+#ifndef SYNTAXLANGUAGE_H
+#define SYNTAXLANGUAGE_H
+
+#include <QString>
+#include <QStringList>
+#include <QList>
+#include <QRegularExpression>
+
+// Lexer of one language, built from a table of rules. A line is scanned
+// with a single combined regular expression; identifiers it finds are looked
+// up in a keyword trie. Constructs spanning lines (block comments, multi-line
+// strings, code fences) carry over through an integer state: 0 outside of
+// any, i + 1 inside the i-th span.
+class SyntaxLanguage
+{
+public:
+    enum Category
+    {
+        Keyword,
+        Type,
+        String,
+        Number,
+        Comment,
+        Preprocessor,
+        Tag,
+        Attribute,
+        Heading,
+        Emphasis,
+        Code,
+        Link,
+        CategoryCount
+    };
+
+    struct Rule
+    {
+        Category category;
+        QString pattern; // no capturing groups
+    };
+
+    struct Span
+    {
+        Category category;
+        QString start;
+        QString end;
+    };
+
+    struct Definition
+    {
+        QString name;
+        QStringList extensions;
+        QStringList keywords;
+        QStringList types;
+        QString wordPattern; // identifiers looked up in the keyword lists
+        QList<Span> spans;
+        QList<Rule> rules;
+    };
+
+    struct Token
+    {
+        int start;
+        int length;
+        Category category;
+    };
+
+    explicit SyntaxLanguage(const Definition &definition);
+
+    QString name() const { return languageName; }
+
+    // Lexes one line starting in 'state', returns the state at its end.
+    // 'tokens' may be null when only the state is needed.
+    int highlightLine(const QString &text, int state, QList<Token> *tokens) const;
+
+    // Language of a file from its extension, nullptr for plain text
+    static const SyntaxLanguage *forFileName(const QString &fileName);
+
+private:
+    // Keywords stored as a trie: a lookup walks the identifier once, without
+    // building a string for it
+    class KeywordTrie
+    {
+    public:
+        KeywordTrie();
+        void insert(QStringView word, int value);
+        int find(QStringView word) const; // -1 if absent
+
+    private:
+        struct Node
+        {
+            char16_t c;
+            int child;
+            int sibling;
+            int value;
+        };
+        QList<Node> nodes;
+    };
+
+    struct CompiledSpan
+    {
+        Category category;
+        QRegularExpression end;
+    };
+
+    int alternativeAt(const QRegularExpressionMatch &match) const;
+
+    QString languageName;
+    QStringList fileExtensions;
+    KeywordTrie keywords;
+    QList<CompiledSpan> spans;
+    QList<Category> rules;
+    bool hasWords;
+    // Span starts, then rules, then words, as one alternation
+    QRegularExpression tokenPattern;
+    QList<int> alternativeGroups; // capture group of each alternative
+};
+
+#endif // SYNTAXLANGUAGE_H
@@ -0,0 +1,136 @@
+#include "TextBuffer.h"
+#include "Trace.h"
+#include <QTextCursor>
+#include <utility>
+
+TextBuffer::TextBuffer(QTextDocument *document, QObject *parent)
+    : QObject(parent), document(document), tracking(true), batching(false)
+{
+    resetFromDocument();
+    connect(document, &QTextDocument::contentsChange, this, &TextBuffer::applyChange);
+}
+
+void TextBuffer::reset(const QSharedPointer<TextChunk> &original)
+{
+    const qsizetype previousLength = pieces.length();
+
+    pieces.reset(original);
+    tracking = true;
+
+    emit edited(0, previousLength, pieces.length());
+}
+
+void TextBuffer::resetFromDocument()
+{
+    reset(QSharedPointer<TextChunk>::create(document->toPlainText()));
+}
+
+QString TextBuffer::toPlainText(QString text)
+{
+    // Selections use Unicode separators where the document has line breaks
+    for (QChar &c : text)
+    {
+        if (c == QChar::ParagraphSeparator || c == QChar::LineSeparator)
+            c = u'\n';
+    }
+    return text;
+}
+
+void TextBuffer::beginEdits(const QList<Edit> &edits)
+{
+    pendingEdits.clear();
+    pendingEdits.reserve(edits.size());
+    for (const Edit &edit : edits)
+    {
+        // As the document stores them: CRLF and CR break lines like LF
+        QString text = edit.text;
+        text.replace(QLatin1String("\r\n"), QLatin1String("\n"));
+        text.replace(u'\r', u'\n');
+        pendingEdits.append(Edit{ edit.position, edit.removed, toPlainText(text) });
+    }
+}
+
+void TextBuffer::endEdits()
+{
+    // Edits that changed nothing don't report a change
+    pendingEdits.clear();
+}
+
+void TextBuffer::applyEdits(qsizetype documentLength)
+{
+    const QList<Edit> edits = std::exchange(pendingEdits, QList<Edit>());
+    const qsizetype previousLength = pieces.length();
+
+    batching = true;
+    for (const Edit &edit : edits)
+    {
+        pieces.remove(edit.position, edit.removed);
+        pieces.insert(edit.position, edit.text);
+        emit edited(edit.position, edit.removed, edit.text.size());
+    }
+    batching = false;
+
+    // Not what the document did after all: take its text as it is
+    if (pieces.length() != documentLength)
+    {
+        resetFromDocument();
+        return;
+    }
+
+    // From the first edit in the text to the end of the last
+    const qsizetype position = edits.last().position;
+    const qsizetype removed = edits.first().position + edits.first().removed - position;
+    emit batchEdited(position, removed, removed + pieces.length() - previousLength);
+}
+
+void TextBuffer::applyChange(int position, int charsRemoved, int charsAdded)
+{
+    if (!tracking)
+        return;
+    ScopedTrace trace(Trace::Edit);
+
+    // Ranges may include the document's implicit last paragraph separator
+    const qsizetype documentLength = document->characterCount() - 1;
+    if (!pendingEdits.isEmpty())
+    {
+        applyEdits(documentLength);
+        return;
+    }
+    const qsizetype removed = qBound(qsizetype(0), qsizetype(charsRemoved), pieces.length() - position);
+    const qsizetype added = qBound(qsizetype(0), qsizetype(charsAdded), documentLength - position);
+
+    QString inserted;
+    if (added > 0)
+    {
+        QTextCursor cursor(document);
+        cursor.setPosition(position);
+        cursor.setPosition(position + added, QTextCursor::KeepAnchor);
+        inserted = toPlainText(cursor.selectedText());
+    }
+
+    // Qt also reports text it didn't really change (format updates, block
+    // merges), only the part that differs goes to the piece table
+    qsizetype prefix = 0;
+    qsizetype suffix = 0;
+    if (removed > 0 && added > 0)
+    {
+        const QString previous = pieces.text(position, removed);
+        const qsizetype common = qMin(removed, added);
+        while (prefix < common && previous.at(prefix) == inserted.at(prefix))
+            ++prefix;
+        while (suffix < common - prefix && previous.at(removed - suffix - 1) == inserted.at(added - suffix - 1))
+            ++suffix;
+    }
+
+    const qsizetype removedChars = removed - prefix - suffix;
+    const qsizetype addedChars = added - prefix - suffix;
+    if (removedChars == 0 && addedChars == 0)
+        return;
+
+    pieces.remove(position + prefix, removedChars);
+    pieces.insert(position + prefix, QStringView(inserted).mid(prefix, addedChars));
+
+    Q_ASSERT(pieces.length() == documentLength);
+
+    emit edited(position + prefix, removedChars, addedChars);
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTBUFFER_H
+#define TEXTBUFFER_H
+
+#include <QObject>
+#include <QTextDocument>
+
+#include "PieceTable.h"
+
+// Plain-text model of an editor document. Every change of the QTextDocument
+// is replayed on a piece table, which gives the rest of the app O(1)
+// snapshots that can be read, searched or written out from other threads.
+// Edits made in one edit block of the document (one per caret) are reported
+// by it as a single change spanning them all; given the list beforehand,
+// the buffer still replays and reports them one by one.
+class TextBuffer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit TextBuffer(QTextDocument *document, QObject *parent = nullptr);
+
+    qsizetype length() const { return pieces.length(); }
+    quint64 hash() const { return pieces.hash(); } // TextHash of the whole text
+    const PieceTable &table() const { return pieces; }
+    TextSnapshot snapshot() const { return pieces.snapshot(); }
+    qint64 memoryUsed() const { return pieces.memoryUsed(); }
+
+    // Bulk loading bypasses change tracking and installs the text at the end
+    bool isTracking() const { return tracking; }
+    void setTracking(bool enabled) { tracking = enabled; }
+    void reset(const QSharedPointer<TextChunk> &original);
+    void resetFromDocument();
+
+    static QString toPlainText(QString text);
+
+    // Edits about to be made in one edit block, in the order they are made:
+    // from the last one in the text to the first, so that each position
+    // holds as given
+    struct Edit
+    {
+        qsizetype position;
+        qsizetype removed;
+        QString text;
+    };
+    void beginEdits(const QList<Edit> &edits);
+    void endEdits();
+    bool isBatching() const { return batching; } // edited() comes for each edit of a batch
+
+signals:
+    // The piece table changed: 'removed' characters at 'position' were
+    // replaced by 'added' ones (a reset replaces the whole text)
+    void edited(qsizetype position, qsizetype removed, qsizetype added);
+    // Once the edits of a batch were all edited(), the range they span; for
+    // views, which only need to know what to look at again
+    void batchEdited(qsizetype position, qsizetype removed, qsizetype added);
+
+private slots:
+    void applyChange(int position, int charsRemoved, int charsAdded);
+
+private:
+    void applyEdits(qsizetype documentLength);
+
+    QTextDocument *document;
+    PieceTable pieces;
+    bool tracking;
+    QList<Edit> pendingEdits;
+    bool batching;
+};
+
+#endif // TEXTBUFFER_H
@@ -0,0 +1,539 @@
+#include "TextEditor.h"
+#include "Trace.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QKeyEvent>
+#include <QMenu>
+#include <QPainter>
+#include <QTextBlock>
+#include <algorithm>
+
+TextEditor::TextEditor(QWidget *parent)
+    : QPlainTextEdit(parent), history(nullptr), textBuffer(nullptr), keystrokeStart(-1), applying(false), columnSelecting(false), columnMoved(false)
+{
+}
+
+void TextEditor::setTextBuffer(TextBuffer *buffer)
+{
+    textBuffer = buffer;
+    connect(buffer, &TextBuffer::edited, this, &TextEditor::bufferEdited);
+}
+
+void TextEditor::clearCarets()
+{
+    if (extraCarets.isEmpty())
+        return;
+    extraCarets.clear();
+    viewport()->update();
+}
+
+void TextEditor::keyPressEvent(QKeyEvent *event)
+{
+    if (history && (event->matches(QKeySequence::Undo) || event->matches(QKeySequence::Redo)))
+    {
+        if (isReadOnly())
+            return;
+        clearCarets();
+        if (event->matches(QKeySequence::Undo))
+            history->undo();
+        else
+            history->redo();
+        return;
+    }
+
+    // Only keys that type something are sure to repaint
+    if (keystrokeStart < 0 && !event->text().isEmpty())
+        keystrokeStart = Trace::begin();
+
+    // Adding carets
+    const Qt::KeyboardModifiers modifiers = event->modifiers() & ~Qt::KeypadModifier;
+    if (modifiers == (Qt::ControlModifier | Qt::AltModifier) && (event->key() == Qt::Key_Up || event->key() == Qt::Key_Down))
+    {
+        addCaretOnLine(event->key() == Qt::Key_Down);
+        return;
+    }
+    if (modifiers == (Qt::ShiftModifier | Qt::AltModifier) && event->key() == Qt::Key_I)
+    {
+        addCaretsAtLineEnds();
+        return;
+    }
+
+    if (!extraCarets.isEmpty() && !isReadOnly())
+    {
+        if (multiCaretKey(event))
+            return;
+        // Anything else is for the text cursor alone
+        if (event->key() != Qt::Key_Shift && event->key() != Qt::Key_Control && event->key() != Qt::Key_Alt
+            && event->key() != Qt::Key_Meta)
+            clearCarets();
+    }
+
+    QPlainTextEdit::keyPressEvent(event);
+}
+
+bool TextEditor::multiCaretKey(QKeyEvent *event)
+{
+    qsizetype primary = 0;
+    const QList<Caret> all = carets(&primary);
+    QList<Edit> edits;
+    edits.reserve(all.size());
+
+    if (event->key() == Qt::Key_Escape)
+    {
+        clearCarets();
+        return true;
+    }
+
+    if (event->matches(QKeySequence::Copy) || event->matches(QKeySequence::Cut))
+    {
+        // The selections, a line each
+        QStringList selections;
+        for (const Caret &caret : all)
+        {
+            if (caret.anchor == caret.position)
+                continue;
+            QTextCursor cursor(document());
+            cursor.setPosition(int(caret.start()));
+            cursor.setPosition(int(caret.end()), QTextCursor::KeepAnchor);
+            selections.append(TextBuffer::toPlainText(cursor.selectedText()));
+        }
+        if (!selections.isEmpty())
+            QApplication::clipboard()->setText(selections.join(u'\n'));
+
+        if (event->matches(QKeySequence::Cut))
+        {
+            for (const Caret &caret : all)
+                edits.append(Edit{ caret.start(), caret.end(), QString() });
+            applyEdits(edits, primary);
+        }
+        return true;
+    }
+
+    if (event->matches(QKeySequence::Paste))
+    {
+        // As many lines as carets go one to each, else all of it to all
+        QString text = QApplication::clipboard()->text();
+        text.replace("\r\n", "\n");
+        QStringList lines = text.split(u'\n');
+        if (lines.size() == all.size() + 1 && lines.last().isEmpty())
+            lines.removeLast();
+        const bool distribute = lines.size() == all.size();
+        for (qsizetype i = 0; i < all.size(); ++i)
+            edits.append(Edit{ all.at(i).start(), all.at(i).end(), distribute ? lines.at(i) : text });
+        applyEdits(edits, primary);
+        return true;
+    }
+
+    const Qt::KeyboardModifiers modifiers = event->modifiers() & ~Qt::KeypadModifier;
+    switch (event->key())
+    {
+    case Qt::Key_Backspace:
+    case Qt::Key_Delete:
+        if (modifiers != Qt::NoModifier)
+            return false;
+        for (const Caret &caret : all)
+        {
+            if (caret.anchor != caret.position)
+                edits.append(Edit{ caret.start(), caret.end(), QString() });
+            else if (event->key() == Qt::Key_Backspace)
+                edits.append(Edit{ qMax(qsizetype(0), caret.position - 1), caret.position, QString() });
+            else
+                edits.append(Edit{ caret.position, qMin(documentLength(), caret.position + 1), QString() });
+        }
+        applyEdits(edits, primary);
+        return true;
+
+    case Qt::Key_Return:
+    case Qt::Key_Enter:
+        for (const Caret &caret : all)
+            edits.append(Edit{ caret.start(), caret.end(), QString("\n") });
+        applyEdits(edits, primary);
+        return true;
+
+    case Qt::Key_Left:
+    case Qt::Key_Right:
+    case Qt::Key_Up:
+    case Qt::Key_Down:
+    case Qt::Key_Home:
+    case Qt::Key_End:
+        if (modifiers != Qt::NoModifier && modifiers != Qt::ShiftModifier)
+            return false;
+        moveCarets(event->key(), modifiers == Qt::ShiftModifier);
+        return true;
+
+    default:
+        break;
+    }
+
+    // Typed characters
+    const QString text = event->text();
+    if (text.isEmpty() || (modifiers & (Qt::ControlModifier | Qt::AltModifier | Qt::MetaModifier))
+        || !(text.at(0).isPrint() || text == "\t"))
+        return false;
+
+    for (const Caret &caret : all)
+        edits.append(Edit{ caret.start(), caret.end(), text });
+    applyEdits(edits, primary);
+    return true;
+}
+
+QList<TextEditor::Caret> TextEditor::carets(qsizetype *primary) const
+{
+    const QTextCursor cursor = textCursor();
+    const Caret main{ cursor.anchor(), cursor.position() };
+
+    QList<Caret> all = extraCarets;
+    const auto at = std::lower_bound(all.begin(), all.end(), main.start(),
+                                     [](const Caret &caret, qsizetype start) { return caret.start() < start; });
+    *primary = at - all.begin();
+    all.insert(*primary, main);
+    return all;
+}
+
+void TextEditor::setCarets(QList<Caret> all, qsizetype primary)
+{
+    // In order, carets on the same place or selections that overlap become one
+    QList<qsizetype> order(all.size());
+    for (qsizetype i = 0; i < order.size(); ++i)
+        order[i] = i;
+    std::stable_sort(order.begin(), order.end(), [&all](qsizetype a, qsizetype b) { return all.at(a).start() < all.at(b).start(); });
+
+    QList<Caret> merged;
+    merged.reserve(all.size());
+    qsizetype mergedPrimary = 0;
+    for (qsizetype index : std::as_const(order))
+    {
+        const Caret &caret = all.at(index);
+        if (!merged.isEmpty() && (caret.start() < merged.last().end() || caret.start() == merged.last().start()))
+        {
+            Caret &last = merged.last();
+            if (caret.end() > last.end())
+                last = Caret{ last.start(), caret.end() };
+        }
+        else
+            merged.append(caret);
+        if (index == primary)
+            mergedPrimary = merged.size() - 1;
+    }
+
+    const Caret main = merged.takeAt(mergedPrimary);
+    extraCarets = merged;
+
+    QTextCursor cursor = textCursor();
+    cursor.setPosition(int(main.anchor));
+    cursor.setPosition(int(main.position), QTextCursor::KeepAnchor);
+    setTextCursor(cursor);
+    viewport()->update();
+}
+
+void TextEditor::applyEdits(QList<Edit> edits, qsizetype primary)
+{
+    // A deletion next to a selection may reach into it
+    qsizetype previousEnd = 0;
+    for (Edit &edit : edits)
+    {
+        edit.start = qMax(edit.start, previousEnd);
+        edit.end = qMax(edit.end, edit.start);
+        previousEnd = edit.end;
+    }
+
+    // From the last one, so the positions of the others hold, in one edit
+    // block: a single layout update. The document reports the block as one
+    // change from the first caret to the last, so the buffer is told the
+    // edits first and replays them one by one; one step of the history
+    // undoes them all.
+    QList<TextBuffer::Edit> changes;
+    changes.reserve(edits.size());
+    for (qsizetype i = edits.size(); i-- > 0;)
+    {
+        const Edit &edit = edits.at(i);
+        if (edit.start != edit.end || !edit.text.isEmpty())
+            changes.append(TextBuffer::Edit{ edit.start, edit.end - edit.start, edit.text });
+    }
+
+    applying = true;
+    if (history)
+        history->beginGroup();
+    if (textBuffer)
+        textBuffer->beginEdits(changes);
+    QTextCursor cursor(document());
+    cursor.beginEditBlock();
+    for (const TextBuffer::Edit &change : std::as_const(changes))
+    {
+        cursor.setPosition(int(change.position));
+        cursor.setPosition(int(change.position + change.removed), QTextCursor::KeepAnchor);
+        if (change.text.isEmpty())
+            cursor.removeSelectedText();
+        else
+            cursor.insertText(change.text);
+    }
+    cursor.endEditBlock();
+    if (textBuffer)
+        textBuffer->endEdits();
+    if (history)
+        history->endGroup();
+    applying = false;
+
+    // Each caret after its text, moved by what the edits before it changed
+    QList<Caret> moved;
+    moved.reserve(edits.size());
+    qsizetype delta = 0;
+    for (const Edit &edit : edits)
+    {
+        const qsizetype position = edit.start + delta + edit.text.size();
+        moved.append(Caret{ position, position });
+        delta += edit.text.size() - (edit.end - edit.start);
+    }
+    setCarets(moved, primary);
+}
+
+void TextEditor::moveCarets(int key, bool select)
+{
+    qsizetype primary = 0;
+    QList<Caret> all = carets(&primary);
+    const qsizetype length = documentLength();
+
+    for (Caret &caret : all)
+    {
+        const bool selection = caret.anchor != caret.position;
+        const QTextBlock block = document()->findBlock(int(caret.position));
+        qsizetype position = caret.position;
+
+        switch (key)
+        {
+        case Qt::Key_Left:
+            position = selection && !select ? caret.start() : qMax(qsizetype(0), position - 1);
+            break;
+        case Qt::Key_Right:
+            position = selection && !select ? caret.end() : qMin(length, position + 1);
+            break;
+        case Qt::Key_Home:
+            position = block.position();
+            break;
+        case Qt::Key_End:
+            position = block.position() + block.length() - 1;
+            break;
+        default:
+        {
+            // Same column on the next or previous line, or its end
+            const QTextBlock target = key == Qt::Key_Down ? block.next() : block.previous();
+            if (target.isValid())
+                position = target.position() + qMin(position - block.position(), qsizetype(target.length() - 1));
+            break;
+        }
+        }
+
+        caret = Caret{ select ? caret.anchor : position, position };
+    }
+    setCarets(all, primary);
+}
+
+void TextEditor::addCaretOnLine(bool below)
+{
+    qsizetype primary = 0;
+    QList<Caret> all = carets(&primary);
+
+    // From the caret furthest in that direction
+    const Caret &edge = below ? all.last() : all.first();
+    const QTextBlock block = document()->findBlock(int(edge.position));
+    const QTextBlock target = below ? block.next() : block.previous();
+    if (!target.isValid())
+        return;
+
+    const qsizetype position = target.position() + qMin(edge.position - block.position(), qsizetype(target.length() - 1));
+    all.append(Caret{ position, position });
+    setCarets(all, all.size() - 1);
+}
+
+void TextEditor::addCaretsAtLineEnds()
+{
+    const QTextCursor cursor = textCursor();
+    if (!cursor.hasSelection())
+        return;
+
+    // A selection ending at the start of a line leaves that line out
+    QTextBlock block = document()->findBlock(cursor.selectionStart());
+    const QTextBlock last = document()->findBlock(cursor.selectionEnd());
+    const bool lastIncluded = cursor.selectionEnd() > last.position() || block == last;
+
+    QList<Caret> all;
+    while (block.isValid() && (block.blockNumber() < last.blockNumber() || (block == last && lastIncluded)))
+    {
+        const qsizetype position = block.position() + block.length() - 1;
+        all.append(Caret{ position, position });
+        block = block.next();
+    }
+    if (!all.isEmpty())
+        setCarets(all, all.size() - 1);
+}
+
+void TextEditor::selectColumns(const QPoint &from, const QPoint &to)
+{
+    const QTextCursor start = cursorForPosition(from);
+    const QTextCursor end = cursorForPosition(to);
+    const int firstLine = qMin(start.blockNumber(), end.blockNumber());
+    const int lastLine = qMax(start.blockNumber(), end.blockNumber());
+    const qsizetype anchorColumn = start.positionInBlock();
+    const qsizetype column = end.positionInBlock();
+
+    // A caret a line, selecting the same columns, short lines up to their end
+    QList<Caret> all;
+    all.reserve(lastLine - firstLine + 1);
+    qsizetype primary = 0;
+    for (QTextBlock block = document()->findBlockByNumber(firstLine); block.isValid() && block.blockNumber() <= lastLine;
+         block = block.next())
+    {
+        const qsizetype lineEnd = block.length() - 1;
+        if (block.blockNumber() == end.blockNumber())
+            primary = all.size();
+        all.append(Caret{ block.position() + qMin(anchorColumn, lineEnd), block.position() + qMin(column, lineEnd) });
+    }
+    setCarets(all, primary);
+}
+
+void TextEditor::bufferEdited(qsizetype position, qsizetype removed, qsizetype added)
+{
+    if (applying || extraCarets.isEmpty())
+        return;
+
+    // Another edit: the carets after it move, the ones inside go to its end
+    const auto shift = [&](qsizetype offset) {
+        if (offset <= position)
+            return offset;
+        return offset >= position + removed ? offset + added - removed : position + added;
+    };
+    for (Caret &caret : extraCarets)
+        caret = Caret{ shift(caret.anchor), shift(caret.position) };
+
+    // The order holds, some may now be on the same place
+    const auto last = std::unique(extraCarets.begin(), extraCarets.end(), [](const Caret &a, const Caret &b) {
+        return a.start() == b.start() && a.end() == b.end();
+    });
+    extraCarets.erase(last, extraCarets.end());
+    viewport()->update();
+}
+
+void TextEditor::paintEvent(QPaintEvent *event)
+{
+    {
+        ScopedTrace trace(Trace::Layout);
+        QPlainTextEdit::paintEvent(event);
+    }
+
+    // The other carets and their selections, only the ones on screen
+    if (!extraCarets.isEmpty())
+    {
+        QPainter painter(viewport());
+        const qsizetype first = firstVisibleBlock().position();
+        const QTextBlock lastBlock = cursorForPosition(viewport()->rect().bottomRight()).block();
+        const qsizetype last = lastBlock.position() + lastBlock.length() - 1;
+        QColor selectionColor = palette().color(QPalette::Highlight);
+        selectionColor.setAlpha(110);
+        const QColor caretColor = palette().color(QPalette::Text);
+        const int width = viewport()->width();
+
+        auto caret = std::lower_bound(extraCarets.cbegin(), extraCarets.cend(), first,
+                                      [](const Caret &caret, qsizetype offset) { return caret.end() < offset; });
+        for (; caret != extraCarets.cend() && caret->start() <= last; ++caret)
+        {
+            QTextCursor cursor(document());
+            if (caret->anchor != caret->position)
+            {
+                cursor.setPosition(int(qMax(caret->start(), first)));
+                const QRect from = cursorRect(cursor);
+                cursor.setPosition(int(qMin(caret->end(), last)));
+                const QRect to = cursorRect(cursor);
+                if (from.top() == to.top())
+                    painter.fillRect(QRect(from.topLeft(), QPoint(to.left(), from.bottom())), selectionColor);
+                else
+                {
+                    painter.fillRect(QRect(from.topLeft(), QPoint(width, from.bottom())), selectionColor);
+                    painter.fillRect(QRect(QPoint(0, from.bottom() + 1), QPoint(width, to.top() - 1)), selectionColor);
+                    painter.fillRect(QRect(QPoint(0, to.top()), QPoint(to.left(), to.bottom())), selectionColor);
+                }
+            }
+
+            cursor.setPosition(int(caret->position));
+            const QRect rect = cursorRect(cursor);
+            painter.fillRect(rect.x(), rect.y(), 2, rect.height(), caretColor);
+        }
+    }
+
+    if (keystrokeStart >= 0)
+    {
+        Trace::end(Trace::Keystroke, keystrokeStart);
+        keystrokeStart = -1;
+    }
+}
+
+void TextEditor::mousePressEvent(QMouseEvent *event)
+{
+    // Alt+click adds a caret, Alt+drag selects columns
+    if (event->button() == Qt::LeftButton && (event->modifiers() & Qt::AltModifier))
+    {
+        columnStart = event->position().toPoint();
+        columnSelecting = true;
+        columnMoved = false;
+        event->accept();
+        return;
+    }
+
+    clearCarets();
+    QPlainTextEdit::mousePressEvent(event);
+}
+
+void TextEditor::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!columnSelecting)
+    {
+        QPlainTextEdit::mouseMoveEvent(event);
+        return;
+    }
+
+    const QPoint position = event->position().toPoint();
+    if ((position - columnStart).manhattanLength() >= QApplication::startDragDistance())
+        columnMoved = true;
+    if (columnMoved)
+        selectColumns(columnStart, position);
+}
+
+void TextEditor::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (!columnSelecting)
+    {
+        QPlainTextEdit::mouseReleaseEvent(event);
+        return;
+    }
+
+    columnSelecting = false;
+    if (columnMoved)
+        return;
+
+    qsizetype primary = 0;
+    QList<Caret> all = carets(&primary);
+    const qsizetype position = cursorForPosition(columnStart).position();
+    all.append(Caret{ position, position });
+    setCarets(all, all.size() - 1);
+}
+
+void TextEditor::contextMenuEvent(QContextMenuEvent *event)
+{
+    QMenu *menu = createStandardContextMenu(event->pos());
+
+    // The standard entries would use the document's own, disabled, stack
+    if (history && !isReadOnly())
+    {
+        for (QAction *action : menu->actions())
+        {
+            const bool undo = action->objectName() == "edit-undo";
+            if (!undo && action->objectName() != "edit-redo")
+                continue;
+            action->disconnect();
+            action->setEnabled(undo ? history->canUndo() : history->canRedo());
+            connect(action, &QAction::triggered, history, undo ? &UndoHistory::undo : &UndoHistory::redo);
+        }
+    }
+
+    menu->exec(event->globalPos());
+    delete menu;
+}
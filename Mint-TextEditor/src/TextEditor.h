@@ -0,0 +1,83 @@
+#ifndef TEXTEDITOR_H
+#define TEXTEDITOR_H
+
+#include <QPlainTextEdit>
+
+#include "TextBuffer.h"
+#include "UndoHistory.h"
+
+// The editor of a tab. It times its own painting (which lays out the
+// visible blocks) and how long a key press takes to show on screen. Undo
+// and redo, from the keyboard or the context menu, go to the tab's history.
+//
+// Besides its text cursor it can hold more carets: Alt+click adds one,
+// Ctrl+Alt+Up/Down one on the line above or below, Shift+Alt+I one at the
+// end of each selected line, and Alt+drag selects a rectangle, a caret a
+// line. Typing, deleting, cutting and pasting then apply to every caret
+// in one edit block, so the document is laid out once. The buffer replays
+// the edits one by one and views update once for the batch; the history
+// groups them into a single undo step. The carets move by the running
+// offset of the edits before them in one sorted pass.
+// Escape, or a click, goes back to the text cursor alone.
+class TextEditor : public QPlainTextEdit
+{
+    Q_OBJECT
+
+public:
+    explicit TextEditor(QWidget *parent = nullptr);
+
+    void setUndoHistory(UndoHistory *undoHistory) { history = undoHistory; }
+    // Told about multi-caret edits beforehand, and keeps the carets in step with other edits
+    void setTextBuffer(TextBuffer *buffer);
+
+    qsizetype caretCount() const { return extraCarets.size() + 1; }
+    void clearCarets();
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+
+private:
+    struct Caret
+    {
+        qsizetype anchor;
+        qsizetype position;
+        qsizetype start() const { return qMin(anchor, position); }
+        qsizetype end() const { return qMax(anchor, position); }
+    };
+
+    struct Edit
+    {
+        qsizetype start;
+        qsizetype end;
+        QString text;
+    };
+
+    bool multiCaretKey(QKeyEvent *event); // false when not handled
+    QList<Caret> carets(qsizetype *primary) const; // all of them in order, the text cursor's index
+    void setCarets(QList<Caret> carets, qsizetype primary);
+    void applyEdits(QList<Edit> edits, qsizetype primary);
+    void moveCarets(int key, bool select);
+    void addCaretOnLine(bool below);
+    void addCaretsAtLineEnds();
+    void selectColumns(const QPoint &from, const QPoint &to);
+    void bufferEdited(qsizetype position, qsizetype removed, qsizetype added);
+    qsizetype documentLength() const { return document()->characterCount() - 1; }
+
+    UndoHistory *history;
+    TextBuffer *textBuffer;
+    qint64 keystrokeStart; // -1 when no key press waits for a paint
+
+    QList<Caret> extraCarets; // sorted and apart, without the text cursor
+    bool applying;
+    // Alt+drag: where it started, and whether it moved
+    QPoint columnStart;
+    bool columnSelecting;
+    bool columnMoved;
+};
+
+#endif // TEXTEDITOR_H
@@ -0,0 +1,194 @@
+#include "TextFormat.h"
+#include "Simd.h"
+#include <cstring>
+
+static const qsizetype BlockSize = 16;
+
+#ifdef MINT_SSE2
+static inline quint32 highBitMask(const char *data)
+{
+    return quint32(_mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data))));
+}
+
+static inline quint32 carriageReturnMask(const char *data)
+{
+    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data));
+    return quint32(_mm_movemask_epi8(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+}
+#else
+static inline quint32 highBitMask(const char *data)
+{
+    quint32 mask = 0;
+    for (qsizetype i = 0; i < BlockSize; ++i)
+        mask |= quint32(uchar(data[i]) >> 7) << i;
+    return mask;
+}
+
+static inline quint32 carriageReturnMask(const char *data)
+{
+    quint32 mask = 0;
+    for (qsizetype i = 0; i < BlockSize; ++i)
+        mask |= quint32(data[i] == '\r') << i;
+    return mask;
+}
+#endif
+
+QString TextFormat::name() const
+{
+    static const char *const endings[] = { "LF", "CRLF", "CR" };
+    return QString("%1%2 (%3)").arg(QString::fromLatin1(QStringConverter::nameForEncoding(encoding)),
+                                     bom ? QString(" BOM") : QString(), QString::fromLatin1(endings[lineEnding]));
+}
+
+QByteArray TextFormat::bomBytes() const
+{
+    if (!bom)
+        return QByteArray();
+
+    switch (encoding)
+    {
+        case QStringConverter::Utf8: return QByteArray("\xEF\xBB\xBF", 3);
+        case QStringConverter::Utf16LE: return QByteArray("\xFF\xFE", 2);
+        case QStringConverter::Utf16BE: return QByteArray("\xFE\xFF", 2);
+        case QStringConverter::Utf32LE: return QByteArray("\xFF\xFE\0\0", 4);
+        case QStringConverter::Utf32BE: return QByteArray("\0\0\xFE\xFF", 4);
+        default: return QByteArray();
+    }
+}
+
+const char *TextFormat::lineEndingBytes() const
+{
+    return lineEnding == CRLF ? "\r\n" : lineEnding == CR ? "\r" : "\n";
+}
+
+TextFormat::LineEnding TextFormat::nativeLineEnding()
+{
+#ifdef Q_OS_WIN
+    return CRLF;
+#else
+    return LF;
+#endif
+}
+
+bool TextFormat::isDirectText(QByteArrayView data, bool latin1)
+{
+    const char *bytes = data.data();
+    const qsizetype size = data.size();
+
+    qsizetype i = 0;
+    for (; i + BlockSize <= size; i += BlockSize)
+    {
+        if (carriageReturnMask(bytes + i) || (!latin1 && highBitMask(bytes + i)))
+            return false;
+    }
+    for (; i < size; ++i)
+    {
+        if (bytes[i] == '\r' || (!latin1 && (bytes[i] & 0x80)))
+            return false;
+    }
+    return true;
+}
+
+bool TextFormat::isAscii(QByteArrayView data)
+{
+    const char *bytes = data.data();
+    const qsizetype size = data.size();
+
+    qsizetype i = 0;
+    for (; i + BlockSize <= size; i += BlockSize)
+    {
+        if (highBitMask(bytes + i))
+            return false;
+    }
+    for (; i < size; ++i)
+    {
+        if (bytes[i] & 0x80)
+            return false;
+    }
+    return true;
+}
+
+// Length of the sequence starting at 'data', 0 if it is invalid, -1 if the
+// 'size' bytes available are a valid start of one
+static int sequenceLength(const uchar *data, qsizetype size)
+{
+    const uchar lead = data[0];
+    int length;
+    uchar low = 0x80;
+    uchar high = 0xBF;
+
+    if (lead < 0x80)
+        return 1;
+    if (lead >= 0xC2 && lead <= 0xDF)
+        length = 2;
+    else if (lead == 0xE0)
+        length = 3, low = 0xA0; // overlong
+    else if (lead == 0xED)
+        length = 3, high = 0x9F; // surrogates
+    else if (lead >= 0xE1 && lead <= 0xEF)
+        length = 3;
+    else if (lead == 0xF0)
+        length = 4, low = 0x90; // overlong
+    else if (lead == 0xF4)
+        length = 4, high = 0x8F; // past U+10FFFF
+    else if (lead >= 0xF1 && lead <= 0xF3)
+        length = 4;
+    else
+        return 0;
+
+    for (int i = 1; i < length; ++i)
+    {
+        if (i >= size)
+            return -1;
+        const uchar byte = data[i];
+        if (i == 1 ? (byte < low || byte > high) : (byte < 0x80 || byte > 0xBF))
+            return 0;
+    }
+    return length;
+}
+
+bool Utf8Validator::append(QByteArrayView data)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data.data());
+    const qsizetype size = data.size();
+    qsizetype i = 0;
+
+    // A sequence cut by the previous call
+    while (valid && pendingSize > 0 && i < size)
+    {
+        pending[pendingSize++] = bytes[i++];
+        const int length = sequenceLength(pending, pendingSize);
+        if (length == 0)
+            valid = false;
+        else if (length > 0)
+            pendingSize = 0;
+    }
+
+    while (valid && i < size)
+    {
+        if (i + BlockSize <= size && !highBitMask(reinterpret_cast<const char *>(bytes + i)))
+        {
+            i += BlockSize;
+            continue;
+        }
+        if (bytes[i] < 0x80)
+        {
+            ++i;
+            continue;
+        }
+
+        const int length = sequenceLength(bytes + i, size - i);
+        if (length == 0)
+            valid = false;
+        else if (length < 0)
+        {
+            pendingSize = int(size - i);
+            std::memcpy(pending, bytes + i, size_t(pendingSize));
+            break;
+        }
+        else
+            i += length;
+    }
+
+    return valid;
+}
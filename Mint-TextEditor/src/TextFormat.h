@@ -0,0 +1,52 @@
+#ifndef TEXTFORMAT_H
+#define TEXTFORMAT_H
+
+#include <QString>
+#include <QByteArrayView>
+#include <QStringConverter>
+
+// How a document is stored on disk: encoding, byte order mark and line
+// endings. The editor always works with '\n', the file gets its own style
+// back when saved, so an unedited document is written out byte for byte.
+struct TextFormat
+{
+    enum LineEnding
+    {
+        LF,
+        CRLF,
+        CR
+    };
+
+    QStringConverter::Encoding encoding = QStringConverter::Utf8;
+    bool bom = false;
+    LineEnding lineEnding = nativeLineEnding();
+
+    QString name() const; // "UTF-8 (CRLF)"
+    QByteArray bomBytes() const;
+    const char *lineEndingBytes() const;
+
+    static LineEnding nativeLineEnding();
+
+    // Bytes that are their own characters in the editor, with no conversion:
+    // no CR, and only ASCII unless the file is Latin-1
+    static bool isDirectText(QByteArrayView data, bool latin1);
+    static bool isAscii(QByteArrayView data);
+};
+
+// Incremental UTF-8 validation (well-formed sequences only: no overlongs,
+// surrogates or code points past U+10FFFF). ASCII runs are skipped 16 bytes
+// at a time with SSE2 where available.
+class Utf8Validator
+{
+public:
+    bool append(QByteArrayView data); // false once anything invalid was seen
+    bool isValid() const { return valid && pendingSize == 0; } // so far, with no cut sequence
+    bool isComplete() const { return pendingSize == 0; }
+
+private:
+    uchar pending[4] = {};
+    int pendingSize = 0;
+    bool valid = true;
+};
+
+#endif // TEXTFORMAT_H
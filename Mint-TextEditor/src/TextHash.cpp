@@ -0,0 +1,106 @@
+#include "TextHash.h"
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+static const quint64 Modulus = (quint64(1) << 61) - 1;
+static const quint64 Base = 0x1B873593A2C4E6B5ull % Modulus;
+
+static inline quint64 reduce(quint64 value)
+{
+    value = (value & Modulus) + (value >> 61);
+    return value >= Modulus ? value - Modulus : value;
+}
+
+static inline quint64 multiply(quint64 a, quint64 b)
+{
+    // 2^61 = 1 modulo 2^61 - 1, the high bits fold back onto the low ones
+#if defined(_MSC_VER) && !defined(__clang__)
+    const quint64 low = a * b;
+    const quint64 high = __umulh(a, b);
+#else
+    const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    const quint64 low = quint64(product);
+    const quint64 high = quint64(product >> 64);
+#endif
+    return reduce((low & Modulus) + ((low >> 61) | (high << 3)));
+}
+
+template <typename Char>
+static inline quint64 extendHash(quint64 hash, const Char *data, qsizetype size)
+{
+    // Characters count from 1, a leading NUL still changes the hash
+    for (qsizetype i = 0; i < size; ++i)
+        hash = reduce(multiply(hash, Base) + quint64(data[i]) + 1);
+    return hash;
+}
+
+quint64 TextHash::power(qsizetype length)
+{
+    quint64 result = 1;
+    quint64 factor = Base;
+    for (quint64 n = quint64(length); n; n >>= 1)
+    {
+        if (n & 1)
+            result = multiply(result, factor);
+        factor = multiply(factor, factor);
+    }
+    return result;
+}
+
+quint64 TextHash::product(quint64 firstPower, quint64 secondPower)
+{
+    return multiply(firstPower, secondPower);
+}
+
+quint64 TextHash::concat(quint64 first, quint64 second, quint64 secondPower)
+{
+    return reduce(multiply(first, secondPower) + second);
+}
+
+quint64 TextHash::difference(quint64 prefix, quint64 shorterPrefix, quint64 lengthPower)
+{
+    const quint64 shifted = multiply(shorterPrefix, lengthPower);
+    return prefix >= shifted ? prefix - shifted : prefix + Modulus - shifted;
+}
+
+quint64 TextHash::extend(quint64 hash, const char *data, qsizetype size)
+{
+    return extendHash(hash, reinterpret_cast<const uchar *>(data), size);
+}
+
+quint64 TextHash::extend(quint64 hash, const QChar *data, qsizetype size)
+{
+    return extendHash(hash, reinterpret_cast<const char16_t *>(data), size);
+}
+
+template <typename Char>
+void TextHash::Sampler::sample(const Char *data, qsizetype size)
+{
+    while (size > 0)
+    {
+        const qsizetype step = qMin(size, SampleInterval - count % SampleInterval);
+        running = extend(running, data, step);
+        count += step;
+        data += step;
+        size -= step;
+
+        if (count % SampleInterval == 0)
+        {
+            // The prefix so far: the previous one shifted, plus the block
+            static const quint64 samplePower = power(SampleInterval);
+            samples.append(concat(samples.last(), running, samplePower));
+            running = 0;
+        }
+    }
+}
+
+void TextHash::Sampler::append(const char *data, qsizetype size)
+{
+    sample(data, size);
+}
+
+void TextHash::Sampler::append(const QChar *data, qsizetype size)
+{
+    sample(data, size);
+}
@@ -0,0 +1,49 @@
+#ifndef TEXTHASH_H
+#define TEXTHASH_H
+
+#include <QChar>
+#include <QList>
+
+// Polynomial hash of text modulo 2^61 - 1. The hash of two concatenated
+// texts only takes their hashes and the length of the second one, so the
+// piece table keeps the hash of the whole text up to date from the hashes
+// of its pieces, and the hash of any part of a chunk comes from the prefix
+// hashes it samples every SampleInterval characters.
+class TextHash
+{
+public:
+    static const qsizetype SampleInterval = 64;
+
+    static quint64 power(qsizetype length); // multiplier shifting a hash by 'length' characters
+    static quint64 product(quint64 firstPower, quint64 secondPower); // power of the summed lengths
+    static quint64 concat(quint64 first, quint64 second, quint64 secondPower);
+    // Hash of the characters between two prefixes 'length' characters apart
+    static quint64 difference(quint64 prefix, quint64 shorterPrefix, quint64 lengthPower);
+
+    // Hash of the text extended with 'size' characters
+    static quint64 extend(quint64 hash, const char *data, qsizetype size);
+    static quint64 extend(quint64 hash, const QChar *data, qsizetype size);
+
+    // Prefix hashes of a text received in parts, one every SampleInterval
+    // characters starting with the empty prefix
+    class Sampler
+    {
+    public:
+        Sampler() : running(0), count(0), samples{ 0 } {}
+
+        void append(const char *data, qsizetype size);
+        void append(const QChar *data, qsizetype size);
+        const QList<quint64> &prefixes() const { return samples; }
+        void reserve(qsizetype size) { samples.reserve(size / SampleInterval + 1); }
+
+    private:
+        template <typename Char>
+        void sample(const Char *data, qsizetype size);
+
+        quint64 running; // hash of the characters after the last sample
+        qsizetype count;
+        QList<quint64> samples;
+    };
+};
+
+#endif // TEXTHASH_H
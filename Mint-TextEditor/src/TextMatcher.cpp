@@ -0,0 +1,168 @@
+#include "TextMatcher.h"
+#include "Simd.h"
+#include <QtAlgorithms>
+#include <type_traits>
+
+static inline QChar toChar(char c) { return QChar(uchar(c)); }
+static inline QChar toChar(QChar c) { return c; }
+
+// Value and OR-mask for which (c | bits) == value holds exactly for the
+// characters matching 'c'. Case-insensitively this works for ASCII letters,
+// except 'k' and 's' which also have non-ASCII forms (Kelvin sign, long s).
+static bool filterFor(QChar c, Qt::CaseSensitivity cs, quint16 &value, quint16 &bits)
+{
+    value = c.unicode();
+    bits = 0;
+
+    if (cs == Qt::CaseSensitive)
+        return true;
+    if (value >= 0x80)
+        return false;
+    if (value >= u'a' && value <= u'z')
+    {
+        bits = 0x20;
+        return value != u'k' && value != u's';
+    }
+    return true;
+}
+
+TextMatcher::TextMatcher(const QString &pattern, Qt::CaseSensitivity cs)
+    : needle(pattern), cs(cs), latin1Needle(true), filterable(false),
+      firstValue(0), firstBits(0), lastValue(0), lastBits(0)
+{
+    for (QChar &c : needle)
+    {
+        latin1Needle = latin1Needle && c.unicode() <= 0xFF;
+        c = fold(c);
+    }
+
+    const qsizetype m = needle.size();
+    if (m == 0)
+        return;
+
+    filterable = filterFor(needle.front(), cs, firstValue, firstBits)
+                 && filterFor(needle.back(), cs, lastValue, lastBits);
+
+    // Horspool shifts, keyed on the low byte (collisions only shorten shifts)
+    for (qsizetype &shift : skip)
+        shift = m;
+    for (qsizetype i = 0; i < m - 1; ++i)
+        skip[needle.at(i).unicode() & 0xFF] = m - 1 - i;
+}
+
+qsizetype TextMatcher::indexIn(const char *data, qsizetype size, qsizetype from) const
+{
+    // Latin-1 text can't contain what isn't Latin-1 when case matters
+    if (cs == Qt::CaseSensitive && !latin1Needle)
+        return -1;
+    return find(data, size, from);
+}
+
+qsizetype TextMatcher::indexIn(const QChar *data, qsizetype size, qsizetype from) const
+{
+    return find(data, size, from);
+}
+
+template <typename Char>
+qsizetype TextMatcher::find(const Char *data, qsizetype size, qsizetype from) const
+{
+    if (needle.isEmpty() || from < 0 || size - from < needle.size())
+        return -1;
+
+    return filterable ? findFiltered(data, size, from) : findHorspool(data, size, from);
+}
+
+template <typename Char>
+qsizetype TextMatcher::findFiltered(const Char *data, qsizetype size, qsizetype from) const
+{
+    const qsizetype m = needle.size();
+    qsizetype i = from;
+
+#ifdef MINT_SSE2
+    // Compare 16 (Latin-1) or 8 (UTF-16) candidate positions at once on both
+    // the first and the last character of the pattern
+    if constexpr (std::is_same_v<Char, char>)
+    {
+        const __m128i first = _mm_set1_epi8(char(firstValue));
+        const __m128i firstOr = _mm_set1_epi8(char(firstBits));
+        const __m128i last = _mm_set1_epi8(char(lastValue));
+        const __m128i lastOr = _mm_set1_epi8(char(lastBits));
+
+        for (; i + m - 1 + 16 <= size; i += 16)
+        {
+            const __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), firstOr);
+            const __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + m - 1)), lastOr);
+            quint32 mask = quint32(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+
+            for (; mask; mask &= mask - 1)
+            {
+                const qsizetype position = i + qCountTrailingZeroBits(mask);
+                if (matchesAt(data + position))
+                    return position;
+            }
+        }
+    }
+    else
+    {
+        const __m128i first = _mm_set1_epi16(short(firstValue));
+        const __m128i firstOr = _mm_set1_epi16(short(firstBits));
+        const __m128i last = _mm_set1_epi16(short(lastValue));
+        const __m128i lastOr = _mm_set1_epi16(short(lastBits));
+
+        for (; i + m - 1 + 8 <= size; i += 8)
+        {
+            const __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i)), firstOr);
+            const __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + m - 1)), lastOr);
+            // Two mask bits per character, keep one
+            quint32 mask = quint32(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi16(a, first), _mm_cmpeq_epi16(b, last)))) & 0x5555;
+
+            for (; mask; mask &= mask - 1)
+            {
+                const qsizetype position = i + qCountTrailingZeroBits(mask) / 2;
+                if (matchesAt(data + position))
+                    return position;
+            }
+        }
+    }
+
+    // Less than a block left
+    for (; i + m <= size; ++i)
+    {
+        if (matchesAt(data + i))
+            return i;
+    }
+    return -1;
+#else
+    Q_UNUSED(m);
+    Q_UNUSED(i);
+    return findHorspool(data, size, from);
+#endif
+}
+
+template <typename Char>
+qsizetype TextMatcher::findHorspool(const Char *data, qsizetype size, qsizetype from) const
+{
+    const qsizetype m = needle.size();
+    const QChar lastChar = needle.at(m - 1);
+
+    for (qsizetype i = from; i + m <= size;)
+    {
+        const QChar c = fold(toChar(data[i + m - 1]));
+        if (c == lastChar && matchesAt(data + i))
+            return i;
+        i += skip[c.unicode() & 0xFF];
+    }
+    return -1;
+}
+
+template <typename Char>
+bool TextMatcher::matchesAt(const Char *data) const
+{
+    const QChar *pattern = needle.constData();
+    for (qsizetype i = 0; i < needle.size(); ++i)
+    {
+        if (fold(toChar(data[i])) != pattern[i])
+            return false;
+    }
+    return true;
+}
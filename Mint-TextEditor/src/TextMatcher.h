@@ -0,0 +1,43 @@
+#ifndef TEXTMATCHER_H
+#define TEXTMATCHER_H
+
+#include <QString>
+
+// Literal substring search over Latin-1 or UTF-16 text. Candidates are found
+// with an SSE2 filter on the pattern's first and last characters and then
+// verified; patterns the filter can't handle use Boyer-Moore-Horspool.
+// Case-insensitive matching compares case-folded characters.
+class TextMatcher
+{
+public:
+    TextMatcher(const QString &pattern, Qt::CaseSensitivity cs);
+
+    qsizetype length() const { return needle.size(); }
+
+    // Index of the first match starting at or after 'from', or -1
+    qsizetype indexIn(const char *data, qsizetype size, qsizetype from = 0) const;
+    qsizetype indexIn(const QChar *data, qsizetype size, qsizetype from = 0) const;
+
+    // Same rule as QTextDocument::FindWholeWords
+    static bool isWholeWord(QChar before, QChar after)
+    {
+        return !before.isLetterOrNumber() && !after.isLetterOrNumber();
+    }
+
+private:
+    template <typename Char> qsizetype find(const Char *data, qsizetype size, qsizetype from) const;
+    template <typename Char> qsizetype findFiltered(const Char *data, qsizetype size, qsizetype from) const;
+    template <typename Char> qsizetype findHorspool(const Char *data, qsizetype size, qsizetype from) const;
+    template <typename Char> bool matchesAt(const Char *data) const;
+    QChar fold(QChar c) const { return cs == Qt::CaseSensitive ? c : c.toCaseFolded(); }
+
+    QString needle; // case-folded when matching insensitively
+    Qt::CaseSensitivity cs;
+    bool latin1Needle;
+    bool filterable;
+    quint16 firstValue, firstBits; // SSE2 filter: (c | bits) == value
+    quint16 lastValue, lastBits;
+    qsizetype skip[256];
+};
+
+#endif // TEXTMATCHER_H
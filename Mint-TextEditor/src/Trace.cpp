@@ -0,0 +1,180 @@
+#include "Trace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QSaveFile>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+// Events kept for export, the oldest are overwritten past this
+static const qsizetype EventCapacity = 200000;
+
+namespace
+{
+struct Event
+{
+    qint64 startNs;
+    qint64 durationNs;
+    quintptr thread;
+    Trace::Operation operation;
+};
+
+struct TraceData
+{
+    QMutex mutex;
+    QElapsedTimer clock;
+    Trace::Stats stats[Trace::OperationCount];
+    QVector<Event> events; // ring buffer
+    qsizetype nextEvent = 0;
+
+    TraceData() { clock.start(); }
+};
+
+TraceData &data()
+{
+    static TraceData instance;
+    return instance;
+}
+
+int bucketOf(qint64 durationNs)
+{
+    // Microseconds, from 1 so that each has a highest bit
+    const quint64 us = quint64(qMax(durationNs, qint64(0))) / 1000 + 1;
+    const int octave = 63 - qCountLeadingZeroBits(us);
+    const int step = octave >= 2 ? int((us >> (octave - 2)) & 3) : int((us << (2 - octave)) & 3);
+    return qMin(octave * 4 + step, Trace::BucketCount - 1);
+}
+
+qint64 bucketLimitNs(int bucket)
+{
+    const int octave = bucket / 4;
+    const quint64 us = (quint64(5 + bucket % 4) << octave) >> 2;
+    return qint64(qMax(us, quint64(1)) - 1) * 1000 + 999;
+}
+}
+
+QAtomicInt Trace::enabled(0);
+
+void Trace::setEnabled(bool on)
+{
+    data(); // the clock starts before the first event
+    enabled.storeRelaxed(on ? 1 : 0);
+}
+
+qint64 Trace::now()
+{
+    return data().clock.nsecsElapsed();
+}
+
+void Trace::end(Operation operation, qint64 start)
+{
+    if (start >= 0)
+        record(operation, start, now() - start);
+}
+
+void Trace::record(Operation operation, qint64 startNs, qint64 durationNs)
+{
+    if (!isEnabled() || startNs < 0)
+        return;
+
+    TraceData &trace = data();
+    const Event event{ startNs, durationNs, quintptr(QThread::currentThreadId()), operation };
+
+    QMutexLocker locker(&trace.mutex);
+    Stats &stats = trace.stats[operation];
+    stats.count++;
+    stats.totalNs += durationNs;
+    stats.maxNs = qMax(stats.maxNs, durationNs);
+    stats.buckets[bucketOf(durationNs)]++;
+
+    if (trace.events.size() < EventCapacity)
+        trace.events.append(event);
+    else
+        trace.events[trace.nextEvent] = event;
+    trace.nextEvent = (trace.nextEvent + 1) % EventCapacity;
+}
+
+qint64 Trace::Stats::percentileNs(double percentile) const
+{
+    if (count == 0)
+        return 0;
+
+    const qint64 rank = qMax(qint64(1), qint64(percentile / 100.0 * count + 0.5));
+    qint64 seen = 0;
+    for (int bucket = 0; bucket < BucketCount; ++bucket)
+    {
+        seen += buckets[bucket];
+        if (seen >= rank)
+            return qMin(bucketLimitNs(bucket), maxNs);
+    }
+    return maxNs;
+}
+
+QString Trace::name(Operation operation)
+{
+    switch (operation)
+    {
+    case Load: return "Load";
+    case Save: return "Save";
+    case Search: return "Search";
+    case Replace: return "Replace";
+    case Edit: return "Edit";
+    case Layout: return "Layout";
+    case Keystroke: return "Keystroke";
+    default: return QString();
+    }
+}
+
+Trace::Stats Trace::stats(Operation operation)
+{
+    TraceData &trace = data();
+    QMutexLocker locker(&trace.mutex);
+    return trace.stats[operation];
+}
+
+void Trace::reset()
+{
+    TraceData &trace = data();
+    QMutexLocker locker(&trace.mutex);
+    for (Stats &stats : trace.stats)
+        stats = Stats();
+    trace.events.clear();
+    trace.nextEvent = 0;
+}
+
+bool Trace::exportChromeTrace(const QString &filePath, QString *error)
+{
+    QVector<Event> events;
+    {
+        // Oldest first
+        TraceData &trace = data();
+        QMutexLocker locker(&trace.mutex);
+        events = trace.events;
+        if (events.size() == EventCapacity)
+            std::rotate(events.begin(), events.begin() + trace.nextEvent, events.end());
+    }
+
+    // Complete ("X") events, timestamps in microseconds
+    const qint64 process = QCoreApplication::applicationPid();
+    QByteArray json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    json += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + QByteArray::number(process)
+            + ",\"args\":{\"name\":\"Mint\"}}";
+    for (const Event &event : events)
+    {
+        json += ",\n{\"name\":\"" + name(event.operation).toUtf8() + "\",\"cat\":\"mint\",\"ph\":\"X\",\"ts\":"
+                + QByteArray::number(event.startNs / 1000.0, 'f', 3) + ",\"dur\":"
+                + QByteArray::number(event.durationNs / 1000.0, 'f', 3) + ",\"pid\":" + QByteArray::number(process)
+                + ",\"tid\":" + QByteArray::number(quint64(event.thread)) + "}";
+    }
+    json += "\n]}\n";
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit())
+    {
+        if (error)
+            *error = file.errorString();
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QAtomicInt>
+#include <QString>
+
+// Timing of the operations users wait on. Off by default: a disabled trace
+// costs one relaxed atomic load per operation. When on, every operation
+// goes into a latency histogram, shown by the stats panel, and into a
+// bounded event log that exports as Chrome trace-event JSON (chrome://tracing,
+// Perfetto) to look at slow sessions offline.
+class Trace
+{
+public:
+    enum Operation
+    {
+        Load,
+        Save,
+        Search,
+        Replace,
+        Edit,      // mirroring a document change into the text buffer
+        Layout,    // laying out and painting the visible text
+        Keystroke, // from a key press to the paint showing it
+        OperationCount
+    };
+
+    // Log-scaled buckets, four per doubling, from 1 µs to over an hour
+    static const int BucketCount = 128;
+
+    struct Stats
+    {
+        qint64 count = 0;
+        qint64 totalNs = 0;
+        qint64 maxNs = 0;
+        quint32 buckets[BucketCount] = {};
+
+        qint64 percentileNs(double percentile) const; // upper bound of its bucket
+    };
+
+    static bool isEnabled() { return enabled.loadRelaxed() != 0; }
+    static void setEnabled(bool on);
+
+    static qint64 now(); // ns on a monotonic clock
+    static qint64 begin() { return isEnabled() ? now() : -1; } // -1 when disabled
+    static void end(Operation operation, qint64 start); // nothing if start is -1
+    static void record(Operation operation, qint64 startNs, qint64 durationNs);
+
+    static QString name(Operation operation);
+    static Stats stats(Operation operation);
+    static void reset();
+
+    static bool exportChromeTrace(const QString &filePath, QString *error);
+
+private:
+    static QAtomicInt enabled;
+};
+
+// Times the scope it lives in
+class ScopedTrace
+{
+public:
+    explicit ScopedTrace(Trace::Operation operation) : operation(operation), start(Trace::begin()) {}
+    ~ScopedTrace() { Trace::end(operation, start); }
+    Q_DISABLE_COPY(ScopedTrace)
+
+private:
+    Trace::Operation operation;
+    qint64 start;
+};
+
+#endif // TRACE_H
@@ -0,0 +1,345 @@
+#include "UndoHistory.h"
+#include <QDataStream>
+#include <QDir>
+#include <QSettings>
+#include <QTextCursor>
+
+// Characters typed or deleted closer together than this undo as one
+static const qint64 CoalesceMs = 1000;
+static const int CompressionLevel = 1;
+
+UndoHistory::UndoHistory(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent)
+    : QObject(parent), textEditor(textEdit), textBuffer(buffer), previous(buffer->snapshot()), current(0), cleanIndex(-1), groupDepth(0),
+      groupStarted(false), applying(false), memory(0), cap(memoryCap()),
+      log(QDir::tempPath() + "/mint-undo-XXXXXX"), couldUndo(false), couldRedo(false)
+{
+    // Two stacks would hold every edit twice
+    textEditor->document()->setUndoRedoEnabled(false);
+    clock.start();
+}
+
+qint64 UndoHistory::memoryCap()
+{
+    return QSettings().value("editor/undoMemoryMB", 32).toLongLong() * 1024 * 1024;
+}
+
+void UndoHistory::record(qsizetype position, qsizetype removed, qsizetype added)
+{
+    // Undo and redo put back text the steps already hold
+    if (applying)
+    {
+        previous = textBuffer->snapshot();
+        return;
+    }
+
+    Edit edit{ position, previous.text(position, removed), textBuffer->table().text(position, added) };
+    previous = textBuffer->snapshot();
+
+    dropRedo();
+    const qint64 now = clock.elapsed();
+
+    if (groupDepth > 0 && groupStarted)
+    {
+        Step &step = steps.last();
+        step.bytes += cost(edit);
+        memory += cost(edit);
+        step.edits.append(edit);
+    }
+    else if (current > 0 && steps.last().typing && steps.last().logOffset < 0 && now - steps.last().time < CoalesceMs
+             && steps.last().edits.size() == 1 && merge(steps.last().edits.last(), edit))
+    {
+        Step &step = steps.last();
+        const qint64 bytes = cost(step.edits.last());
+        memory += bytes - step.bytes;
+        step.bytes = bytes;
+        step.time = now;
+    }
+    else
+    {
+        Step step;
+        step.bytes = cost(edit);
+        step.time = now;
+        // A character typed (over a selection or not), or one deleted
+        step.typing = groupDepth == 0 && !edit.added.contains(u'\n') && !edit.removed.contains(u'\n')
+                      && (edit.added.size() == 1 || (edit.added.isEmpty() && edit.removed.size() == 1));
+        step.edits.append(edit);
+        memory += step.bytes;
+        steps.append(step);
+        current = steps.size();
+        groupStarted = groupDepth > 0;
+    }
+
+    spill();
+    updateAvailable();
+}
+
+bool UndoHistory::merge(Edit &last, const Edit &edit)
+{
+    // Typing on
+    if (edit.removed.isEmpty() && edit.added.size() == 1 && edit.added != "\n" && !last.added.isEmpty()
+        && edit.position == last.position + last.added.size())
+    {
+        last.added += edit.added;
+        return true;
+    }
+
+    // Backspace, then delete, over what was there before
+    if (edit.added.isEmpty() && last.added.isEmpty() && edit.removed.size() == 1 && edit.removed != "\n")
+    {
+        if (edit.position + 1 == last.position)
+        {
+            last.removed.prepend(edit.removed);
+            last.position = edit.position;
+            return true;
+        }
+        if (edit.position == last.position)
+        {
+            last.removed += edit.removed;
+            return true;
+        }
+    }
+    return false;
+}
+
+void UndoHistory::skip()
+{
+    previous = textBuffer->snapshot();
+    cleanIndex = -1;
+}
+
+void UndoHistory::setClean(bool clean)
+{
+    cleanIndex = clean ? current : -1;
+    // Typing on starts a step of its own, the clean one keeps its text
+    if (clean && current > 0)
+        steps[current - 1].typing = false;
+}
+
+void UndoHistory::clear()
+{
+    previous = textBuffer->snapshot();
+    steps.clear();
+    current = 0;
+    cleanIndex = -1;
+    groupStarted = false;
+    memory = 0;
+    if (log.isOpen())
+        log.resize(0);
+    updateAvailable();
+}
+
+void UndoHistory::beginGroup()
+{
+    if (groupDepth++ == 0)
+        groupStarted = false;
+}
+
+void UndoHistory::endGroup()
+{
+    Q_ASSERT(groupDepth > 0);
+    --groupDepth;
+}
+
+void UndoHistory::undo()
+{
+    if (!canUndo() || groupDepth > 0)
+        return;
+
+    Step &step = steps[current - 1];
+    if (!restore(step))
+    {
+        // What is older can't be undone either
+        for (qsizetype i = 0; i < current; ++i)
+        {
+            if (steps.at(i).logOffset < 0)
+                memory -= steps.at(i).bytes;
+        }
+        steps.remove(0, current);
+        cleanIndex = cleanIndex >= current ? cleanIndex - current : -1;
+        current = 0;
+        updateAvailable();
+        return;
+    }
+
+    apply(step, true);
+    --current;
+    spill();
+    updateAvailable();
+}
+
+void UndoHistory::redo()
+{
+    if (!canRedo() || groupDepth > 0)
+        return;
+
+    Step &step = steps[current];
+    if (!restore(step))
+    {
+        dropRedo();
+        updateAvailable();
+        return;
+    }
+
+    apply(step, false);
+    ++current;
+    spill();
+    updateAvailable();
+}
+
+void UndoHistory::apply(const Step &step, bool undoing)
+{
+    // One edit at a time: in an edit block the document would report the
+    // whole range between them as changed
+    applying = true;
+    QTextCursor cursor(textEditor->document());
+    qsizetype position = 0;
+    for (qsizetype i = 0; i < step.edits.size(); ++i)
+    {
+        const Edit &edit = step.edits.at(undoing ? step.edits.size() - 1 - i : i);
+        const QString &from = undoing ? edit.added : edit.removed;
+        const QString &to = undoing ? edit.removed : edit.added;
+        cursor.setPosition(int(edit.position));
+        cursor.setPosition(int(edit.position + from.size()), QTextCursor::KeepAnchor);
+        cursor.insertText(to);
+        position = edit.position + to.size();
+    }
+    applying = false;
+
+    // After the text put back, like typing it would
+    QTextCursor place = textEditor->textCursor();
+    place.setPosition(int(position));
+    textEditor->setTextCursor(place);
+    textEditor->ensureCursorVisible();
+}
+
+void UndoHistory::dropRedo()
+{
+    if (current == steps.size())
+        return;
+
+    for (qsizetype i = current; i < steps.size(); ++i)
+    {
+        if (steps.at(i).logOffset < 0)
+            memory -= steps.at(i).bytes;
+    }
+    steps.resize(current);
+    if (cleanIndex > current)
+        cleanIndex = -1;
+    groupStarted = false;
+}
+
+void UndoHistory::spill()
+{
+    // Oldest first, then the redo steps furthest away; the next step to
+    // undo and the next to redo stay in memory
+    qsizetype oldest = 0;
+    qsizetype furthest = steps.size() - 1;
+    while (memory > cap)
+    {
+        while (oldest < current - 1 && steps.at(oldest).logOffset >= 0)
+            ++oldest;
+        while (furthest > current && steps.at(furthest).logOffset >= 0)
+            --furthest;
+
+        if (oldest < current - 1)
+        {
+            if (!spillStep(steps[oldest]))
+            {
+                // Dropped rather than kept past the cap
+                memory -= steps.at(oldest).bytes;
+                steps.remove(0, oldest + 1);
+                cleanIndex = cleanIndex > oldest ? cleanIndex - (oldest + 1) : -1;
+                current -= oldest + 1;
+                furthest -= oldest + 1;
+                oldest = 0;
+            }
+        }
+        else if (furthest > current)
+        {
+            if (!spillStep(steps[furthest]))
+            {
+                for (qsizetype i = furthest; i < steps.size(); ++i)
+                {
+                    if (steps.at(i).logOffset < 0)
+                        memory -= steps.at(i).bytes;
+                }
+                steps.resize(furthest);
+                if (cleanIndex > furthest)
+                    cleanIndex = -1;
+                furthest = steps.size() - 1;
+            }
+        }
+        else
+            break;
+    }
+}
+
+bool UndoHistory::spillStep(Step &step)
+{
+    if (!log.isOpen() && !log.open())
+        return false;
+
+    QByteArray raw;
+    QDataStream out(&raw, QIODevice::WriteOnly);
+    out << qint64(step.edits.size());
+    for (const Edit &edit : step.edits)
+        out << qint64(edit.position) << edit.removed << edit.added;
+    const QByteArray compressed = qCompress(raw, CompressionLevel);
+
+    const qint64 offset = log.size();
+    if (!log.seek(offset) || log.write(compressed) != compressed.size())
+        return false;
+
+    step.logOffset = offset;
+    step.logSize = compressed.size();
+    step.edits = QList<Edit>();
+    memory -= step.bytes;
+    return true;
+}
+
+bool UndoHistory::restore(Step &step)
+{
+    if (step.logOffset < 0)
+        return true;
+
+    if (!log.seek(step.logOffset))
+        return false;
+    const QByteArray raw = qUncompress(log.read(step.logSize));
+    if (raw.isEmpty())
+        return false;
+
+    QDataStream in(raw);
+    qint64 count = 0;
+    in >> count;
+    QList<Edit> edits;
+    for (qint64 i = 0; i < count && in.status() == QDataStream::Ok; ++i)
+    {
+        qint64 position = 0;
+        Edit edit;
+        in >> position >> edit.removed >> edit.added;
+        edit.position = qsizetype(position);
+        edits.append(edit);
+    }
+    if (in.status() != QDataStream::Ok)
+        return false;
+
+    // Its place in the log is left, the log goes away with the history
+    step.edits = edits;
+    step.logOffset = -1;
+    memory += step.bytes;
+    return true;
+}
+
+void UndoHistory::updateAvailable()
+{
+    if (canUndo() != couldUndo)
+    {
+        couldUndo = canUndo();
+        emit undoAvailable(couldUndo);
+    }
+    if (canRedo() != couldRedo)
+    {
+        couldRedo = canRedo();
+        emit redoAvailable(couldRedo);
+    }
+}
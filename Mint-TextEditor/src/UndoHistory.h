@@ -0,0 +1,100 @@
+#ifndef UNDOHISTORY_H
+#define UNDOHISTORY_H
+
+#include <QObject>
+#include <QPlainTextEdit>
+#include <QTemporaryFile>
+#include <QElapsedTimer>
+
+#include "TextBuffer.h"
+
+// Undo and redo of a document, in place of the QTextDocument's own stack.
+// Each step keeps the text it removed and inserted, taken from the buffer's
+// snapshots, so recording, undoing and redoing cost the size of the edit.
+// Typing and deleting characters in a row within a second make one step,
+// and edits between beginGroup() and endGroup() undo together. Past the
+// memory cap the oldest steps are compressed into a temporary log on disk,
+// and read back when undone to. The step the file was saved at is the
+// clean state: undoing or redoing back to it is known to restore the text.
+class UndoHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    UndoHistory(QPlainTextEdit *textEdit, TextBuffer *buffer, QObject *parent = nullptr);
+
+    // Every change of the buffer comes through here, in order
+    void record(qsizetype position, qsizetype removed, qsizetype added);
+    void clear(); // the buffer's text becomes the start of the history
+    // The change isn't undoable, the steps are kept: only for text appended
+    // after all of them, whose positions it leaves alone
+    void skip();
+
+    // The text now is the file's (true), or no step is known to be (false)
+    void setClean(bool clean = true);
+    bool isClean() const { return current == cleanIndex; }
+
+    void beginGroup();
+    void endGroup();
+
+    bool canUndo() const { return current > 0; }
+    bool canRedo() const { return current < steps.size(); }
+    bool isApplying() const { return applying; }
+
+    qint64 memoryUsed() const { return memory; }
+    qint64 spilledSize() const { return log.isOpen() ? log.size() : 0; }
+    static qint64 memoryCap(); // bytes, from the settings
+
+public slots:
+    void undo();
+    void redo();
+
+signals:
+    void undoAvailable(bool available);
+    void redoAvailable(bool available);
+
+private:
+    struct Edit
+    {
+        qsizetype position;
+        QString removed;
+        QString added;
+    };
+
+    struct Step
+    {
+        QList<Edit> edits; // empty while spilled
+        qint64 bytes = 0;
+        qint64 logOffset = -1; // where it is in the log, -1 when in memory
+        qint64 logSize = 0;
+        qint64 time = 0;
+        bool typing = false; // more typed characters may join it
+    };
+
+    static bool merge(Edit &last, const Edit &edit);
+    static qint64 cost(const Edit &edit) { return qint64(edit.removed.size() + edit.added.size()) * 2 + qint64(sizeof(Edit)); }
+    void apply(const Step &step, bool undoing);
+    void dropRedo();
+    void spill();
+    bool spillStep(Step &step);
+    bool restore(Step &step);
+    void updateAvailable();
+
+    QPlainTextEdit *textEditor;
+    TextBuffer *textBuffer;
+    TextSnapshot previous; // the text before the edit being recorded
+    QList<Step> steps;
+    qsizetype current; // steps before it are undone, from it redone
+    qsizetype cleanIndex; // 'current' when the text is the file's, -1 if not reachable
+    int groupDepth;
+    bool groupStarted; // the open group has its step
+    bool applying;
+    qint64 memory;
+    qint64 cap;
+    QTemporaryFile log;
+    QElapsedTimer clock;
+    bool couldUndo;
+    bool couldRedo;
+};
+
+#endif // UNDOHISTORY_H
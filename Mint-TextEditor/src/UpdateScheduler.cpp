@@ -0,0 +1,52 @@
+#include "UpdateScheduler.h"
+
+UpdateScheduler::UpdateScheduler(QObject *parent)
+    : QObject(parent), dirty(0)
+{
+    timer.setSingleShot(true);
+    connect(&timer, &QTimer::timeout, this, &UpdateScheduler::flush);
+}
+
+int UpdateScheduler::add(const std::function<void()> &update)
+{
+    Q_ASSERT(updates.size() < MaxParts);
+    updates.append(update);
+    return int(updates.size() - 1);
+}
+
+void UpdateScheduler::schedule(int part)
+{
+    dirty |= quint64(1) << part;
+    start();
+}
+
+void UpdateScheduler::scheduleAll()
+{
+    dirty = updates.size() < MaxParts ? (quint64(1) << updates.size()) - 1 : ~quint64(0);
+    start();
+}
+
+void UpdateScheduler::start()
+{
+    if (timer.isActive())
+        return;
+
+    // Right away after a quiet frame, else at the end of the current one
+    const qint64 elapsed = sinceFlush.isValid() ? sinceFlush.elapsed() : FrameMs;
+    timer.start(elapsed < FrameMs ? int(FrameMs - elapsed) : 0);
+}
+
+void UpdateScheduler::flush()
+{
+    timer.stop();
+    sinceFlush.start();
+
+    // An update may schedule another part, which waits for the next frame
+    const quint64 parts = dirty;
+    dirty = 0;
+    for (int part = 0; part < updates.size(); ++part)
+    {
+        if (parts & (quint64(1) << part))
+            updates.at(part)();
+    }
+}
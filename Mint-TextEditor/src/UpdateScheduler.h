@@ -0,0 +1,40 @@
+#ifndef UPDATESCHEDULER_H
+#define UPDATESCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QList>
+#include <functional>
+
+// Coalesces refreshes of the window around the editor (status bar, title,
+// actions, and any view that follows the text). Edits and cursor moves only
+// mark a part as dirty; dirty parts are refreshed together, each once, at
+// most once a frame. The first change after a quiet frame is refreshed on
+// the next pass of the event loop, so a single keystroke shows at once,
+// while key repeat or a paste only costs a refresh per frame.
+class UpdateScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    static const int FrameMs = 16;
+    static const int MaxParts = 64;
+
+    explicit UpdateScheduler(QObject *parent = nullptr);
+
+    int add(const std::function<void()> &update); // id of the new part
+    void schedule(int part);
+    void scheduleAll();
+    void flush(); // refreshes the dirty parts now
+
+private:
+    void start();
+
+    QList<std::function<void()>> updates;
+    quint64 dirty;
+    QTimer timer;
+    QElapsedTimer sinceFlush;
+};
+
+#endif // UPDATESCHEDULER_H
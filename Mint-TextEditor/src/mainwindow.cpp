@@ -4,9 +4,15 @@
 #include <QHBoxLayout>
 #include <QWidget>
 #include <QFileInfo>
+#include <QDir>
 #include <QCloseEvent>
+#include <QInputDialog>
+#include <QSettings>
+#include <QTimer>
+#include <algorithm>
+#include <climits>
 
-MainWindow::MainWindow(QWidget *parent)
+MainWindow::MainWindow(const QList<FileLocation> &files, QWidget *parent)
     : QMainWindow(parent)
 {
     // Main window configuration
@@ -14,6 +20,19 @@ MainWindow::MainWindow(QWidget *parent)
     setMinimumSize(800, 600);
     resize(1000, 700);
 
+    activationCount = 0;
+    findDialog = nullptr;
+    statsPanel = nullptr;
+    findInFilesPanel = nullptr;
+    askingReload = false;
+    fileWatcher = nullptr;
+    shownLine = 0;
+    shownColumn = 0;
+    shownSelection = false;
+
+    // Before any child exists, so each widget is polished only once
+    applyMintTheme();
+
     // UI init
     setupUI();    
     createActions();
@@ -21,31 +40,40 @@ MainWindow::MainWindow(QWidget *parent)
     createToolBars();
     createStatusBar();
 
+    // Status bar, title and actions follow the current tab at most once a frame
+    updates = new UpdateScheduler(this);
+    cursorPart = updates->add([this]() { updateCursorPosition(); });
+    titlePart = updates->add([this]() { updateWindowTitle(); });
+    actionsPart = updates->add([this]() { updateEditActions(); });
+    formatPart = updates->add([this]() { formatLabel->setText(currentTab()->format().name()); });
+
     // Features & functionnalities
-    connect(textEditor, &QTextEdit::cursorPositionChanged,this,&MainWindow::updateCursorPosition);
-    connect(textEditor, &QTextEdit::textChanged,this,[this](){
-        documentModified = true;
-        updateWindowTitle();
-    });
+    connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::currentTabChanged);
+    connect(tabWidget, &QTabWidget::tabCloseRequested, this, &MainWindow::closeTab);
 
-    documentModified = false;
-    currentFilePath = "";
-    findDialog = nullptr;
-    updateCursorPosition();
+    // Files from the command line take the place of the empty document
+    addTab("");
+    openLocations(files);
+
+    // Once the window is up
+    QTimer::singleShot(0, this, &MainWindow::recoverDocuments);
 }
 
 MainWindow::~MainWindow()
 {
+    // Before the tabs it refers to
+    delete findDialog;
 }
 
 void MainWindow::setupUI()
 {
-    // Central widget
-    textEditor = new QTextEdit(this);
-    textEditor->setFont(QFont("Consolas",11));
-    textEditor->setTabStopDistance(40);
+    // Central widget, one tab per document
+    tabWidget = new QTabWidget(this);
+    tabWidget->setTabsClosable(true);
+    tabWidget->setMovable(true);
+    tabWidget->setDocumentMode(true);
 
-    setCentralWidget(textEditor);
+    setCentralWidget(tabWidget);
 }
 
 void MainWindow::createActions()
@@ -70,6 +98,11 @@ void MainWindow::createActions()
     saveAsAction->setShortcut(QKeySequence::SaveAs); // Ctrl+Shift+S
     saveAsAction->setStatusTip("Save under new name/extension");
     connect(saveAsAction, &QAction::triggered, this, &MainWindow::saveAsFile);
+    // Close tab
+    closeTabAction = new QAction("&Close tab", this);
+    closeTabAction->setShortcut(QKeySequence::Close); // Ctrl+W
+    closeTabAction->setStatusTip("Close current document");
+    connect(closeTabAction, &QAction::triggered, this, [this]() { closeTab(tabWidget->currentIndex()); });
     // Exit
     exitAction = new QAction("Exit", this);
     exitAction->setShortcut(QKeySequence::Quit); // Ctrl+Q
@@ -82,46 +115,94 @@ void MainWindow::createActions()
     findAction->setStatusTip("Search for text");
     connect(findAction, &QAction::triggered, this, &MainWindow::showFindDialog);
 
-    // Editing actions
+    findInFilesAction = new QAction("Find in &files ...", this);
+    findInFilesAction->setShortcut(QKeySequence("Ctrl+Shift+F"));
+    findInFilesAction->setStatusTip("Search every file of a folder");
+    connect(findInFilesAction, &QAction::triggered, this, &MainWindow::showFindInFiles);
+
+    // Go to line action
+    goToLineAction = new QAction("&Go to line ...", this);
+    goToLineAction->setShortcut(QKeySequence("Ctrl+G"));
+    goToLineAction->setStatusTip("Jump to a line number");
+    connect(goToLineAction, &QAction::triggered, this, &MainWindow::goToLine);
+
+    // Markdown preview of the current tab
+    previewAction = new QAction("Markdown &preview", this);
+    previewAction->setShortcut(QKeySequence("Ctrl+Shift+M"));
+    previewAction->setStatusTip("Show the HTML rendering of the document");
+    previewAction->setCheckable(true);
+    connect(previewAction, &QAction::triggered, this, [this](bool checked) { currentTab()->setPreviewVisible(checked); });
+
+    // Minimap beside every editor, remembered across sessions
+    minimapAction = new QAction("&Minimap", this);
+    minimapAction->setStatusTip("Show an overview of the document beside the editor");
+    minimapAction->setCheckable(true);
+    minimapAction->setChecked(QSettings().value("view/minimap", true).toBool());
+    connect(minimapAction, &QAction::triggered, this, [this](bool checked) {
+        QSettings().setValue("view/minimap", checked);
+        for (int i = 0; i < tabWidget->count(); ++i)
+            documentTab(i)->setMinimapVisible(checked);
+    });
+
+    followAction = new QAction("&Follow file", this);
+    followAction->setStatusTip("Add what other programs append to the file, like tail -f");
+    followAction->setCheckable(true);
+    connect(followAction, &QAction::triggered, this, [this](bool checked) {
+        currentTab()->watcher()->setFollowing(checked);
+        if (checked)
+            checkFile(currentTab());
+    });
+
+    // Latency of the traced operations, the panel is built when first shown
+    statsAction = new QAction("Performance &stats", this);
+    statsAction->setStatusTip("Show how long loads, saves, searches and keystrokes take");
+    statsAction->setCheckable(true);
+    connect(statsAction, &QAction::triggered, this, [this](bool checked) {
+        if (!statsPanel)
+        {
+            statsPanel = new StatsPanel(this);
+            addDockWidget(Qt::BottomDockWidgetArea, statsPanel);
+            connect(statsPanel, &QDockWidget::visibilityChanged, statsAction, &QAction::setChecked);
+        }
+        statsPanel->setVisible(checked);
+    });
+
+    // Editing actions, applied to the current tab's editor
     undoAction = new QAction("&Undo", this);
     undoAction->setShortcut(QKeySequence::Undo); // Ctrl+Z
     undoAction->setStatusTip("Cancel last action");
-    connect(undoAction, &QAction::triggered, textEditor, &QTextEdit::undo);
+    connect(undoAction, &QAction::triggered, this, [this]() { currentTab()->history()->undo(); });
 
     redoAction = new QAction("&Redo", this);
     redoAction->setShortcut(QKeySequence::Redo); // Ctrl+Y
     redoAction->setStatusTip("Put back last undone action");
-    connect(redoAction, &QAction::triggered, textEditor, &QTextEdit::redo);
+    connect(redoAction, &QAction::triggered, this, [this]() { currentTab()->history()->redo(); });
 
     cutAction = new QAction("&Cut", this);
     cutAction->setShortcut(QKeySequence::Cut);
     cutAction->setStatusTip("Cut selection");
-    connect(cutAction, &QAction::triggered, textEditor, &QTextEdit::cut);
+    connect(cutAction, &QAction::triggered, this, [this]() { currentTab()->editor()->cut(); });
 
     copyAction = new QAction("&Copy", this);
     copyAction->setShortcut(QKeySequence::Copy); // Ctrl+C
     copyAction->setStatusTip("Copy selection to clipboard");
-    connect(copyAction, &QAction::triggered, textEditor, &QTextEdit::copy);
+    connect(copyAction, &QAction::triggered, this, [this]() { currentTab()->editor()->copy(); });
 
     pasteAction = new QAction("&Paste", this);
     pasteAction->setShortcut(QKeySequence::Paste); // Ctrl+V
     pasteAction->setStatusTip("Paste clipboard's content");
-    connect(pasteAction, &QAction::triggered, textEditor, &QTextEdit::paste);
+    connect(pasteAction, &QAction::triggered, this, [this]() { currentTab()->editor()->paste(); });
 
     selectAllAction = new QAction("&Select all", this);
     selectAllAction->setShortcut(QKeySequence::SelectAll); // Ctrl+A
     selectAllAction->setStatusTip("Select all file's text");
-    connect(selectAllAction, &QAction::triggered, textEditor, &QTextEdit::selectAll);
-
-    // Automatic update of few actions
-    connect(textEditor, &QTextEdit::undoAvailable, undoAction, &QAction::setEnabled);
-    connect(textEditor, &QTextEdit::redoAvailable, redoAction, &QAction::setEnabled);
-    connect(textEditor, &QTextEdit::selectionChanged, this, &MainWindow::updateEditActions);
+    connect(selectAllAction, &QAction::triggered, this, [this]() { currentTab()->editor()->selectAll(); });
 
-    // Actions' initial state
-    updateEditActions();
-
-    applyMintTheme();
+    // Actions' initial state (kept up to date by each tab's editor)
+    undoAction->setEnabled(false);
+    redoAction->setEnabled(false);
+    cutAction->setEnabled(false);
+    copyAction->setEnabled(false);
 }
 
 void MainWindow::createMenus()
@@ -134,6 +215,7 @@ void MainWindow::createMenus()
     fileMenu->addAction(saveAction);
     fileMenu->addAction(saveAsAction);
     fileMenu->addSeparator();
+    fileMenu->addAction(closeTabAction);
     fileMenu->addAction(exitAction);
     // Editing menu
     editMenu = menuBar()->addMenu("&Edit");
@@ -147,6 +229,15 @@ void MainWindow::createMenus()
     editMenu->addAction(selectAllAction);
     editMenu->addSeparator();
     editMenu->addAction(findAction);
+    editMenu->addAction(findInFilesAction);
+    editMenu->addAction(goToLineAction);
+    // View menu
+    viewMenu = menuBar()->addMenu("&View");
+    viewMenu->addAction(previewAction);
+    viewMenu->addAction(minimapAction);
+    viewMenu->addAction(followAction);
+    viewMenu->addSeparator();
+    viewMenu->addAction(statsAction);
     // Help menu (empty yet)
     helpMenu = menuBar()->addMenu("&Help");
 }
@@ -177,101 +268,477 @@ void MainWindow::createStatusBar()
 
     positionLabel = new QLabel("Line: 1, Column: 1");
     myStatusBar->addPermanentWidget(positionLabel);
+
+    formatLabel = new QLabel(TextFormat().name());
+    myStatusBar->addPermanentWidget(formatLabel);
 }
 
-void MainWindow::newFile()
+
+/* --------------- *
+ *      TABS       *
+ * --------------- */
+DocumentTab *MainWindow::currentTab() const
+{
+    return documentTab(tabWidget->currentIndex());
+}
+
+DocumentTab *MainWindow::documentTab(int index) const
+{
+    return static_cast<DocumentTab *>(tabWidget->widget(index));
+}
+
+DocumentTab *MainWindow::addTab(const QString &filePath)
+{
+    DocumentTab *tab = new DocumentTab(filePath, tabWidget);
+    tab->setMinimapVisible(minimapAction->isChecked());
+
+    // Only the current tab drives the window, the others keep their state
+    QPlainTextEdit *editor = tab->editor();
+    connect(editor, &QPlainTextEdit::cursorPositionChanged, tab, [this, tab]() {
+        if (tab == currentTab())
+            updates->schedule(cursorPart);
+    });
+    connect(editor, &QPlainTextEdit::selectionChanged, tab, [this, tab]() {
+        if (tab == currentTab())
+            updates->schedule(actionsPart);
+    });
+    connect(tab->history(), &UndoHistory::undoAvailable, tab, [this, tab](bool available) {
+        if (tab == currentTab())
+            undoAction->setEnabled(available);
+    });
+    connect(tab->history(), &UndoHistory::redoAvailable, tab, [this, tab](bool available) {
+        if (tab == currentTab())
+            redoAction->setEnabled(available);
+    });
+    connect(tab, &DocumentTab::stateChanged, this, [this, tab]() {
+        updateTabTitle(tab);
+        if (tab == currentTab())
+        {
+            updates->schedule(titlePart);
+            updates->schedule(formatPart);
+        }
+        updateWatchedFiles();
+    });
+
+    // Loading and saving report to the status bar
+    connect(tab->loader(), &DocumentLoader::progress, tab, [this, tab](qint64 bytesRead, qint64 bytesTotal) {
+        updateLoadProgress(tab, bytesRead, bytesTotal);
+    });
+    connect(tab->loader(), &DocumentLoader::finished, tab, [this, tab](bool success, qint64 elapsedMs) {
+        documentLoaded(tab, success, elapsedMs);
+    });
+    connect(tab->saver(), &DocumentSaver::progress, tab, [this, tab](qint64 charsWritten, qint64 charsTotal) {
+        updateSaveProgress(tab, charsWritten, charsTotal);
+    });
+    connect(tab->saver(), &DocumentSaver::finished, tab, [this, tab](bool success, qint64 elapsedMs, qint64 peakMemory) {
+        documentSaved(tab, success, elapsedMs, peakMemory);
+    });
+    connect(tab->watcher(), &DocumentWatcher::finished, tab, [this, tab](bool success) {
+        documentReloaded(tab, success);
+    });
+
+    tabWidget->addTab(tab, tab->displayName());
+    updateTabTitle(tab);
+    return tab;
+}
+
+void MainWindow::updateTabTitle(DocumentTab *tab)
+{
+    const int index = tabWidget->indexOf(tab);
+    if (index < 0)
+        return;
+
+    tabWidget->setTabText(index, tab->displayName() + (tab->isModified() ? " *" : ""));
+    tabWidget->setTabToolTip(index, tab->filePath());
+}
+
+void MainWindow::currentTabChanged(int index)
+{
+    DocumentTab *tab = documentTab(index);
+    if (!tab)
+        return;
+
+    tab->setLastActivation(++activationCount);
+
+    // Background tabs read their file when first shown
+    if (!tab->isLoaded())
+    {
+        if (tab->load())
+            statusLabel->setText(QString(tab->isLargeFile() ? "Opened %1 read-only (large file)" : "Loading %1 ...").arg(tab->displayName()));
+        else
+        {
+            QMessageBox::warning(this, "Error", QString("File couldn't be opened :\n%1").arg(tab->loader()->errorString()));
+            // Not from within the tab switch
+            QTimer::singleShot(0, tab, [this, tab]() { closeTab(tabWidget->indexOf(tab)); });
+        }
+    }
+
+    if (findDialog)
+        findDialog->setDocument(tab->editor(), tab->buffer());
+
+    QPlainTextEdit *editor = tab->editor();
+    undoAction->setEnabled(tab->history()->canUndo());
+    redoAction->setEnabled(tab->history()->canRedo());
+    previewAction->setChecked(tab->isPreviewVisible());
+    followAction->setChecked(tab->watcher()->isFollowing());
+    updates->scheduleAll();
+
+    enforceMemoryBudget();
+    if (tab->isLargeFile())
+        tab->largeFileView()->setFocus();
+    else
+        editor->setFocus();
+}
+
+bool MainWindow::closeTab(int index)
+{
+    DocumentTab *tab = documentTab(index);
+    if (!tab || !maybeSave(tab))
+        return false;
+
+    tab->loader()->cancel();
+    tab->watcher()->cancel();
+    tab->saver()->waitForFinished();
+
+    // There is always a document to type in
+    if (tabWidget->count() == 1)
+        addTab("");
+
+    // Removing first lets the find dialog follow the new current tab
+    tabWidget->removeTab(tabWidget->indexOf(tab));
+    tab->deleteLater();
+    updateWatchedFiles();
+    return true;
+}
+
+void MainWindow::enforceMemoryBudget()
 {
-    if (maybeSave()) {
-        textEditor->clear();
-        setCurrentFile("");
-        statusLabel->setText("New document created");
+    const qint64 budget = QSettings().value("tabs/memoryBudgetMB", 512).toLongLong() * 1024 * 1024;
+
+    qint64 total = 0;
+    QList<DocumentTab *> candidates;
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        DocumentTab *tab = documentTab(i);
+        total += tab->memoryCost();
+        if (tab != currentTab() && tab->canUnload())
+            candidates.append(tab);
+    }
+
+    // Clean tabs can be read again from their file, least recently used first
+    std::sort(candidates.begin(), candidates.end(), [](DocumentTab *a, DocumentTab *b) {
+        return a->lastActivation() < b->lastActivation();
+    });
+    for (DocumentTab *tab : candidates)
+    {
+        if (total <= budget)
+            break;
+
+        total -= tab->memoryCost();
+        tab->unload();
     }
 }
 
+
+/* --------------- *
+ *      FILES      *
+ * --------------- */
+void MainWindow::newFile()
+{
+    tabWidget->setCurrentWidget(addTab(""));
+    statusLabel->setText("New document created");
+}
+
 void MainWindow::openFile()
 {
-    if (maybeSave())
+    const QStringList fileNames = QFileDialog::getOpenFileNames(this, "Open files", "", "Text file (*.txt);;Markdown file (*.md);;All types (*.*)");
+    if (fileNames.isEmpty())
+        return;
+
+    QList<FileLocation> locations;
+    for (const QString &fileName : fileNames)
+        locations.append(FileLocation{ fileName });
+    openLocations(locations);
+}
+
+void MainWindow::openLocations(const QList<FileLocation> &locations)
+{
+    if (locations.isEmpty())
+        return;
+
+    // An untouched new document gives its place to the opened files
+    DocumentTab *blank = currentTab();
+    if (!blank->filePath().isEmpty() || blank->isModified() || !blank->editor()->document()->isEmpty())
+        blank = nullptr;
+
+    // Only the first file is loaded now, the others when their tab is shown
+    DocumentTab *first = nullptr;
+    for (const FileLocation &location : locations)
+    {
+        DocumentTab *tab = nullptr;
+        for (int i = 0; i < tabWidget->count() && !tab; ++i)
+        {
+            if (documentTab(i)->filePath() == location.path)
+                tab = documentTab(i);
+        }
+        if (!tab)
+            tab = addTab(location.path);
+        if (location.line > 0)
+            tab->goToLocation(location.line, location.column);
+        if (!first)
+            first = tab;
+    }
+    tabWidget->setCurrentWidget(first);
+
+    if (blank)
+        closeTab(tabWidget->indexOf(blank));
+}
+
+void MainWindow::recoverDocuments()
+{
+    const QStringList journals = DocumentJournal::pendingJournals();
+    if (journals.isEmpty())
+        return;
+
+    DocumentTab *blank = currentTab();
+    if (!blank->filePath().isEmpty() || blank->isModified() || !blank->editor()->document()->isEmpty())
+        blank = nullptr;
+
+    DocumentTab *first = nullptr;
+    for (const QString &journal : journals)
     {
-        QString fileName = QFileDialog::getOpenFileName(this, "Open a file", "", "Text file (*.txt);;Markdown file (*.md);;All types (*.*)");
+        DocumentJournal::Header header;
+        if (!DocumentJournal::readHeader(journal, &header))
+        {
+            DocumentJournal::remove(journal);
+            continue;
+        }
 
-        if (!fileName.isEmpty())
+        const QString name = header.filePath.isEmpty() ? QString("An untitled document") : QFileInfo(header.filePath).fileName();
+        if (!header.filePath.isEmpty())
         {
-            if (loadDocument(fileName))
+            // The edits only apply to the file they were made on
+            const QFileInfo info(header.filePath);
+            if (!info.exists() || info.size() != header.fileSize || info.lastModified().toMSecsSinceEpoch() != header.fileModified)
             {
-                setCurrentFile(fileName);
-                statusLabel->setText("File successfully opened");
+                QMessageBox::warning(this, "Recovery", QString("%1 has changed since Mint closed unexpectedly.\nIts unsaved changes can't be recovered.").arg(name));
+                DocumentJournal::remove(journal);
+                continue;
             }
         }
+
+        const QMessageBox::StandardButton answer = QMessageBox::question(this, "Recovery",
+            QString("%1 has unsaved changes from when Mint closed unexpectedly.\nDo you want to recover them ?").arg(name),
+            QMessageBox::Yes | QMessageBox::No);
+        if (answer != QMessageBox::Yes)
+        {
+            DocumentJournal::remove(journal);
+            continue;
+        }
+
+        // A file's journal is replayed once the tab has loaded it
+        DocumentTab *tab = addTab(header.filePath);
+        tab->recover(journal);
+        if (!first)
+            first = tab;
     }
+
+    if (!first)
+        return;
+    tabWidget->setCurrentWidget(first);
+    if (blank)
+        closeTab(tabWidget->indexOf(blank));
 }
 
-void MainWindow::saveFile()
+bool MainWindow::saveFile()
 {
-    if (currentFilePath.isEmpty())
-        saveAsFile();
-    else
-        saveDocument(currentFilePath);
+    return saveTab(currentTab());
 }
 
-void MainWindow::saveAsFile()
+bool MainWindow::saveAsFile()
 {
-    QString fileName = QFileDialog::getSaveFileName(this, "Save as", "", "Text file (*.txt);;Markdown file (*.md);;All types (*.*)");
+    return saveTabAs(currentTab());
+}
 
-    if (!fileName.isEmpty())
+bool MainWindow::saveTab(DocumentTab *tab)
+{
+    if (tab->filePath().isEmpty())
+        return saveTabAs(tab);
+
+    // The file already holds this text
+    if (!tab->isModified())
     {
-        if (saveDocument(fileName))
-            setCurrentFile(fileName);
+        statusLabel->setText("No changes to save");
+        return true;
     }
+
+    return saveDocument(tab, tab->filePath());
+}
+
+bool MainWindow::saveTabAs(DocumentTab *tab)
+{
+    QString fileName = QFileDialog::getSaveFileName(this, "Save as", tab->filePath(), "Text file (*.txt);;Markdown file (*.md);;All types (*.*)");
+
+    if (fileName.isEmpty())
+        return false;
+
+    return saveDocument(tab, fileName); // the tab takes the new path once saved
 }
 
-bool MainWindow::saveDocument(const QString &filePath)
+bool MainWindow::saveDocument(DocumentTab *tab, const QString &filePath)
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::WriteOnly | QIODevice::Text))
+    if (!tab->save(filePath))
     {
-        QMessageBox::warning(this, "Error", QString("File couldn't be saved :\n%1").arg(file.errorString()));
+        statusLabel->setText(tab->saveRefusal());
         return false;
     }
 
-    QTextStream out(&file);
-    out << textEditor->toPlainText();
+    statusLabel->setText(QString("Saving %1 ...").arg(QFileInfo(filePath).fileName()));
+    return true;
+}
 
-    documentModified = false;
-    updateWindowTitle();
-    statusLabel->setText("Document saved");
+void MainWindow::updateSaveProgress(DocumentTab *tab, qint64 charsWritten, qint64 charsTotal)
+{
+    const int percent = charsTotal > 0 ? int(charsWritten * 100 / charsTotal) : 100;
+    statusLabel->setText(QString("Saving %1 ... %2%").arg(QFileInfo(tab->saver()->filePath()).fileName()).arg(percent));
+}
 
-    return true;
+void MainWindow::documentSaved(DocumentTab *tab, bool success, qint64 elapsedMs, qint64 peakMemory)
+{
+    if (!success)
+    {
+        QMessageBox::warning(this, "Error", QString("File couldn't be saved :\n%1").arg(tab->saver()->errorString()));
+        statusLabel->setText("Ready");
+        return;
+    }
+
+    statusLabel->setText(QString("Document saved (%1 ms, peak memory %2 MB)").arg(elapsedMs).arg(peakMemory / (1024 * 1024)));
 }
 
-bool MainWindow::loadDocument(const QString &filePath)
+void MainWindow::updateWatchedFiles()
 {
-    QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    QStringList paths;
+    for (int i = 0; i < tabWidget->count(); ++i)
     {
-        QMessageBox::warning(this, "Error", QString("File couldn't be opened :\n%1").arg(file.errorString()));
-        return false;
+        const QString path = documentTab(i)->filePath();
+        if (!path.isEmpty() && !paths.contains(path))
+            paths.append(path);
     }
 
-    QTextStream in(&file);
-    textEditor->setPlainText(in.readAll());
+    // Created with the first file, there is nothing to watch at startup
+    if (!fileWatcher)
+    {
+        if (paths.isEmpty())
+            return;
+        fileWatcher = new QFileSystemWatcher(this);
+        connect(fileWatcher, &QFileSystemWatcher::fileChanged, this, &MainWindow::fileChangedOnDisk);
+    }
+
+    const QStringList watched = fileWatcher->files();
+    for (const QString &path : watched)
+    {
+        if (!paths.contains(path))
+            fileWatcher->removePath(path);
+    }
+    for (const QString &path : paths)
+    {
+        if (!watched.contains(path) && QFileInfo::exists(path))
+            fileWatcher->addPath(path);
+    }
+}
 
-    documentModified = false;
-    updateWindowTitle();
+void MainWindow::fileChangedOnDisk(const QString &filePath)
+{
+    // Replacing a file (atomic saves) ends the watch on it
+    if (!fileWatcher->files().contains(filePath) && QFileInfo::exists(filePath))
+        fileWatcher->addPath(filePath);
 
-    return true;
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        if (documentTab(i)->filePath() == filePath)
+            checkFile(documentTab(i));
+    }
+}
+
+void MainWindow::checkFile(DocumentTab *tab)
+{
+    // Unloaded tabs read the file anew, saves compare once written
+    if (askingReload || !tab->isLoaded() || tab->loader()->isRunning() || tab->saver()->isRunning())
+        return;
+
+    switch (tab->watcher()->check(tab->isModified()))
+    {
+        case DocumentWatcher::Changed:
+        {
+            const QString question = tab->isModified()
+                ? QString("%1 has changed on disk.\nDo you want to reload it and lose your changes ?")
+                : QString("%1 has changed on disk.\nDo you want to reload it ?");
+            askingReload = true;
+            const QMessageBox::StandardButton answer = QMessageBox::question(this, "File changed", question.arg(tab->displayName()));
+            askingReload = false;
+
+            if (answer == QMessageBox::Yes)
+                tab->watcher()->reload();
+            else
+                tab->watcher()->ignoreChange();
+            break;
+        }
+        case DocumentWatcher::Removed:
+            if (tab == currentTab())
+                statusLabel->setText(QString("%1 was removed from disk").arg(tab->displayName()));
+            break;
+        default:
+            break;
+    }
+}
+
+void MainWindow::documentReloaded(DocumentTab *tab, bool success)
+{
+    if (!success)
+    {
+        QMessageBox::warning(this, "Error", QString("File couldn't be read :\n%1").arg(tab->watcher()->errorString()));
+        return;
+    }
+
+    if (tab == currentTab())
+        statusLabel->setText(QString("%1 updated from disk").arg(tab->displayName()));
+}
+
+void MainWindow::updateLoadProgress(DocumentTab *tab, qint64 bytesRead, qint64 bytesTotal)
+{
+    const int percent = bytesTotal > 0 ? int(bytesRead * 100 / bytesTotal) : 100;
+    statusLabel->setText(QString("Loading %1 ... %2%").arg(tab->displayName()).arg(percent));
+}
+
+void MainWindow::documentLoaded(DocumentTab *tab, bool success, qint64 elapsedMs)
+{
+    if (!success)
+    {
+        // The tab is back to a new document
+        QMessageBox::warning(this, "Error", QString("File couldn't be loaded :\n%1").arg(tab->loader()->errorString()));
+        statusLabel->setText("Ready");
+        return;
+    }
+
+    statusLabel->setText(QString("File successfully opened (%1 ms)").arg(elapsedMs));
+
+    // Its size is known now
+    enforceMemoryBudget();
 }
 
-bool MainWindow::maybeSave()
+bool MainWindow::maybeSave(DocumentTab *tab)
 {
-    if (!documentModified)
+    if (!tab->isModified())
         return true;
 
-    QMessageBox::StandardButton result = QMessageBox::question(this, "Document modified", "Document has been modified.\nDo you want to save its changes ?", QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
+    tabWidget->setCurrentWidget(tab);
+    QMessageBox::StandardButton result = QMessageBox::question(this, "Document modified", QString("%1 has been modified.\nDo you want to save its changes ?").arg(tab->displayName()), QMessageBox::Save | QMessageBox::Discard | QMessageBox::Cancel);
 
     switch (result)
     {
         case QMessageBox::Save:
-            return saveFile(), true;
+            // The document is about to go away, wait for it to be on disk
+            return saveTab(tab) && tab->saver()->waitForFinished();
         case QMessageBox::Discard:
             return true;
         case QMessageBox::Cancel:
@@ -281,19 +748,24 @@ bool MainWindow::maybeSave()
     }
 }
 
-void MainWindow::setCurrentFile(const QString &filePath)
-{
-    currentFilePath = filePath;
-    documentModified = false;
-    updateWindowTitle();
-}
-
 void MainWindow::closeEvent(QCloseEvent *event)
 {
-    if (maybeSave())
-        event->accept();
-    else
-        event->ignore();
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        if (!maybeSave(documentTab(i)))
+        {
+            event->ignore();
+            return;
+        }
+    }
+
+    for (int i = 0; i < tabWidget->count(); ++i)
+    {
+        documentTab(i)->loader()->cancel();
+        documentTab(i)->watcher()->cancel();
+        documentTab(i)->saver()->waitForFinished();
+    }
+    event->accept();
 }
 
 void MainWindow::exitApplication()
@@ -303,103 +775,166 @@ void MainWindow::exitApplication()
 
 void MainWindow::updateCursorPosition()
 {
-    QTextCursor cursor = textEditor->textCursor();
+    // Line index lookups are O(log n), block numbers are only used mid-load
+    DocumentTab *tab = currentTab();
+    QTextCursor cursor = tab->editor()->textCursor();
+    qsizetype line = cursor.blockNumber() + 1;
+    qsizetype column = cursor.positionInBlock() + 1;
 
-    int line = cursor.blockNumber() + 1;
-    int column = cursor.columnNumber() + 1;
+    if (tab->buffer()->isTracking())
+    {
+        const TextSnapshot &text = tab->buffer()->table();
+        line = text.lineAt(cursor.position()) + 1;
+        column = text.columnAt(cursor.position()) + 1;
+    }
 
+    // Only formatted when it changed
+    if (line == shownLine && column == shownColumn)
+        return;
+    shownLine = line;
+    shownColumn = column;
     positionLabel->setText(QString("Line: %1, Colonne: %2").arg(line).arg(column));
 }
 
 void MainWindow::updateWindowTitle()
 {
-    QString title = "Mint - ";
-
-    if (currentFilePath.isEmpty())
-        title += "Untitled";
-    else
-    {
-        QFileInfo fileInfo(currentFilePath);
-        title += fileInfo.fileName();
-    }
+    DocumentTab *tab = currentTab();
+    QString title = "Mint - " + tab->displayName();
 
-    if (documentModified)
+    if (tab->isModified())
         title += " *";
 
-    setWindowTitle(title);
+    if (title != windowTitle())
+        setWindowTitle(title);
 }
 
 void MainWindow::updateEditActions()
 {
     // Activate actions only on editor's specific states
-    bool hasSelection = textEditor->textCursor().hasSelection();
+    bool hasSelection = currentTab()->editor()->textCursor().hasSelection();
+    if (hasSelection == shownSelection)
+        return;
+    shownSelection = hasSelection;
 
     cutAction->setEnabled(hasSelection);
     copyAction->setEnabled(hasSelection);
     // paste is automatically handled by Qt (if clipboard has content)
 }
 
+void MainWindow::goToLine()
+{
+    // Line numbers of a large file can pass an int, its view takes them
+    if (currentTab()->isLargeFile())
+    {
+        currentTab()->largeFileView()->showGoToLine();
+        return;
+    }
+
+    QPlainTextEdit *textEditor = currentTab()->editor();
+    const TextSnapshot &text = currentTab()->buffer()->table();
+    const int current = int(text.lineAt(textEditor->textCursor().position())) + 1;
+    const int lineCount = int(qMin(text.lineCount(), qsizetype(INT_MAX)));
+
+    bool ok = false;
+    const int line = QInputDialog::getInt(this, "Go to line", QString("Line (1 - %1):").arg(lineCount), current, 1, lineCount, 1, &ok);
+    if (!ok)
+        return;
+
+    QTextCursor cursor = textEditor->textCursor();
+    cursor.setPosition(int(text.lineStart(line - 1)));
+    textEditor->setTextCursor(cursor);
+    textEditor->centerCursor();
+}
+
 void MainWindow::showFindDialog()
 {
+    if (currentTab()->isLargeFile())
+    {
+        currentTab()->largeFileView()->showFind();
+        return;
+    }
+
     if (!findDialog)
-        findDialog = new FindDialog(textEditor, this);
+    {
+        findDialog = new FindDialog(currentTab()->editor(), currentTab()->buffer(), this);
+
+        // Hits are marked on the minimap of the tab searched
+        connect(findDialog, &FindDialog::matchesChanged, this, [this](QPlainTextEdit *textEdit, const QList<qsizetype> &positions) {
+            for (int i = 0; i < tabWidget->count(); ++i)
+            {
+                DocumentTab *tab = documentTab(i);
+                if (tab->editor() == textEdit && tab->minimap())
+                    tab->minimap()->setSearchHits(positions);
+            }
+        });
+    }
 
     findDialog->show();
     findDialog->raise();
     findDialog->activateWindow();
 }
 
+void MainWindow::showFindInFiles()
+{
+    if (!findInFilesPanel)
+    {
+        findInFilesPanel = new FindInFilesPanel(this);
+        addDockWidget(Qt::BottomDockWidgetArea, findInFilesPanel);
+        connect(findInFilesPanel, &FindInFilesPanel::openRequested, this, [this](const FileLocation &location) {
+            openLocations({ location });
+        });
+
+        // The folder of the current file, else where Mint was started
+        const QString filePath = currentTab()->filePath();
+        findInFilesPanel->setFolder(filePath.isEmpty() ? QDir::currentPath() : QFileInfo(filePath).absolutePath());
+    }
+
+    // A selection within a line is what to look for
+    const QString selection = currentTab()->editor()->textCursor().selectedText();
+    if (!selection.isEmpty() && !selection.contains(QChar::ParagraphSeparator))
+        findInFilesPanel->setPattern(selection);
+    findInFilesPanel->show();
+    findInFilesPanel->raise();
+}
 
 /* --------------- *
  *    UI STYLES    *
  * --------------- */
-void MainWindow::applyMintTheme()
-{
-    setStyleSheet(getMintStyleSheet());
-}
-
-QString MainWindow::getMintStyleSheet()
-{
-    const QString mainColor = "#4DD599";
-    const QString secondaryColor = "#00918E";
-    const QString accentColor1 = "#FFDC34";
-    const QString accentColor2 = "#110133";
-    const QString textColor1 = "#FFF3E1";
-    const QString bgLight = "#F8FFFE";
-    const QString bgWhite = "#FFFFFF";
-
-    return QString(R"(
+// Built at compile time, with the palette written in: main #4DD599,
+// secondary #00918E, accents #FFDC34 and #110133, light text #FFF3E1,
+// backgrounds #FFFFFF and #F8FFFE
+static const char MintStyleSheet[] = R"(
         /* === FENÊTRE PRINCIPALE === */
         QMainWindow {
-            background-color: %1;
-            color: %2;
+            background-color: #4DD599;
+            color: #110133;
         }
 
         /* === ÉDITEUR DE TEXTE === */
-        QTextEdit {
-            background-color: %3;
-            color: %2;
-            border: 2px solid %1;
+        QTextEdit, QPlainTextEdit {
+            background-color: #FFFFFF;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 6px;
             font-family: 'Consolas', 'Courier New', monospace;
             font-size: 11pt;
             padding: 8px;
-            selection-background-color: %1;
-            selection-color: %2;
+            selection-background-color: #4DD599;
+            selection-color: #110133;
         }
 
-        QTextEdit:focus {
-            border: 2px solid %4;
+        QTextEdit:focus, QPlainTextEdit:focus {
+            border: 2px solid #00918E;
             background-color: #FDFFFD;
         }
 
         /* === BARRE DE MENUS === */
         QMenuBar {
-            background-color: %1;
-            color: %2;
+            background-color: #4DD599;
+            color: #110133;
             font-weight: 500;
             padding: 4px;
-            border-bottom: 2px solid %4;
+            border-bottom: 2px solid #00918E;
         }
 
         QMenuBar::item {
@@ -410,20 +945,20 @@ QString MainWindow::getMintStyleSheet()
         }
 
         QMenuBar::item:selected {
-            background-color: %4;
-            color: %5;
+            background-color: #00918E;
+            color: #FFF3E1;
         }
 
         QMenuBar::item:pressed {
-            background-color: %6;
-            color: %2;
+            background-color: #FFDC34;
+            color: #110133;
         }
 
         /* === MENUS DÉROULANTS === */
         QMenu {
-            background-color: %3;
-            color: %2;
-            border: 2px solid %1;
+            background-color: #FFFFFF;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 6px;
             padding: 4px;
         }
@@ -435,26 +970,26 @@ QString MainWindow::getMintStyleSheet()
         }
 
         QMenu::item:selected {
-            background-color: %1;
-            color: %2;
+            background-color: #4DD599;
+            color: #110133;
         }
 
         QMenu::separator {
             height: 2px;
-            background-color: %1;
+            background-color: #4DD599;
             margin: 4px 8px;
         }
 
         /* === BARRES D'OUTILS === */
         QToolBar {
-            background-color: %1;
+            background-color: #4DD599;
             border: none;
             padding: 4px;
             spacing: 2px;
         }
 
         QToolBar::separator {
-            background-color: %4;
+            background-color: #00918E;
             width: 2px;
             margin: 4px 2px;
         }
@@ -462,7 +997,7 @@ QString MainWindow::getMintStyleSheet()
         /* === BOUTONS D'ACTION === */
         QToolBar QToolButton {
             background-color: transparent;
-            color: %2;
+            color: #110133;
             border: 1px solid transparent;
             border-radius: 4px;
             padding: 6px;
@@ -471,14 +1006,14 @@ QString MainWindow::getMintStyleSheet()
         }
 
         QToolBar QToolButton:hover {
-            background-color: %4;
-            color: %5;
-            border: 1px solid %4;
+            background-color: #00918E;
+            color: #FFF3E1;
+            border: 1px solid #00918E;
         }
 
         QToolBar QToolButton:pressed {
-            background-color: %6;
-            color: %2;
+            background-color: #FFDC34;
+            color: #110133;
         }
 
         QToolBar QToolButton:disabled {
@@ -488,27 +1023,27 @@ QString MainWindow::getMintStyleSheet()
 
         /* === BARRE D'ÉTAT === */
         QStatusBar {
-            background-color: %4;
-            color: %5;
-            border-top: 2px solid %1;
+            background-color: #00918E;
+            color: #FFF3E1;
+            border-top: 2px solid #4DD599;
             font-weight: 500;
         }
 
         QStatusBar QLabel {
-            color: %5;
+            color: #FFF3E1;
             padding: 4px 8px;
         }
 
         /* === DIALOGS ET BOUTONS === */
         QDialog {
-            background-color: %7;
-            color: %2;
+            background-color: #F8FFFE;
+            color: #110133;
         }
 
         QPushButton {
-            background-color: %1;
-            color: %2;
-            border: 2px solid %1;
+            background-color: #4DD599;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 6px;
             padding: 8px 16px;
             font-weight: 500;
@@ -516,15 +1051,15 @@ QString MainWindow::getMintStyleSheet()
         }
 
         QPushButton:hover {
-            background-color: %4;
-            color: %5;
-            border-color: %4;
+            background-color: #00918E;
+            color: #FFF3E1;
+            border-color: #00918E;
         }
 
         QPushButton:pressed {
-            background-color: %6;
-            color: %2;
-            border-color: %6;
+            background-color: #FFDC34;
+            color: #110133;
+            border-color: #FFDC34;
         }
 
         QPushButton:disabled {
@@ -535,52 +1070,52 @@ QString MainWindow::getMintStyleSheet()
 
         /* === CHAMPS DE SAISIE === */
         QLineEdit {
-            background-color: %3;
-            color: %2;
-            border: 2px solid %1;
+            background-color: #FFFFFF;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 4px;
             padding: 6px;
             font-size: 10pt;
         }
 
         QLineEdit:focus {
-            border-color: %4;
+            border-color: #00918E;
             background-color: #FDFFFD;
         }
 
         /* === CASES À COCHER === */
         QCheckBox {
-            color: %2;
+            color: #110133;
             font-weight: 500;
         }
 
         QCheckBox::indicator {
             width: 16px;
             height: 16px;
-            border: 2px solid %1;
+            border: 2px solid #4DD599;
             border-radius: 3px;
-            background-color: %3;
+            background-color: #FFFFFF;
         }
 
         QCheckBox::indicator:checked {
-            background-color: %1;
-            border-color: %4;
+            background-color: #4DD599;
+            border-color: #00918E;
         }
 
         QCheckBox::indicator:hover {
-            border-color: %4;
+            border-color: #00918E;
         }
 
         /* === LABELS === */
         QLabel {
-            color: %2;
+            color: #110133;
         }
 
         /* === GROUPBOX === */
         QGroupBox {
-            color: %2;
+            color: #110133;
             font-weight: bold;
-            border: 2px solid %1;
+            border: 2px solid #4DD599;
             border-radius: 6px;
             margin-top: 10px;
             padding-top: 4px;
@@ -590,11 +1125,33 @@ QString MainWindow::getMintStyleSheet()
             subcontrol-origin: margin;
             left: 10px;
             padding: 0 8px 0 8px;
-            background-color: %1;
-            color: %2;
+            background-color: #4DD599;
+            color: #110133;
             border-radius: 4px;
         }
 
+        /* === ONGLETS === */
+        QTabBar::tab {
+            background-color: #F8FFFE;
+            color: #110133;
+            border: 1px solid #4DD599;
+            border-bottom: none;
+            border-top-left-radius: 4px;
+            border-top-right-radius: 4px;
+            padding: 6px 12px;
+            margin-right: 2px;
+        }
+
+        QTabBar::tab:selected {
+            background-color: #4DD599;
+            font-weight: 500;
+        }
+
+        QTabBar::tab:hover:!selected {
+            background-color: #FFFFFF;
+            border-color: #00918E;
+        }
+
         /* === SCROLLBARS === */
         QScrollBar:vertical {
             background-color: #F0F0F0;
@@ -603,27 +1160,27 @@ QString MainWindow::getMintStyleSheet()
         }
 
         QScrollBar::handle:vertical {
-            background-color: %1;
+            background-color: #4DD599;
             border-radius: 6px;
             min-height: 20px;
         }
 
         QScrollBar::handle:vertical:hover {
-            background-color: %4;
+            background-color: #00918E;
         }
 
         /* === COMBO BOX === */
         QComboBox {
-            background-color: %3;
-            color: %2;
-            border: 2px solid %1;
+            background-color: #FFFFFF;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 4px;
             padding: 6px;
             min-width: 100px;
         }
 
         QComboBox:hover {
-            border-color: %4;
+            border-color: #00918E;
         }
 
         QComboBox::drop-down {
@@ -637,27 +1194,24 @@ QString MainWindow::getMintStyleSheet()
             image: none;
             border-left: 6px solid transparent;
             border-right: 6px solid transparent;
-            border-top: 6px solid %2;
+            border-top: 6px solid #110133;
         }
 
         /* === SPINBOX === */
         QSpinBox {
-            background-color: %3;
-            color: %2;
-            border: 2px solid %1;
+            background-color: #FFFFFF;
+            color: #110133;
+            border: 2px solid #4DD599;
             border-radius: 4px;
             padding: 6px;
         }
 
         QSpinBox:focus {
-            border-color: %4;
-        }
-    )")
-        .arg(mainColor)      // %1
-        .arg(accentColor2)   // %2
-        .arg(bgWhite)        // %3
-        .arg(secondaryColor) // %4
-        .arg(textColor1)     // %5
-        .arg(accentColor1)   // %6
-        .arg(bgLight);       // %7
+            border-color: #00918E;
+        }
+    )";
+
+void MainWindow::applyMintTheme()
+{
+    setStyleSheet(QString::fromUtf8(MintStyleSheet));
 }
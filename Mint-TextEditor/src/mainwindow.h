@@ -2,7 +2,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
-#include <QTextEdit>
+#include <QPlainTextEdit>
 #include <QMenuBar>
 #include <QToolBar>
 #include <QStatusBar>
@@ -12,8 +12,15 @@
 #include <QMessageBox>
 #include <QTextStream>
 #include <QFileInfo>
+#include <QTabWidget>
+#include <QFileSystemWatcher>
 
 #include "FindDialog.h"
+#include "DocumentTab.h"
+#include "FileLocation.h"
+#include "StatsPanel.h"
+#include "FindInFilesPanel.h"
+#include "UpdateScheduler.h"
 
 QT_BEGIN_NAMESPACE
 QT_END_NAMESPACE
@@ -23,36 +30,48 @@ class MainWindow : public QMainWindow
     Q_OBJECT
 
 public:
-    MainWindow(QWidget *parent = nullptr);
+    explicit MainWindow(const QList<FileLocation> &files = {}, QWidget *parent = nullptr);
     ~MainWindow();
 
+    // Opens files in new tabs, or shows their tab if they already are
+    void openLocations(const QList<FileLocation> &locations);
+
 private:
     // UI styles
     void applyMintTheme();
-    QString getMintStyleSheet();
     // Initialization methods
     void setupUI();
     void createMenus();
     void createToolBars();
     void createStatusBar();
     void createActions();
+    // Tabs handling methods
+    DocumentTab *currentTab() const;
+    DocumentTab *documentTab(int index) const;
+    DocumentTab *addTab(const QString &filePath);
+    void updateTabTitle(DocumentTab *tab);
+    void enforceMemoryBudget(); // unloads least recently used clean tabs
+    void updateWatchedFiles();
+    void checkFile(DocumentTab *tab); // follows or offers to reload a changed file
     // File handling methods
-    bool saveDocument(const QString &filePath);
-    bool loadDocument(const QString &filePath);
-    bool maybeSave(); // ask if save is needed
-    void setCurrentFile(const QString &filePath);
+    bool saveTab(DocumentTab *tab);
+    bool saveTabAs(DocumentTab *tab);
+    bool saveDocument(DocumentTab *tab, const QString &filePath);
+    bool maybeSave(DocumentTab *tab); // ask if save is needed
 
     // Main widgets
-    QTextEdit *textEditor;
+    QTabWidget *tabWidget;
     // Menus
     QMenu *fileMenu;
     QMenu *editMenu;
+    QMenu *viewMenu;
     QMenu *helpMenu;
     // User/File actions
     QAction *newAction;
     QAction *openAction;
     QAction *saveAction;
     QAction *saveAsAction;
+    QAction *closeTabAction;
     QAction *exitAction;
     // Editing actions
     QAction *undoAction;
@@ -62,29 +81,60 @@ private:
     QAction *pasteAction;
     QAction *selectAllAction;
     QAction *findAction;
+    QAction *findInFilesAction;
+    QAction *goToLineAction;
+    // View actions
+    QAction *previewAction;
+    QAction *minimapAction;
+    QAction *followAction;
+    QAction *statsAction;
     FindDialog *findDialog;
+    StatsPanel *statsPanel;
+    FindInFilesPanel *findInFilesPanel;
     // Toolbars
     QToolBar *fileToolBar;
     QStatusBar *myStatusBar;
     QLabel * statusLabel;
     QLabel *positionLabel;
+    QLabel *formatLabel;
+    // Coalesced refreshes, and what they last showed
+    UpdateScheduler *updates;
+    int cursorPart;
+    int titlePart;
+    int actionsPart;
+    int formatPart;
+    qsizetype shownLine;
+    qsizetype shownColumn;
+    bool shownSelection;
     // Core features
-    bool documentModified;
-    QString currentFilePath;
+    quint64 activationCount; // orders tabs by last use
+    QFileSystemWatcher *fileWatcher;
+    bool askingReload;
 
 private slots:
     // Menu actions' slots
     void newFile();
     void openFile();
-    void saveFile();
-    void saveAsFile();
+    bool saveFile();
+    bool saveAsFile();
+    bool closeTab(int index);
     void exitApplication();
     // Core features
     void updateCursorPosition();
     void updateWindowTitle();
     void updateEditActions();
+    void currentTabChanged(int index);
+    void recoverDocuments(); // from the journals of a session that crashed
+    void fileChangedOnDisk(const QString &filePath);
     // UI
     void showFindDialog();
+    void showFindInFiles();
+    void goToLine();
+    void updateLoadProgress(DocumentTab *tab, qint64 bytesRead, qint64 bytesTotal);
+    void documentLoaded(DocumentTab *tab, bool success, qint64 elapsedMs);
+    void updateSaveProgress(DocumentTab *tab, qint64 charsWritten, qint64 charsTotal);
+    void documentSaved(DocumentTab *tab, bool success, qint64 elapsedMs, qint64 peakMemory);
+    void documentReloaded(DocumentTab *tab, bool success);
 
 protected:
     void closeEvent(QCloseEvent *event) override;
@@ -0,0 +1,91 @@
+# Editor core, shared by the application and the tests
+
+# Base project config
+QT += core widgets network
+
+# Modern C++
+CONFIG += c++17
+
+INCLUDEPATH += $$PWD
+
+# Sources folder
+SOURCES += \
+    $$PWD/MainWindow.cpp \
+    $$PWD/FindDialog.cpp \
+    $$PWD/FindInFilesPanel.cpp \
+    $$PWD/FileSearch.cpp \
+    $$PWD/DocumentLoader.cpp \
+    $$PWD/DocumentTab.cpp \
+    $$PWD/LargeFileView.cpp \
+    $$PWD/DocumentJournal.cpp \
+    $$PWD/DocumentWatcher.cpp \
+    $$PWD/FileLocation.cpp \
+    $$PWD/LineDiff.cpp \
+    $$PWD/LineIndex.cpp \
+    $$PWD/PieceTable.cpp \
+    $$PWD/TextBuffer.cpp \
+    $$PWD/TextHash.cpp \
+    $$PWD/TextFormat.cpp \
+    $$PWD/TextMatcher.cpp \
+    $$PWD/TextEditor.cpp \
+    $$PWD/Trace.cpp \
+    $$PWD/UpdateScheduler.cpp \
+    $$PWD/UndoHistory.cpp \
+    $$PWD/Minimap.cpp \
+    $$PWD/StatsPanel.cpp \
+    $$PWD/SearchEngine.cpp \
+    $$PWD/DocumentSaver.cpp \
+    $$PWD/ProcessMemory.cpp \
+    $$PWD/StartupBenchmark.cpp \
+    $$PWD/Benchmark.cpp \
+    $$PWD/SingleInstance.cpp \
+    $$PWD/SyntaxLanguage.cpp \
+    $$PWD/SyntaxHighlighter.cpp \
+    $$PWD/MarkdownParser.cpp \
+    $$PWD/MarkdownConverter.cpp \
+    $$PWD/MarkdownPreview.cpp
+
+# Header files
+HEADERS += \
+    $$PWD/MainWindow.h \
+    $$PWD/FindDialog.h \
+    $$PWD/FindInFilesPanel.h \
+    $$PWD/FileSearch.h \
+    $$PWD/DocumentLoader.h \
+    $$PWD/DocumentTab.h \
+    $$PWD/LargeFileView.h \
+    $$PWD/DocumentJournal.h \
+    $$PWD/DocumentWatcher.h \
+    $$PWD/FileLocation.h \
+    $$PWD/LineDiff.h \
+    $$PWD/LineIndex.h \
+    $$PWD/PieceTable.h \
+    $$PWD/TextBuffer.h \
+    $$PWD/TextHash.h \
+    $$PWD/TextFormat.h \
+    $$PWD/Simd.h \
+    $$PWD/TextMatcher.h \
+    $$PWD/TextEditor.h \
+    $$PWD/Trace.h \
+    $$PWD/UpdateScheduler.h \
+    $$PWD/UndoHistory.h \
+    $$PWD/Minimap.h \
+    $$PWD/StatsPanel.h \
+    $$PWD/SearchEngine.h \
+    $$PWD/DocumentSaver.h \
+    $$PWD/ProcessMemory.h \
+    $$PWD/StartupBenchmark.h \
+    $$PWD/Benchmark.h \
+    $$PWD/SingleInstance.h \
+    $$PWD/SyntaxLanguage.h \
+    $$PWD/SyntaxHighlighter.h \
+    $$PWD/MarkdownParser.h \
+    $$PWD/MarkdownConverter.h \
+    $$PWD/MarkdownPreview.h
+
+# Peak memory reports
+win32: LIBS += -lpsapi
+
+# Interface files
+FORMS += \
+    $$PWD/MainWindow.ui
@@ -0,0 +1,9 @@
+include(../tests.pri)
+
+# Run by "make benchmark", not "make check"
+CONFIG += benchmark
+
+TARGET = tst_benchmark
+
+SOURCES += \
+    tst_benchmark.cpp
@@ -0,0 +1,162 @@
+#include <QtTest>
+#include <QJsonObject>
+#include <QTemporaryDir>
+
+#include "Benchmark.h"
+#include "LineDiff.h"
+#include "PieceTable.h"
+
+// The measurements of "Mint --benchmark" as QTest results, so they can be
+// tracked with the usual tools:
+//   tst_benchmark -o results.xml,xml
+// Every time and memory figure of a run is one row, for each file size in
+// MINT_BENCHMARK_SIZES (MB, "1,16" by default), and 100 MB and 1 GB ones
+// with MINT_BENCHMARK_LARGE=1. Paging through a document of
+// MINT_BENCHMARK_LINES lines (10000000 say) is only measured when set.
+// A few QBENCHMARK loops over the editor core follow.
+class TestBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void initMain();
+
+private slots:
+    void editor_data();
+    void editor();
+    void scrolling_data();
+    void scrolling();
+    void pieceTableTyping();
+    void lineDiff();
+
+private:
+    static void addRows(const QString &size, const QString &path, const QJsonObject &object);
+
+    QTemporaryDir folder;
+};
+
+void TestBenchmark::initMain()
+{
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    // Its own settings, the user's recovery list isn't touched
+    QCoreApplication::setOrganizationName("Mint");
+    QCoreApplication::setApplicationName("Mint Benchmark");
+}
+
+void TestBenchmark::addRows(const QString &size, const QString &path, const QJsonObject &object)
+{
+    for (auto it = object.constBegin(); it != object.constEnd(); ++it)
+    {
+        const QString key = path.isEmpty() ? it.key() : path + '/' + it.key();
+        if (it->isObject())
+        {
+            addRows(size, key, it->toObject());
+            continue;
+        }
+        if (!it->isDouble())
+            continue;
+
+        // Times as milliseconds, memory as bytes; counts and rates aren't results
+        if (key.endsWith("ms") || key.endsWith("Ms"))
+            QTest::addRow("%s %s", qPrintable(size), qPrintable(key)) << it->toDouble() << int(QTest::WalltimeMilliseconds) << QString();
+        else if (key.endsWith("us") || key.endsWith("Us"))
+            QTest::addRow("%s %s", qPrintable(size), qPrintable(key)) << it->toDouble() / 1e3 << int(QTest::WalltimeMilliseconds) << QString();
+        else if (key.endsWith("Bytes"))
+            QTest::addRow("%s %s", qPrintable(size), qPrintable(key)) << it->toDouble() << int(QTest::BytesAllocated) << QString();
+    }
+}
+
+void TestBenchmark::editor_data()
+{
+    QTest::addColumn<double>("value");
+    QTest::addColumn<int>("metric"); // QTest::QBenchmarkMetric
+    QTest::addColumn<QString>("error");
+
+    QVERIFY(folder.isValid());
+    QStringList sizes = qEnvironmentVariable("MINT_BENCHMARK_SIZES", "1,16").split(',', Qt::SkipEmptyParts);
+    if (qEnvironmentVariableIntValue("MINT_BENCHMARK_LARGE") > 0)
+    {
+        for (qint64 size : Benchmark::largeSizes())
+            sizes.append(QString::number(size / (1024 * 1024)));
+    }
+    for (const QString &megabytes : std::as_const(sizes))
+    {
+        const QString size = megabytes.trimmed() + "MB";
+        const QJsonObject run = Benchmark::measure(folder.path(), qint64(megabytes.trimmed().toDouble() * 1024 * 1024));
+        if (run.contains("error"))
+            QTest::addRow("%s", qPrintable(size)) << 0.0 << int(QTest::WalltimeMilliseconds) << run.value("error").toString();
+        else
+            addRows(size, QString(), run);
+    }
+}
+
+void TestBenchmark::editor()
+{
+    QFETCH(double, value);
+    QFETCH(int, metric);
+    QFETCH(QString, error);
+
+    if (!error.isEmpty())
+        QFAIL(qPrintable(error));
+    QTest::setBenchmarkResult(value, QTest::QBenchmarkMetric(metric));
+}
+
+void TestBenchmark::scrolling_data()
+{
+    QTest::addColumn<double>("value");
+    QTest::addColumn<int>("metric");
+    QTest::addColumn<QString>("error");
+
+    const int lines = qEnvironmentVariableIntValue("MINT_BENCHMARK_LINES");
+    if (lines <= 0)
+    {
+        QTest::newRow("not measured") << 0.0 << int(QTest::WalltimeMilliseconds) << QString();
+        return;
+    }
+
+    QVERIFY(folder.isValid());
+    const QString name = QString("%1 lines").arg(lines);
+    const QJsonObject run = Benchmark::scroll(folder.path(), lines);
+    if (run.contains("error"))
+        QTest::addRow("%s", qPrintable(name)) << 0.0 << int(QTest::WalltimeMilliseconds) << run.value("error").toString();
+    else
+        addRows(name, QString(), run);
+}
+
+void TestBenchmark::scrolling()
+{
+    if (qEnvironmentVariableIntValue("MINT_BENCHMARK_LINES") <= 0)
+        QSKIP("Set MINT_BENCHMARK_LINES to page through a document of that many lines");
+    editor();
+}
+
+void TestBenchmark::pieceTableTyping()
+{
+    // Characters typed in the middle of a 16 MB text
+    PieceTable table;
+    table.reset(QSharedPointer<TextChunk>::create(QString(16 * 1024 * 1024, u'x')));
+    qsizetype position = table.length() / 2;
+    QBENCHMARK
+    {
+        table.insert(position++, u"a");
+    }
+}
+
+void TestBenchmark::lineDiff()
+{
+    // A reload of a 100,000 line file with one line changed
+    QString oldText;
+    for (int i = 0; i < 100000; ++i)
+        oldText += QString("line %1 of the file\n").arg(i);
+    QString newText = oldText;
+    newText.replace("line 50000 of", "line 50000 in");
+
+    QBENCHMARK
+    {
+        LineDiff::compute(oldText, newText);
+    }
+}
+
+QTEST_MAIN(TestBenchmark)
+#include "tst_benchmark.moc"
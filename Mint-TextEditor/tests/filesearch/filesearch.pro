@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_filesearch
+
+SOURCES += \
+    tst_filesearch.cpp
@@ -0,0 +1,80 @@
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "FileSearch.h"
+
+// Which files a search in files looks at, given .gitignore and .ignore files
+class TestFileSearch : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void ignoreFiles();
+    void fileFilters();
+
+private:
+    static bool write(const QString &filePath, const QByteArray &contents);
+    static QStringList search(const QString &folder, const QStringList &fileFilters = QStringList());
+};
+
+bool TestFileSearch::write(const QString &filePath, const QByteArray &contents)
+{
+    QDir().mkpath(QFileInfo(filePath).path());
+    QFile file(filePath);
+    return file.open(QIODevice::WriteOnly) && file.write(contents) == contents.size();
+}
+
+// Files with a match, relative to the folder and sorted
+QStringList TestFileSearch::search(const QString &folder, const QStringList &fileFilters)
+{
+    FileSearch search;
+    QStringList files;
+    QObject::connect(&search, &FileSearch::fileMatched, [&files, folder](const QString &filePath) {
+        files.append(QDir(folder).relativeFilePath(filePath));
+    });
+    QSignalSpy finished(&search, &FileSearch::finished);
+
+    FileSearch::Options options;
+    options.pattern = "needle";
+    options.fileFilters = fileFilters;
+    if (!search.start(folder, options) || !finished.wait(10000))
+        return QStringList{ "search failed" };
+
+    files.sort();
+    return files;
+}
+
+void TestFileSearch::ignoreFiles()
+{
+    QTemporaryDir folder;
+    QVERIFY(folder.isValid());
+    const QString root = folder.path() + '/';
+
+    QVERIFY(write(root + ".gitignore", "# comment\n*.log\nbuild/\n/root.txt\n!keep.log\ndocs/**/draft.md\ntemp?.txt\n"));
+    QVERIFY(write(root + "sub/.gitignore", "!*.log\n"));
+    QVERIFY(write(root + "sub/.ignore", "e.txt\n"));
+
+    const QStringList searched = { "a.txt", "docs/final.md", "keep.log", "other/build", "sub/f.log", "sub/root.txt", "temp12.txt" };
+    const QStringList ignored = { "b.log",       "build/c.txt", "sub/build/d.txt", "root.txt",
+                                  "docs/draft.md", "docs/x/y/draft.md", "sub/e.txt", "temp1.txt", ".hidden.txt" };
+    for (const QString &file : searched + ignored)
+        QVERIFY(write(root + file, "a needle in a file\n"));
+
+    QCOMPARE(search(folder.path()), searched);
+}
+
+void TestFileSearch::fileFilters()
+{
+    QTemporaryDir folder;
+    QVERIFY(folder.isValid());
+    const QString root = folder.path() + '/';
+
+    for (const QString &file : { "a.cpp", "a.h", "a.txt", "sub/b.CPP" })
+        QVERIFY(write(root + file, "needle\n"));
+
+    QCOMPARE(search(folder.path(), { "*.cpp", " *.h " }), QStringList({ "a.cpp", "a.h", "sub/b.CPP" }));
+    QCOMPARE(search(folder.path()), QStringList({ "a.cpp", "a.h", "a.txt", "sub/b.CPP" }));
+}
+
+QTEST_GUILESS_MAIN(TestFileSearch)
+#include "tst_filesearch.moc"
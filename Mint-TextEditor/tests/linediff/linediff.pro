@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_linediff
+
+SOURCES += \
+    tst_linediff.cpp
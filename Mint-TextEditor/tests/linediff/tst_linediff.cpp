@@ -0,0 +1,93 @@
+#include <QtTest>
+
+#include "LineDiff.h"
+
+// Hunks have to turn the old text into the new one, and stay small
+class TestLineDiff : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void compute_data();
+    void compute();
+    void tooManyEdits();
+
+private:
+    static QString apply(QString text, const QString &newText, const QList<LineDiff::Hunk> &hunks);
+};
+
+QString TestLineDiff::apply(QString text, const QString &newText, const QList<LineDiff::Hunk> &hunks)
+{
+    // From the last one, like DocumentWatcher does
+    for (qsizetype i = hunks.size(); i-- > 0;)
+    {
+        const LineDiff::Hunk &hunk = hunks.at(i);
+        text.replace(hunk.position, hunk.removed, newText.mid(hunk.from, hunk.added));
+    }
+    return text;
+}
+
+void TestLineDiff::compute_data()
+{
+    QTest::addColumn<QString>("oldText");
+    QTest::addColumn<QString>("newText");
+    QTest::addColumn<int>("hunkCount");
+    QTest::addColumn<int>("changedCharacters"); // removed and added, all hunks
+
+    QTest::newRow("same") << "a\nb\nc\n" << "a\nb\nc\n" << 0 << 0;
+    QTest::newRow("both empty") << "" << "" << 0 << 0;
+    QTest::newRow("from empty") << "" << "a\nb\n" << 1 << 4;
+    QTest::newRow("to empty") << "a\nb\n" << "" << 1 << 4;
+    QTest::newRow("line inserted") << "a\nb\nc\n" << "a\nb\nx\nc\n" << 1 << 2;
+    QTest::newRow("line removed") << "a\nb\nc\n" << "a\nc\n" << 1 << 2;
+    QTest::newRow("line changed") << "a\nb\nc\n" << "a\nB\nc\n" << 1 << 4;
+    QTest::newRow("two places") << "1\n2\n3\n4\n5\n6\n" << "1\nx\n3\n4\n5\ny\n" << 2 << 8;
+    QTest::newRow("last line without newline") << "a\nb" << "a\nbc" << 1 << 3;
+    QTest::newRow("newline added at the end") << "a\nb" << "a\nb\n" << 1 << 3;
+    QTest::newRow("repeated lines") << "x\nx\nx\n" << "x\nx\nx\nx\n" << 1 << 2;
+}
+
+void TestLineDiff::compute()
+{
+    QFETCH(QString, oldText);
+    QFETCH(QString, newText);
+    QFETCH(int, hunkCount);
+    QFETCH(int, changedCharacters);
+
+    const QList<LineDiff::Hunk> hunks = LineDiff::compute(oldText, newText);
+    QCOMPARE(apply(oldText, newText, hunks), newText);
+    QCOMPARE(hunks.size(), qsizetype(hunkCount));
+
+    qsizetype changed = 0;
+    qsizetype previousEnd = 0;
+    for (const LineDiff::Hunk &hunk : hunks)
+    {
+        QVERIFY(hunk.position >= previousEnd);
+        previousEnd = hunk.position + hunk.removed;
+        changed += hunk.removed + hunk.added;
+    }
+    QCOMPARE(changed, qsizetype(changedCharacters));
+}
+
+void TestLineDiff::tooManyEdits()
+{
+    // Every other line changed, past the limit: one hunk over the middle
+    QString oldText;
+    QString newText;
+    for (int i = 0; i < 100; ++i)
+    {
+        oldText += QString("line %1\n").arg(i);
+        newText += i % 2 ? QString("changed %1\n").arg(i) : QString("line %1\n").arg(i);
+    }
+
+    const QList<LineDiff::Hunk> limited = LineDiff::compute(oldText, newText, 10);
+    QCOMPARE(apply(oldText, newText, limited), newText);
+    QCOMPARE(limited.size(), qsizetype(1));
+
+    const QList<LineDiff::Hunk> full = LineDiff::compute(oldText, newText);
+    QCOMPARE(apply(oldText, newText, full), newText);
+    QCOMPARE(full.size(), qsizetype(50));
+}
+
+QTEST_APPLESS_MAIN(TestLineDiff)
+#include "tst_linediff.moc"
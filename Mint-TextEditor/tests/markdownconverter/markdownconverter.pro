@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_markdownconverter
+
+SOURCES += \
+    tst_markdownconverter.cpp
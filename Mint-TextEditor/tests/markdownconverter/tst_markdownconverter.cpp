@@ -0,0 +1,113 @@
+#include <QtTest>
+
+#include "MarkdownConverter.h"
+
+// An update after an edit has to give the blocks of a full conversion, and
+// only send the preview the blocks whose HTML changed
+class TestMarkdownConverter : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void update_data();
+    void update();
+    void onlyChangedBlocks();
+
+private:
+    static MarkdownConverter::Update convert(const QStringList &lines, const QList<MarkdownConverter::Block> &previous,
+                                             qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta);
+    static MarkdownConverter::Update convertAll(const QStringList &lines);
+};
+
+MarkdownConverter::Update TestMarkdownConverter::convert(const QStringList &lines, const QList<MarkdownConverter::Block> &previous,
+                                                         qsizetype dirtyFirst, qsizetype dirtyLast, qsizetype lineDelta)
+{
+    MarkdownConverter::Update result;
+    MarkdownConverter::convertBlocks([&lines](qsizetype i) { return lines.at(i); }, lines.size(), previous, dirtyFirst, dirtyLast,
+                                     lineDelta, &result);
+    return result;
+}
+
+MarkdownConverter::Update TestMarkdownConverter::convertAll(const QStringList &lines)
+{
+    // As MarkdownConverter::convert() does
+    return convert(lines, QList<MarkdownConverter::Block>(), 0, lines.size(), 0);
+}
+
+void TestMarkdownConverter::update_data()
+{
+    QTest::addColumn<QString>("oldText");
+    QTest::addColumn<int>("line");    // first line replaced
+    QTest::addColumn<int>("removed"); // lines replaced
+    QTest::addColumn<QString>("inserted");
+
+    const QString document = "# Title\n\npara one\n\npara two\ngoes on\n\n- item\n- item\n\n    code\n\npara three";
+    QTest::newRow("paragraph edited") << document << 4 << 1 << "para 2";
+    QTest::newRow("paragraph split") << document << 5 << 0 << "";
+    QTest::newRow("paragraphs joined") << document << 3 << 1 << "still para one";
+    QTest::newRow("fence opened") << document << 3 << 0 << "```";
+    QTest::newRow("fence closed") << "```\ncode\n\npara" << 2 << 1 << "```";
+    QTest::newRow("setext heading") << document << 6 << 0 << "===";
+    QTest::newRow("list item added") << document << 9 << 0 << "- another";
+    QTest::newRow("quote started") << document << 2 << 1 << "> para one";
+    QTest::newRow("end removed") << document << 9 << 4 << "";
+    QTest::newRow("start removed") << document << 0 << 2 << "";
+    QTest::newRow("everything replaced") << document << 0 << 13 << "new\n\ntext";
+}
+
+void TestMarkdownConverter::update()
+{
+    QFETCH(QString, oldText);
+    QFETCH(int, line);
+    QFETCH(int, removed);
+    QFETCH(QString, inserted);
+
+    const QStringList oldLines = oldText.split(u'\n');
+    QStringList newLines = oldLines;
+    newLines.remove(line, removed);
+    const QStringList insertedLines = inserted.isEmpty() && removed > 0 ? QStringList() : inserted.split(u'\n');
+    for (qsizetype i = 0; i < insertedLines.size(); ++i)
+        newLines.insert(line + i, insertedLines.at(i));
+
+    const MarkdownConverter::Update before = convertAll(oldLines);
+    const MarkdownConverter::Update expected = convertAll(newLines);
+
+    // The lines the preview marks dirty, in the new text
+    const qsizetype lineDelta = newLines.size() - oldLines.size();
+    const qsizetype dirtyLast = qMax(qsizetype(line), line + insertedLines.size() - 1);
+    const MarkdownConverter::Update updated = convert(newLines, before.blocks, line, dirtyLast, lineDelta);
+
+    QCOMPARE(updated.blocks.size(), expected.blocks.size());
+    for (qsizetype i = 0; i < expected.blocks.size(); ++i)
+    {
+        QCOMPARE(updated.blocks.at(i).firstLine, expected.blocks.at(i).firstLine);
+        QCOMPARE(updated.blocks.at(i).lineCount, expected.blocks.at(i).lineCount);
+        QCOMPARE(updated.blocks.at(i).html, expected.blocks.at(i).html);
+    }
+
+    // What the preview ends up showing
+    QStringList html;
+    for (const MarkdownConverter::Block &block : before.blocks)
+        html.append(block.html);
+    html.remove(updated.first, updated.removed);
+    for (qsizetype i = 0; i < updated.html.size(); ++i)
+        html.insert(updated.first + i, updated.html.at(i));
+    QCOMPARE(html, expected.html);
+}
+
+void TestMarkdownConverter::onlyChangedBlocks()
+{
+    QStringList lines = QString("# Title\n\npara one\n\npara two\n\npara three").split(u'\n');
+    const MarkdownConverter::Update before = convertAll(lines);
+    QCOMPARE(before.blocks.size(), qsizetype(4));
+
+    lines[4] = "para 2";
+    const MarkdownConverter::Update updated = convert(lines, before.blocks, 4, 4, 0);
+    QCOMPARE(updated.first, qsizetype(2));
+    QCOMPARE(updated.removed, qsizetype(1));
+    QCOMPARE(updated.html.size(), qsizetype(1));
+    QCOMPARE(updated.html.first(), convertAll(lines).blocks.at(2).html);
+}
+
+QTEST_APPLESS_MAIN(TestMarkdownConverter)
+#include "tst_markdownconverter.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_piecetable
+
+SOURCES += \
+    tst_piecetable.cpp
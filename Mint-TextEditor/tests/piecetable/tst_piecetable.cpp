@@ -0,0 +1,159 @@
+#include <QtTest>
+
+#include "LineIndex.h"
+#include "PieceTable.h"
+#include "TextHash.h"
+
+// The piece table against a plain QString put through the same edits
+class TestPieceTable : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void randomEdits_data();
+    void randomEdits();
+    void snapshotsStayValid();
+    void latin1Original();
+    void bigInsertions();
+    void memoryUsed();
+
+private:
+    static void compare(const TextSnapshot &table, const QString &expected);
+};
+
+void TestPieceTable::compare(const TextSnapshot &table, const QString &expected)
+{
+    QCOMPARE(table.length(), expected.size());
+    QCOMPARE(table.toString(), expected);
+    QCOMPARE(table.hash(), TextHash::extend(0, expected.constData(), expected.size()));
+    QCOMPARE(table.lineCount(), expected.count(u'\n') + 1);
+
+    // Every line start, and the line of the positions around it
+    qsizetype line = 0;
+    for (qsizetype position = 0; position <= expected.size(); ++position)
+    {
+        if (position == 0 || expected.at(position - 1) == u'\n')
+        {
+            QCOMPARE(table.lineStart(line), position);
+            ++line;
+        }
+        QCOMPARE(table.lineAt(position), line - 1);
+    }
+}
+
+void TestPieceTable::randomEdits_data()
+{
+    QTest::addColumn<QString>("original");
+    QTest::addColumn<quint32>("seed");
+
+    QTest::newRow("empty") << QString() << 1u;
+    QTest::newRow("one line") << QString("the quick brown fox") << 2u;
+    QTest::newRow("lines") << QString("one\ntwo\nthree\n\nfive\n") << 3u;
+    QTest::newRow("non-Latin-1") << QString::fromUtf8("\xce\xb1\xce\xb2\n\xe2\x82\xac\n") << 4u;
+}
+
+void TestPieceTable::randomEdits()
+{
+    QFETCH(QString, original);
+    QFETCH(quint32, seed);
+
+    PieceTable table;
+    table.reset(QSharedPointer<TextChunk>::create(original));
+    QString expected = original;
+    compare(table, expected);
+
+    static const QString pieces[] = { "a", "\n", "xyz", "line\nbreak", "\n\n", QString::fromUtf8("\xc3\xa9") };
+    for (int i = 0; i < 500; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        const qsizetype position = qsizetype((seed >> 8) % quint32(expected.size() + 1));
+        if ((seed >> 4) % 3 == 0 && position < expected.size())
+        {
+            const qsizetype count = qMin(qsizetype((seed >> 20) % 8 + 1), expected.size() - position);
+            table.remove(position, count);
+            expected.remove(position, count);
+        }
+        else
+        {
+            const QString &text = pieces[(seed >> 16) % 6];
+            table.insert(position, text);
+            expected.insert(position, text);
+        }
+        if (i % 50 == 0)
+            compare(table, expected);
+    }
+    compare(table, expected);
+}
+
+void TestPieceTable::snapshotsStayValid()
+{
+    PieceTable table;
+    table.reset(QSharedPointer<TextChunk>::create(QString("first\nsecond\n")));
+    const TextSnapshot before = table.snapshot();
+
+    table.insert(6, QString("inserted\n"));
+    table.remove(0, 3);
+    table.reset();
+
+    compare(before, "first\nsecond\n");
+    compare(table, QString());
+}
+
+void TestPieceTable::latin1Original()
+{
+    // As the loader hands over a direct file: bytes with their index and hashes
+    const QByteArray bytes("caf\xe9\nna\xefve\n");
+    QList<qsizetype> newlines;
+    LineIndex::findNewlines(bytes.constData(), bytes.size(), 0, newlines);
+    TextHash::Sampler hashes;
+    hashes.append(bytes.constData(), bytes.size());
+
+    PieceTable table;
+    table.reset(QSharedPointer<TextChunk>::create(bytes, newlines, hashes));
+    QString expected = QString::fromLatin1(bytes);
+    compare(table, expected);
+
+    table.insert(4, QString::fromUtf8("\xe2\x82\xac"));
+    expected.insert(4, QString::fromUtf8("\xe2\x82\xac"));
+    table.remove(0, 2);
+    expected.remove(0, 2);
+    compare(table, expected);
+}
+
+void TestPieceTable::bigInsertions()
+{
+    // Pastes larger than an add buffer chunk get a chunk of their own
+    QString paste;
+    for (int i = 0; i < 20000; ++i)
+        paste += QString("pasted line %1\n").arg(i);
+
+    PieceTable table;
+    QString expected;
+    for (int i = 0; i < 3; ++i)
+    {
+        table.insert(expected.size() / 2, paste);
+        expected.insert(expected.size() / 2, paste);
+        table.insert(1, QString("x"));
+        expected.insert(1, QString("x"));
+    }
+    compare(table, expected);
+}
+
+void TestPieceTable::memoryUsed()
+{
+    const QString original(100000, u'a');
+    PieceTable table;
+    table.reset(QSharedPointer<TextChunk>::create(original));
+    const qint64 loaded = table.memoryUsed();
+    QVERIFY(loaded >= original.size() * 2);
+
+    // The original is counted once however many pieces point into it
+    for (int i = 0; i < 100; ++i)
+        table.insert(i * 1000, QString("b"));
+    const qint64 edited = table.memoryUsed();
+    QVERIFY(edited > loaded);
+    QVERIFY(edited < loaded + original.size() * 2);
+}
+
+QTEST_APPLESS_MAIN(TestPieceTable)
+#include "tst_piecetable.moc"
@@ -0,0 +1,8 @@
+# Each test is its own executable, built with the editor core
+TEMPLATE = app
+
+QT += testlib
+CONFIG += testcase console
+CONFIG -= app_bundle
+
+include($$PWD/../src/src.pri)
@@ -0,0 +1,10 @@
+# QTest executables: "make check" runs the tests, "make benchmark" the benchmarks
+TEMPLATE = subdirs
+
+SUBDIRS += \
+    piecetable \
+    linediff \
+    markdownconverter \
+    filesearch \
+    undohistory \
+    benchmark
@@ -0,0 +1,227 @@
+#include <QtTest>
+#include <QPlainTextEdit>
+#include <QSettings>
+#include <QTextCursor>
+
+#include "TextBuffer.h"
+#include "UndoHistory.h"
+
+// An editor wired to its history as DocumentTab does
+struct Editor
+{
+    QPlainTextEdit edit;
+    TextBuffer buffer{ edit.document() };
+    UndoHistory history{ &edit, &buffer };
+    bool following = false; // changes come from a followed file
+
+    Editor()
+    {
+        QObject::connect(&buffer, &TextBuffer::edited, &history, [this](qsizetype position, qsizetype removed, qsizetype added) {
+            if (following)
+                history.skip();
+            else
+                history.record(position, removed, added);
+        });
+    }
+
+    void insert(qsizetype position, const QString &text)
+    {
+        QTextCursor cursor(edit.document());
+        cursor.setPosition(int(position));
+        cursor.insertText(text);
+    }
+
+    void type(const QString &text)
+    {
+        for (QChar c : text)
+            insert(edit.document()->characterCount() - 1, QString(c));
+    }
+
+    QString text() const { return edit.toPlainText(); }
+};
+
+class TestUndoHistory : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void initMain();
+
+private slots:
+    void cleanup();
+    void typingUndoesAtOnce();
+    void stepsInOrder();
+    void groups();
+    void redoDroppedByEdit();
+    void followedAppendsArentUndone();
+    void cleanStep();
+    void spillAndRestore();
+};
+
+void TestUndoHistory::initMain()
+{
+    // Headless, and away from the editor's own settings
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QCoreApplication::setOrganizationName("MintTests");
+    QCoreApplication::setApplicationName("tst_undohistory");
+}
+
+void TestUndoHistory::cleanup()
+{
+    QSettings().clear();
+}
+
+void TestUndoHistory::typingUndoesAtOnce()
+{
+    Editor editor;
+    editor.type("hello");
+    QCOMPARE(editor.text(), QString("hello"));
+
+    editor.history.undo();
+    QCOMPARE(editor.text(), QString());
+    QVERIFY(!editor.history.canUndo());
+
+    editor.history.redo();
+    QCOMPARE(editor.text(), QString("hello"));
+    QVERIFY(!editor.history.canRedo());
+}
+
+void TestUndoHistory::stepsInOrder()
+{
+    // A line break ends the typing step, and gets its own
+    Editor editor;
+    editor.type("ab");
+    editor.type("\n");
+    editor.type("c");
+    editor.insert(0, "pasted ");
+    QCOMPARE(editor.text(), QString("pasted ab\nc"));
+
+    const QStringList states = { "ab\nc", "ab\n", "ab", "" };
+    for (const QString &state : states)
+    {
+        editor.history.undo();
+        QCOMPARE(editor.text(), state);
+    }
+    QVERIFY(!editor.history.canUndo());
+
+    for (qsizetype i = states.size() - 1; i-- > 0;)
+    {
+        editor.history.redo();
+        QCOMPARE(editor.text(), states.at(i));
+    }
+    editor.history.redo();
+    QCOMPARE(editor.text(), QString("pasted ab\nc"));
+}
+
+void TestUndoHistory::groups()
+{
+    Editor editor;
+    editor.insert(0, "one\ntwo\n");
+    editor.history.beginGroup();
+    editor.insert(8, "three\n");
+    editor.insert(4, "2 ");
+    editor.insert(0, "1 ");
+    editor.history.endGroup();
+    QCOMPARE(editor.text(), QString("1 one\n2 two\nthree\n"));
+
+    editor.history.undo();
+    QCOMPARE(editor.text(), QString("one\ntwo\n"));
+    editor.history.redo();
+    QCOMPARE(editor.text(), QString("1 one\n2 two\nthree\n"));
+}
+
+void TestUndoHistory::redoDroppedByEdit()
+{
+    Editor editor;
+    editor.insert(0, "first ");
+    editor.insert(6, "second");
+    editor.history.undo();
+    QVERIFY(editor.history.canRedo());
+
+    editor.insert(6, "other");
+    QVERIFY(!editor.history.canRedo());
+    editor.history.undo();
+    QCOMPARE(editor.text(), QString("first "));
+}
+
+void TestUndoHistory::followedAppendsArentUndone()
+{
+    Editor editor;
+    editor.insert(0, "edited\n");
+
+    editor.following = true;
+    editor.insert(7, "log line\n");
+    editor.following = false;
+
+    // The edit before the appended lines is undone around them
+    editor.history.undo();
+    QCOMPARE(editor.text(), QString("log line\n"));
+    QVERIFY(!editor.history.canUndo());
+    editor.history.redo();
+    QCOMPARE(editor.text(), QString("edited\nlog line\n"));
+}
+
+void TestUndoHistory::cleanStep()
+{
+    Editor editor;
+    editor.type("saved");
+    editor.history.setClean();
+    QVERIFY(editor.history.isClean());
+
+    // Typing on doesn't join the saved step
+    editor.type(" more");
+    QVERIFY(!editor.history.isClean());
+    editor.history.undo();
+    QVERIFY(editor.history.isClean());
+    QCOMPARE(editor.text(), QString("saved"));
+
+    editor.history.undo();
+    QVERIFY(!editor.history.isClean());
+    editor.history.redo();
+    QVERIFY(editor.history.isClean());
+
+    // Another edit from before the save drops the saved step's redo
+    editor.history.undo();
+    editor.type("other");
+    editor.history.undo();
+    editor.history.redo();
+    QVERIFY(!editor.history.isClean());
+}
+
+void TestUndoHistory::spillAndRestore()
+{
+    QSettings().setValue("editor/undoMemoryMB", 1);
+    Editor editor;
+    QCOMPARE(UndoHistory::memoryCap(), qint64(1024 * 1024));
+
+    // Ten steps of 100,000 characters, twice the cap in UTF-16
+    QStringList states = { QString() };
+    for (int step = 0; step < 10; ++step)
+    {
+        QString lines;
+        for (int line = 0; line < 1000; ++line)
+            lines += QString("step %1 line %2 ").arg(step).arg(line).leftJustified(99, u'.') + u'\n';
+        editor.insert(step % 2 ? 0 : editor.text().size(), lines);
+        states.append(editor.text());
+    }
+    QVERIFY(editor.history.spilledSize() > 0);
+    QVERIFY(editor.history.memoryUsed() <= UndoHistory::memoryCap());
+
+    // All the way back, reading the oldest steps from the log, and forth again
+    for (qsizetype i = states.size() - 1; i-- > 0;)
+    {
+        editor.history.undo();
+        QCOMPARE(editor.text(), states.at(i));
+    }
+    QVERIFY(!editor.history.canUndo());
+    for (qsizetype i = 1; i < states.size(); ++i)
+    {
+        editor.history.redo();
+        QCOMPARE(editor.text(), states.at(i));
+        QVERIFY(editor.history.memoryUsed() <= UndoHistory::memoryCap());
+    }
+}
+
+QTEST_MAIN(TestUndoHistory)
+#include "tst_undohistory.moc"
@@ -0,0 +1,6 @@
+include(../tests.pri)
+
+TARGET = tst_undohistory
+
+SOURCES += \
+    tst_undohistory.cpp